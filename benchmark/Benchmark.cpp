@@ -0,0 +1,429 @@
+// Renders a fixed set of scenes on every backend there is and writes rays per second, time per sample
+// and peak memory as JSON, so a run can be compared against an earlier one.
+// Run it from the build directory, like the raytracer itself, so it finds the shaders.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "CPURaytracer.h"
+#include "GPURaytracer.h"
+#include "Offline.h"
+#include "Options.h"
+#include "ProgramCache.h"
+#include "Random.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "SimdTraversal.h"
+#include "logger.h"
+
+
+// every case renders at the same size and sample count, so the numbers stay comparable between runs
+const int WIDTH = 640;
+const int HEIGHT = 360;
+const int SAMPLES = 4;
+// rendered before the timing starts, shader compilation and uploads aren't measured
+const int WARMUP_FRAMES = 1;
+
+struct BenchmarkScene
+{
+	const char* name;
+	std::vector<Sphere> (*build)();
+	glm::vec3 lookFrom;
+	glm::vec3 lookAt;
+	int maxDepth;
+};
+
+struct BenchmarkResult
+{
+	std::string scene;
+	std::string backend;
+	int maxDepth;
+	int frames;
+	double seconds;
+	uint64_t primaryRays;
+	uint64_t totalRays;
+	// resident memory at its highest while the case ran, and how far that is above where the case
+	// started, -1 if it couldn't be measured (see startPeakRss())
+	long peakRssKiB;
+	long peakRssGrowthKiB;
+};
+
+
+// 10000 small spheres on a jittered grid, mostly diffuse, seeded so every run gets the same field
+static std::vector<Sphere> sphereField()
+{
+	std::vector<Sphere> spheres;
+	spheres.push_back({glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, glm::vec3(0.5f), 1.0f, LAMBERT, 1.0f});
+
+	uint32_t rngState = pcgHash(10000);
+	for(int z = 0; z < 100; z++)
+	for(int x = 0; x < 100; x++)
+	{
+		glm::vec3 center((x - 50 + 0.8f * randomFloat(rngState)) * 0.6f, 0.15f, (z - 50 + 0.8f * randomFloat(rngState)) * 0.6f);
+		glm::vec3 albedo(randomFloat(rngState), randomFloat(rngState), randomFloat(rngState));
+		float choice = randomFloat(rngState);
+		if(choice < 0.8f)
+			spheres.push_back({center, 0.15f, albedo * albedo, 1.0f, LAMBERT, 1.0f});
+		else if(choice < 0.95f)
+			spheres.push_back({center, 0.15f, glm::vec3(0.5f) + 0.5f * albedo, 0.5f * randomFloat(rngState), METAL, 1.0f});
+		else
+			spheres.push_back({center, 0.15f, glm::vec3(0.0f), 1.0f, DIELECTRIC, 1.5f});
+	}
+	return spheres;
+}
+
+// the default layout with every small sphere made of glass, rays refract and reflect all the way down
+static std::vector<Sphere> glassScene()
+{
+	std::vector<Sphere> spheres = defaultSceneList();
+	for(size_t i = 1; i < spheres.size(); i++)
+	{
+		spheres[i].materialType = DIELECTRIC;
+		spheres[i].refractionIndex = 1.5f;
+	}
+	return spheres;
+}
+
+// the default layout with polished metal, so most paths bounce until the depth limit
+static std::vector<Sphere> mirrorScene()
+{
+	std::vector<Sphere> spheres = defaultSceneList();
+	for(Sphere& sphere : spheres)
+	{
+		sphere.materialType = METAL;
+		sphere.albedo = glm::vec3(0.7f) + 0.3f * sphere.albedo;
+		sphere.fuzz = 0.02f;
+	}
+	return spheres;
+}
+
+const BenchmarkScene SCENES[] = {
+	{"default", defaultSceneList, glm::vec3(13.0f, 2.0f, 3.0f), glm::vec3(0.0f), 8},
+	{"sphere-field-10k", sphereField, glm::vec3(22.0f, 6.0f, 22.0f), glm::vec3(0.0f), 8},
+	{"glass", glassScene, glm::vec3(13.0f, 2.0f, 3.0f), glm::vec3(0.0f), 8},
+	{"deep-bounce", mirrorScene, glm::vec3(13.0f, 2.0f, 3.0f), glm::vec3(0.0f), 32},
+};
+
+
+// a "Field:   1234 kB" line of /proc/self/status, -1 if there is none
+static long procStatusKiB(const char* field)
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	size_t length = std::strlen(field);
+	while(std::getline(status, line))
+		if(line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+			return std::atol(line.c_str() + length + 1);
+	return -1;
+}
+
+// the peak of the whole process before startPeakRss() last reset it
+static long resetPeakRssKiB = 0;
+
+// the peak of the whole process so far, in KiB. ru_maxrss (KiB on Linux) on its own would forget what
+// startPeakRss() resets.
+static long processPeakRssKiB()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return std::max({(long)usage.ru_maxrss, procStatusKiB("VmHWM"), resetPeakRssKiB});
+}
+
+// ru_maxrss never goes down, so after the biggest case every later one would report its peak. Linux
+// can reset the peak of the process (VmHWM) to what it uses right now, which makes VmHWM after a case
+// the peak of that case. Returns the resident memory the case starts with, -1 where the peak can't be reset.
+static long startPeakRss()
+{
+	resetPeakRssKiB = processPeakRssKiB();
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+	clearRefs.close();
+	if(!clearRefs)
+		return -1;
+	return procStatusKiB("VmRSS");
+}
+
+static std::string jsonString(const std::string& text)
+{
+	std::string escaped = "\"";
+	for(char c : text)
+	{
+		if(c == '"' || c == '\\')
+			escaped += '\\';
+		if((unsigned char)c < 0x20)
+			continue;
+		escaped += c;
+	}
+	return escaped + "\"";
+}
+
+// null for the -1 of a value that couldn't be measured
+static std::string jsonNumber(long value)
+{
+	return value < 0 ? "null" : std::to_string(value);
+}
+
+// startRssKiB is what startPeakRss() returned before the case
+static BenchmarkResult makeResult(const BenchmarkScene& scene, const std::string& backend, int frames, double seconds, uint64_t totalRays, long startRssKiB)
+{
+	BenchmarkResult result;
+	result.scene = scene.name;
+	result.backend = backend;
+	result.maxDepth = scene.maxDepth;
+	result.frames = frames;
+	result.seconds = seconds;
+	result.primaryRays = (uint64_t)WIDTH * HEIGHT * SAMPLES * frames;
+	result.totalRays = totalRays;
+	result.peakRssKiB = startRssKiB < 0 ? -1 : procStatusKiB("VmHWM");
+	result.peakRssGrowthKiB = result.peakRssKiB < 0 ? -1 : std::max(result.peakRssKiB - startRssKiB, 0L);
+
+	logger::Log(logger::LogLevel::INFO, result.scene + " on " + backend + ": " + std::to_string(totalRays / seconds / 1e6) + " Mrays/s");
+	return result;
+}
+
+static RenderSettings sceneSettings(const BenchmarkScene& scene)
+{
+	return {scene.lookFrom, scene.lookAt, scene.maxDepth, SAMPLES, 0};
+}
+
+
+static void benchmarkCPU(int frames, unsigned int threads, std::vector<BenchmarkResult>& results)
+{
+	CPURaytracer raytracer(threads);
+	std::vector<float> pixels;
+
+	// the scalar port, then every SIMD backend this CPU can run
+	std::vector<const SimdBackend*> simdBackends = {nullptr};
+	for(const SimdBackend* backend : supportedSimdBackends())
+		simdBackends.push_back(backend);
+
+	for(const BenchmarkScene& benchmarkScene : SCENES)
+	{
+		Scene scene(benchmarkScene.build());
+		for(const SimdBackend* simd : simdBackends)
+		{
+			raytracer.setSimdBackend(simd);
+			RenderSettings settings = sceneSettings(benchmarkScene);
+			long startRss = startPeakRss();
+			for(int frame = 0; frame < WARMUP_FRAMES; frame++)
+				raytracer.render(scene, settings, WIDTH, HEIGHT, pixels);
+
+			uint64_t rays = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for(int frame = 0; frame < frames; frame++)
+			{
+				settings.frameIndex = frame;
+				raytracer.render(scene, settings, WIDTH, HEIGHT, pixels);
+				rays += raytracer.raysPerFrame();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			results.push_back(makeResult(benchmarkScene, std::string("cpu-") + (simd ? simd->name : "scalar"), frames, seconds, rays, startRss));
+		}
+	}
+}
+
+// returns false if there is no GL context to be had, reason says why
+static bool benchmarkGPU(const Options& options, int frames, std::vector<BenchmarkResult>& results, std::string& renderer, std::string& reason)
+{
+	GLFWwindow* window = createHeadlessContext(options);
+	if(!window)
+	{
+		reason = "no headless GL context";
+		return false;
+	}
+	renderer = (const char*)glGetString(GL_RENDERER);
+
+	{
+		RenderTarget target;
+		target.create(glm::ivec2(WIDTH, HEIGHT));
+		// compiling isn't what is measured, but a warm cache keeps the runs short
+		ProgramCache programCache(options.shaderCache);
+		GPURaytracer raytracer(programCache, glm::ivec2(DEFAULT_LOCAL_SIZE_X, DEFAULT_LOCAL_SIZE_Y));
+		// the generic kernel, so the numbers don't depend on which variants happen to be cached
+		raytracer.setSpecialization(false);
+
+		const std::pair<GPUPipeline, const char*> pipelines[] = {
+			{GPUPipeline::MEGAKERNEL, "gpu-megakernel"},
+			{GPUPipeline::WAVEFRONT, "gpu-wavefront"},
+		};
+		for(const BenchmarkScene& benchmarkScene : SCENES)
+		{
+			Scene scene(benchmarkScene.build());
+			RenderSettings settings = sceneSettings(benchmarkScene);
+			for(const auto& pipeline : pipelines)
+			{
+				raytracer.setPipeline(pipeline.first);
+				long startRss = startPeakRss();
+				for(int frame = 0; frame < WARMUP_FRAMES; frame++)
+					raytracer.render(scene, settings, target);
+				glFinish();
+
+				uint64_t rays = 0;
+				auto start = std::chrono::high_resolution_clock::now();
+				for(int frame = 0; frame < frames; frame++)
+				{
+					settings.frameIndex = frame;
+					raytracer.render(scene, settings, target);
+					// the counter of a frame can be read as soon as the frame is done
+					glFinish();
+					rays += raytracer.raysPerFrame();
+				}
+				double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+				results.push_back(makeResult(benchmarkScene, pipeline.second, frames, seconds, rays, startRss));
+			}
+			scene.releaseBuffers();
+		}
+
+		raytracer.release();
+		target.release();
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return true;
+}
+
+
+static void writeJSON(std::ostream& out, int frames, unsigned int cpuThreads, const std::string& renderer, const std::vector<BenchmarkResult>& results, const std::vector<std::pair<std::string, std::string>>& skipped)
+{
+	out << "{\n";
+	out << "  \"width\": " << WIDTH << ",\n";
+	out << "  \"height\": " << HEIGHT << ",\n";
+	out << "  \"samplesPerPixel\": " << SAMPLES << ",\n";
+	out << "  \"frames\": " << frames << ",\n";
+	out << "  \"cpuThreads\": " << cpuThreads << ",\n";
+	out << "  \"glRenderer\": " << jsonString(renderer) << ",\n";
+	// the peak of the whole run, every case together
+	out << "  \"processPeakRssKiB\": " << processPeakRssKiB() << ",\n";
+	out << "  \"results\": [\n";
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		// one sample per pixel over the whole image
+		double msPerSample = result.seconds * 1000.0 / (result.frames * SAMPLES);
+		out << "    {\"scene\": " << jsonString(result.scene)
+		    << ", \"backend\": " << jsonString(result.backend)
+		    << ", \"maxDepth\": " << result.maxDepth
+		    << ", \"seconds\": " << result.seconds
+		    << ", \"primaryRaysPerSecond\": " << (uint64_t)(result.primaryRays / result.seconds)
+		    << ", \"totalRaysPerSecond\": " << (uint64_t)(result.totalRays / result.seconds)
+		    << ", \"msPerSamplePerPixel\": " << msPerSample
+		    << ", \"peakRssKiB\": " << jsonNumber(result.peakRssKiB)
+		    << ", \"peakRssGrowthKiB\": " << jsonNumber(result.peakRssGrowthKiB) << "}"
+		    << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ],\n";
+	out << "  \"skipped\": [";
+	for(size_t i = 0; i < skipped.size(); i++)
+		out << (i ? ", " : "") << "{\"backend\": " << jsonString(skipped[i].first) << ", \"reason\": " << jsonString(skipped[i].second) << "}";
+	out << "]\n";
+	out << "}\n";
+}
+
+static void printBenchmarkUsage(const char* program)
+{
+	std::printf(
+		"Usage: %s [options]\n"
+		"\n"
+		"  --backend all|cpu|gpu  which backends are measured (default all)\n"
+		"  --frames N             frames timed per scene and backend (default 4)\n"
+		"  --threads N            CPU backend threads, 0 for all (default 0)\n"
+		"  --context osmesa|egl   how the GL context is created (default osmesa)\n"
+		"  -o, --output PATH      JSON results, - for stdout (default benchmark.json)\n"
+		"  -h, --help             show this message\n",
+		program);
+}
+
+
+int main(int argc, char** argv)
+{
+	// only the context and shader cache of these are used, for createHeadlessContext()
+	Options options;
+	options.width = WIDTH;
+	options.height = HEIGHT;
+	std::string backends = "all";
+	std::string output = "benchmark.json";
+	int frames = 4;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[++i] : nullptr;
+		bool valid = value != nullptr;
+
+		if(arg == "--help" || arg == "-h")
+		{
+			printBenchmarkUsage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+		else if(!valid)
+			;
+		else if(arg == "--backend")
+		{
+			backends = value;
+			valid = backends == "all" || backends == "cpu" || backends == "gpu";
+		}
+		else if(arg == "--frames")
+			valid = (frames = std::atoi(value)) > 0;
+		else if(arg == "--threads")
+			options.threads = (unsigned int)std::atoi(value);
+		else if(arg == "--context")
+		{
+			options.context = std::strcmp(value, "egl") == 0 ? HeadlessContext::EGL : HeadlessContext::OSMESA;
+			valid = std::strcmp(value, "egl") == 0 || std::strcmp(value, "osmesa") == 0;
+		}
+		else if(arg == "--output" || arg == "-o")
+			output = value;
+		else
+			valid = false;
+
+		if(!valid)
+		{
+			logger::Log(logger::LogLevel::ERROR, "Invalid option or value: " + arg);
+			printBenchmarkUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	std::vector<std::pair<std::string, std::string>> skipped;
+	std::string renderer;
+	unsigned int cpuThreads = options.threads ? options.threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+	if(backends != "gpu")
+		benchmarkCPU(frames, options.threads, results);
+	if(backends != "cpu")
+	{
+		std::string reason;
+		if(!benchmarkGPU(options, frames, results, renderer, reason))
+		{
+			logger::Log(logger::LogLevel::WARNING, "Skipping the GPU backend: " + reason);
+			skipped.push_back({"gpu", reason});
+		}
+	}
+
+	if(output == "-")
+		writeJSON(std::cout, frames, cpuThreads, renderer, results, skipped);
+	else
+	{
+		std::ofstream file(output);
+		if(!file)
+		{
+			logger::Log(logger::LogLevel::ERROR, "Could not write " + output);
+			return EXIT_FAILURE;
+		}
+		writeJSON(file, frames, cpuThreads, renderer, results, skipped);
+		logger::Log(logger::LogLevel::INFO, "Wrote " + output);
+	}
+	return EXIT_SUCCESS;
+}
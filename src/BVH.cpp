@@ -0,0 +1,617 @@
+#include "BVH.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "TaskScheduler.h"
+#include "logger.h"
+
+
+BVHBuildSettings BVH::buildSettings;
+
+static AABB sphereBounds(const Sphere& sphere)
+{
+	AABB bounds;
+	bounds.min = sphere.center - glm::vec3(sphere.radius);
+	bounds.max = sphere.center + glm::vec3(sphere.radius);
+	return bounds;
+}
+
+// children always come after their parent, so walking the nodes backwards sees them first
+template<typename PrimBounds>
+static void refitNodes(std::vector<BVHNode>& nodes, const std::vector<uint32_t>& primIndices, PrimBounds primBounds)
+{
+	// the root of an empty scene has no primitives and no children either
+	if(primIndices.empty())
+		return;
+
+	for(size_t i = nodes.size(); i-- > 0;)
+	{
+		BVHNode& node = nodes[i];
+		AABB bounds;
+		if(node.isLeaf())
+		{
+			for(uint32_t j = 0; j < node.primCount; j++)
+				bounds.grow(primBounds(primIndices[node.leftFirst + j]));
+		}
+		else
+		{
+			const BVHNode& left = nodes[node.leftFirst];
+			const BVHNode& right = nodes[node.leftFirst + 1];
+			bounds.min = glm::min(left.boundsMin, right.boundsMin);
+			bounds.max = glm::max(left.boundsMax, right.boundsMax);
+		}
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+}
+
+
+
+namespace {
+
+// smaller builds aren't worth waking the scheduler for
+const uint32_t PARALLEL_BUILD_MIN = 4096;
+// nodes with fewer primitives build both their children on the same thread
+const uint32_t PARALLEL_SPLIT_MIN = 1024;
+// nodes with more primitives are binned in chunks of this many in parallel, the ones near the root
+const uint32_t PARALLEL_BINNING_CHUNK = 16384;
+
+TaskScheduler& buildScheduler()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+// An AABB as two float4s, x, y and z and a lane that's never looked at, so growing one is a min
+// and a max on SSE, which is part of x86-64 itself. Other platforms get the same with glm.
+#if defined(__x86_64__) || defined(_M_X64)
+struct Box
+{
+	__m128 min;
+	__m128 max;
+
+	static Box empty() { return {_mm_set1_ps(1e30f), _mm_set1_ps(-1e30f)}; }
+	static Box of(const AABB& b) { return {_mm_setr_ps(b.min.x, b.min.y, b.min.z, 0.0f), _mm_setr_ps(b.max.x, b.max.y, b.max.z, 0.0f)}; }
+
+	void grow(const Box& b) { min = _mm_min_ps(min, b.min); max = _mm_max_ps(max, b.max); }
+	void grow(__m128 p) { min = _mm_min_ps(min, p); max = _mm_max_ps(max, p); }
+	__m128 center() const { return _mm_mul_ps(_mm_add_ps(min, max), _mm_set1_ps(0.5f)); }
+
+	AABB aabb() const
+	{
+		alignas(16) float lo[4], hi[4];
+		_mm_store_ps(lo, min);
+		_mm_store_ps(hi, max);
+		AABB b;
+		b.min = glm::vec3(lo[0], lo[1], lo[2]);
+		b.max = glm::vec3(hi[0], hi[1], hi[2]);
+		return b;
+	}
+	float area() const { return aabb().area(); }
+};
+
+// the bin of point p on every axis, p is scaled into [0, binCount) by offset and scale
+typedef __m128 BinVector;
+
+inline void binIndices(__m128 p, __m128 offset, __m128 scale, float lastBin, int bins[4])
+{
+	__m128 bin = _mm_mul_ps(_mm_sub_ps(p, offset), scale);
+	bin = _mm_min_ps(_mm_max_ps(bin, _mm_setzero_ps()), _mm_set1_ps(lastBin));
+	_mm_storeu_si128((__m128i*)bins, _mm_cvttps_epi32(bin));
+}
+#else
+struct Box
+{
+	glm::vec4 min;
+	glm::vec4 max;
+
+	static Box empty() { return {glm::vec4(1e30f), glm::vec4(-1e30f)}; }
+	static Box of(const AABB& b) { return {glm::vec4(b.min, 0.0f), glm::vec4(b.max, 0.0f)}; }
+
+	void grow(const Box& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+	void grow(const glm::vec4& p) { min = glm::min(min, p); max = glm::max(max, p); }
+	glm::vec4 center() const { return 0.5f * (min + max); }
+
+	AABB aabb() const
+	{
+		AABB b;
+		b.min = glm::vec3(min);
+		b.max = glm::vec3(max);
+		return b;
+	}
+	float area() const { return aabb().area(); }
+};
+
+typedef glm::vec4 BinVector;
+
+inline void binIndices(const glm::vec4& p, const glm::vec4& offset, const glm::vec4& scale, float lastBin, int bins[4])
+{
+	glm::vec4 bin = glm::min(glm::max((p - offset) * scale, glm::vec4(0.0f)), glm::vec4(lastBin));
+	for(int a = 0; a < 4; a++)
+		bins[a] = (int)bin[a];
+}
+#endif
+
+// a node while the tree is being built, children points to the two of them, nullptr for leaves
+struct BuildNode
+{
+	Box bounds;
+	uint32_t first;
+	uint32_t count;
+	BuildNode* children;
+};
+
+// Hands out the nodes of one thread, two at a time (the children of a split) from blocks that
+// never move, so other threads can keep pointers into them while more are allocated.
+// Counts what the thread built on the way, for the log.
+struct alignas(64) Arena
+{
+	static const uint32_t BLOCK_SIZE = 4096;
+
+	BuildNode* allocatePair()
+	{
+		if(used + 2 > BLOCK_SIZE)
+		{
+			blocks.emplace_back(new BuildNode[BLOCK_SIZE]);
+			used = 0;
+		}
+		BuildNode* pair = &blocks.back()[used];
+		used += 2;
+		nodeCount += 2;
+		return pair;
+	}
+
+	std::vector<std::unique_ptr<BuildNode[]>> blocks;
+	uint32_t used = BLOCK_SIZE;
+	size_t nodeCount = 0;
+	size_t leafCount = 0;
+	uint32_t largestLeaf = 0;
+	int depth = 1;
+};
+
+// what binning a node says about the best place to split it
+struct Split
+{
+	int axis = -1;
+	int bin = 0;
+	float cost = 1e30f;
+	uint32_t leftCount = 0;
+	Box leftBounds, rightBounds;
+	Box leftCentroids, rightCentroids;
+};
+
+struct Bin
+{
+	Box bounds;
+	Box centroids;
+	uint32_t count;
+};
+
+// the bins of all three axes of a node, or of a chunk of its primitives, only the first binCount are used
+struct Bins
+{
+	void clear(int binCount)
+	{
+		for(int a = 0; a < 3; a++)
+			for(int i = 0; i < binCount; i++)
+				axes[a][i] = {Box::empty(), Box::empty(), 0};
+	}
+
+	Bin axes[3][BVH::MAX_BIN_COUNT];
+};
+
+class Builder
+{
+public:
+	Builder(size_t primCount, std::vector<uint32_t>& primIndices, const BVHBuildSettings& settings, TaskScheduler* scheduler)
+		: primIndices(primIndices), scheduler(scheduler),
+		maxLeafSize((uint32_t)std::max(1, settings.maxLeafSize)), binCount(std::min(std::max(2, settings.binCount), (int)BVH::MAX_BIN_COUNT)),
+		primBounds(primCount), arenas(new Arena[scheduler ? scheduler->size() : 1])
+	{
+	}
+
+	// every primitive's box and index, the root's bounds and centroid bounds
+	void init(unsigned int thread, const std::vector<AABB>& bounds, BuildNode& root, Box& rootCentroids)
+	{
+		uint32_t primCount = (uint32_t)bounds.size();
+		uint32_t chunkCount = (primCount + PARALLEL_BINNING_CHUNK - 1) / PARALLEL_BINNING_CHUNK;
+		std::vector<Box> chunkBounds(chunkCount, Box::empty()), chunkCentroids(chunkCount, Box::empty());
+		forChunks(thread, primCount, [&](uint32_t chunk, uint32_t first, uint32_t last)
+		{
+			for(uint32_t i = first; i < last; i++)
+			{
+				primBounds[i] = Box::of(bounds[i]);
+				primIndices[i] = i;
+				chunkBounds[chunk].grow(primBounds[i]);
+				chunkCentroids[chunk].grow(primBounds[i].center());
+			}
+		});
+
+		root.bounds = rootCentroids = Box::empty();
+		for(uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			root.bounds.grow(chunkBounds[chunk]);
+			rootCentroids.grow(chunkCentroids[chunk]);
+		}
+		root.first = 0;
+		root.count = primCount;
+		root.children = nullptr;
+	}
+
+	void split(unsigned int thread, BuildNode& node, const Box& centroids, int depth)
+	{
+		Arena& arena = arenas[thread];
+		arena.depth = std::max(arena.depth, depth);
+
+		Split best;
+		if(node.count > 1 && depth < BVH::MAX_DEPTH)
+			best = findSplit(thread, node, centroids);
+		if(best.axis < 0 || (best.cost >= float(node.count) && node.count <= maxLeafSize))
+		{
+			arena.leafCount++;
+			arena.largestLeaf = std::max(arena.largestLeaf, node.count);
+			return;
+		}
+
+		// partition the primitive indices with the same binning that found the split
+		BinVector offset, scale;
+		binMapping(centroids, offset, scale);
+		uint32_t* first = &primIndices[node.first];
+		std::partition(first, first + node.count, [&](uint32_t prim)
+		{
+			int bins[4];
+			binIndices(primBounds[prim].center(), offset, scale, float(binCount - 1), bins);
+			return bins[best.axis] <= best.bin;
+		});
+
+		BuildNode* children = arena.allocatePair();
+		children[0] = {best.leftBounds, node.first, best.leftCount, nullptr};
+		children[1] = {best.rightBounds, node.first + best.leftCount, node.count - best.leftCount, nullptr};
+		node.children = children;
+
+		if(scheduler && node.count >= PARALLEL_SPLIT_MIN)
+		{
+			// the right half goes to whichever thread runs out of work first
+			TaskScheduler::Group group;
+			scheduler->spawn(thread, group, [&](unsigned int worker) { split(worker, children[1], best.rightCentroids, depth + 1); });
+			split(thread, children[0], best.leftCentroids, depth + 1);
+			scheduler->wait(thread, group);
+		}
+		else
+		{
+			split(thread, children[0], best.leftCentroids, depth + 1);
+			split(thread, children[1], best.rightCentroids, depth + 1);
+		}
+	}
+
+	const Arena& arena(unsigned int thread) const { return arenas[thread]; }
+
+private:
+	// maps centroids to bin numbers, axes without any extent all go to bin 0
+#if defined(__x86_64__) || defined(_M_X64)
+	void binMapping(const Box& centroids, __m128& offset, __m128& scale) const
+	{
+		__m128 extent = _mm_sub_ps(centroids.max, centroids.min);
+		__m128 positive = _mm_cmpgt_ps(extent, _mm_setzero_ps());
+		offset = centroids.min;
+		scale = _mm_and_ps(positive, _mm_div_ps(_mm_set1_ps(float(binCount)), _mm_max_ps(extent, _mm_set1_ps(1e-30f))));
+	}
+#else
+	void binMapping(const Box& centroids, glm::vec4& offset, glm::vec4& scale) const
+	{
+		glm::vec4 extent = centroids.max - centroids.min;
+		offset = centroids.min;
+		scale = glm::vec4(0.0f);
+		for(int a = 0; a < 3; a++)
+			if(extent[a] > 0.0f)
+				scale[a] = float(binCount) / extent[a];
+	}
+#endif
+
+	void binRange(uint32_t first, uint32_t last, const Box& centroids, Bins& bins) const
+	{
+		BinVector offset, scale;
+		binMapping(centroids, offset, scale);
+		for(uint32_t i = first; i < last; i++)
+		{
+			const Box& box = primBounds[primIndices[i]];
+			auto center = box.center();
+			int index[4];
+			binIndices(center, offset, scale, float(binCount - 1), index);
+			for(int a = 0; a < 3; a++)
+			{
+				Bin& bin = bins.axes[a][index[a]];
+				bin.bounds.grow(box);
+				bin.centroids.grow(center);
+				bin.count++;
+			}
+		}
+	}
+
+	// Bins the centroids of the node's primitives on every axis at once and sweeps the bins for the
+	// cheapest split, its cost is relative to the cost of intersecting a single primitive
+	Split findSplit(unsigned int thread, const BuildNode& node, const Box& centroids)
+	{
+		std::unique_ptr<Bins> bins(new Bins);
+		bins->clear(binCount);
+		if(scheduler && node.count > 2 * PARALLEL_BINNING_CHUNK)
+		{
+			// every chunk bins into its own, merged in chunk order so the tree doesn't depend on the timing
+			uint32_t chunkCount = (node.count + PARALLEL_BINNING_CHUNK - 1) / PARALLEL_BINNING_CHUNK;
+			std::vector<Bins> chunkBins(chunkCount);
+			forChunks(thread, node.count, [&](uint32_t chunk, uint32_t first, uint32_t last)
+			{
+				chunkBins[chunk].clear(binCount);
+				binRange(node.first + first, node.first + last, centroids, chunkBins[chunk]);
+			});
+			for(const Bins& chunk : chunkBins)
+				for(int a = 0; a < 3; a++)
+					for(int i = 0; i < binCount; i++)
+					{
+						Bin& bin = bins->axes[a][i];
+						bin.bounds.grow(chunk.axes[a][i].bounds);
+						bin.centroids.grow(chunk.axes[a][i].centroids);
+						bin.count += chunk.axes[a][i].count;
+					}
+		}
+		else
+			binRange(node.first, node.first + node.count, centroids, *bins);
+
+		Split best;
+		float nodeArea = node.bounds.area();
+		AABB centroidBounds = centroids.aabb();
+		for(int a = 0; a < 3; a++)
+		{
+			if(centroidBounds.min[a] == centroidBounds.max[a])
+				continue;
+
+			// sweep from both sides to get the area and count left and right of every bin boundary
+			const Bin* axisBins = bins->axes[a];
+			float rightArea[BVH::MAX_BIN_COUNT];
+			uint32_t rightCount[BVH::MAX_BIN_COUNT];
+			Box rightBox = Box::empty();
+			uint32_t rightSum = 0;
+			for(int i = binCount - 1; i > 0; i--)
+			{
+				rightSum += axisBins[i].count;
+				rightBox.grow(axisBins[i].bounds);
+				rightCount[i - 1] = rightSum;
+				rightArea[i - 1] = rightBox.area();
+			}
+
+			Box leftBox = Box::empty();
+			uint32_t leftSum = 0;
+			for(int i = 0; i < binCount - 1; i++)
+			{
+				leftSum += axisBins[i].count;
+				leftBox.grow(axisBins[i].bounds);
+				if(leftSum == 0 || rightCount[i] == 0)
+					continue;
+				float cost = leftSum * leftBox.area() + rightCount[i] * rightArea[i];
+				if(cost < best.cost)
+				{
+					best.cost = cost;
+					best.axis = a;
+					best.bin = i;
+				}
+			}
+		}
+
+		if(best.axis < 0 || nodeArea <= 0.0f)
+		{
+			best.axis = -1;
+			return best;
+		}
+		best.cost = BVH::TRAVERSAL_COST + best.cost / nodeArea;
+
+		// the children's bounds come out of the bins, the primitives don't have to be looked at again
+		best.leftBounds = best.rightBounds = best.leftCentroids = best.rightCentroids = Box::empty();
+		for(int i = 0; i < binCount; i++)
+		{
+			const Bin& bin = bins->axes[best.axis][i];
+			if(bin.count == 0)
+				continue;
+			if(i <= best.bin)
+			{
+				best.leftCount += bin.count;
+				best.leftBounds.grow(bin.bounds);
+				best.leftCentroids.grow(bin.centroids);
+			}
+			else
+			{
+				best.rightBounds.grow(bin.bounds);
+				best.rightCentroids.grow(bin.centroids);
+			}
+		}
+		return best;
+	}
+
+	// job(chunk, first, last) for every PARALLEL_BINNING_CHUNK primitives of count, spread over the
+	// scheduler if there is one
+	template<typename Job>
+	void forChunks(unsigned int thread, uint32_t count, const Job& job)
+	{
+		uint32_t chunkCount = (count + PARALLEL_BINNING_CHUNK - 1) / PARALLEL_BINNING_CHUNK;
+		TaskScheduler::Group group;
+		for(uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			uint32_t first = chunk * PARALLEL_BINNING_CHUNK;
+			uint32_t last = std::min(count, first + PARALLEL_BINNING_CHUNK);
+			if(scheduler && chunk + 1 < chunkCount)
+				scheduler->spawn(thread, group, [&job, chunk, first, last](unsigned int) { job(chunk, first, last); });
+			else
+				job(chunk, first, last);
+		}
+		if(scheduler)
+			scheduler->wait(thread, group);
+	}
+
+	std::vector<uint32_t>& primIndices;
+	TaskScheduler* scheduler;
+	uint32_t maxLeafSize;
+	int binCount;
+	std::vector<Box> primBounds;
+	std::unique_ptr<Arena[]> arenas;
+};
+
+}
+
+
+void BVH::build(const std::vector<Sphere>& spheres)
+{
+	std::vector<AABB> bounds(spheres.size());
+	for(size_t i = 0; i < spheres.size(); i++)
+		bounds[i] = sphereBounds(spheres[i]);
+	build(bounds);
+}
+
+void BVH::build(const std::vector<AABB>& bounds)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	uint32_t primCount = (uint32_t)bounds.size();
+	primIndices.resize(primCount);
+	nodes.clear();
+
+	// the root always exists, for an empty scene its bounds are inverted so nothing can hit it
+	if(primCount == 0)
+	{
+		BVHNode root = {glm::vec3(1e30f), 0, glm::vec3(-1e30f), 0};
+		nodes.push_back(root);
+		logger::Log(logger::LogLevel::DEBUG, "Built BVH over 0 primitives");
+		return;
+	}
+
+	BuildNode root;
+	unsigned int threadCount = 1;
+	auto buildTree = [&](Builder& builder, unsigned int thread)
+	{
+		Box rootCentroids;
+		builder.init(thread, bounds, root, rootCentroids);
+		builder.split(thread, root, rootCentroids, 1);
+	};
+
+	std::unique_ptr<Builder> builder;
+	TaskScheduler& scheduler = buildScheduler();
+	bool parallel = false;
+	if(primCount >= PARALLEL_BUILD_MIN && scheduler.size() > 1)
+	{
+		builder.reset(new Builder(primCount, primIndices, buildSettings, &scheduler));
+		parallel = scheduler.tryRun([&](unsigned int thread) { buildTree(*builder, thread); });
+		threadCount = scheduler.size();
+	}
+	if(!parallel)
+	{
+		builder.reset(new Builder(primCount, primIndices, buildSettings, nullptr));
+		buildTree(*builder, 0);
+		threadCount = 1;
+	}
+
+	// what the threads built, and the nodes they built in one array, depth first
+	size_t nodeCount = 1, leafCount = 0;
+	uint32_t largestLeaf = 0;
+	int depth = 1;
+	for(unsigned int thread = 0; thread < threadCount; thread++)
+	{
+		const Arena& arena = builder->arena(thread);
+		nodeCount += arena.nodeCount;
+		leafCount += arena.leafCount;
+		largestLeaf = std::max(largestLeaf, arena.largestLeaf);
+		depth = std::max(depth, arena.depth);
+	}
+
+	nodes.reserve(nodeCount);
+	nodes.push_back(BVHNode());
+	std::vector<std::pair<uint32_t, const BuildNode*>> stack{{0, &root}};
+	while(!stack.empty())
+	{
+		uint32_t nodeIndex = stack.back().first;
+		const BuildNode* node = stack.back().second;
+		stack.pop_back();
+
+		AABB nodeBounds = node->bounds.aabb();
+		BVHNode& flat = nodes[nodeIndex];
+		flat.boundsMin = nodeBounds.min;
+		flat.boundsMax = nodeBounds.max;
+		if(!node->children)
+		{
+			flat.leftFirst = node->first;
+			flat.primCount = node->count;
+			continue;
+		}
+
+		uint32_t leftIndex = (uint32_t)nodes.size();
+		flat.leftFirst = leftIndex;
+		flat.primCount = 0;
+		nodes.push_back(BVHNode());
+		nodes.push_back(BVHNode());
+		stack.push_back({leftIndex + 1, &node->children[1]});
+		stack.push_back({leftIndex, &node->children[0]});
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	logger::Log(logger::LogLevel::DEBUG, "Built BVH over " + std::to_string(primCount) + " primitives on " + std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads")
+		+ " in " + std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()) + " ms: "
+		+ std::to_string(nodes.size()) + " nodes, " + std::to_string(leafCount) + " leaves with " + std::to_string(float(primCount) / float(leafCount)) + " primitives on average and "
+		+ std::to_string(largestLeaf) + " at most, depth " + std::to_string(depth));
+}
+
+void BVH::refit(const std::vector<Sphere>& spheres)
+{
+	refitNodes(nodes, primIndices, [&](uint32_t prim) { return sphereBounds(spheres[prim]); });
+}
+
+void BVH::refit(const std::vector<AABB>& bounds)
+{
+	refitNodes(nodes, primIndices, [&](uint32_t prim) { return bounds[prim]; });
+}
+
+float BVH::sahCost() const
+{
+	if(primIndices.empty())
+		return 0.0f;
+
+	float cost = 0.0f;
+	for(const BVHNode& node : nodes)
+	{
+		AABB bounds;
+		bounds.min = node.boundsMin;
+		bounds.max = node.boundsMax;
+		cost += bounds.area() * (node.isLeaf() ? float(node.primCount) : TRAVERSAL_COST);
+	}
+	return cost;
+}
+
+void BVH::refitOrder(std::vector<uint32_t>& order, std::vector<uint32_t>& levelOffsets) const
+{
+	order.clear();
+	levelOffsets.assign(1, 0);
+	if(primIndices.empty())
+		return;
+
+	std::vector<uint32_t> height(nodes.size());
+	uint32_t maxHeight = 0;
+	for(size_t i = nodes.size(); i-- > 0;)
+	{
+		const BVHNode& node = nodes[i];
+		height[i] = node.isLeaf() ? 0 : 1 + std::max(height[node.leftFirst], height[node.leftFirst + 1]);
+		maxHeight = std::max(maxHeight, height[i]);
+	}
+
+	// counting sort by height
+	levelOffsets.assign(maxHeight + 2, 0);
+	for(uint32_t h : height)
+		levelOffsets[h + 1]++;
+	for(uint32_t level = 1; level < levelOffsets.size(); level++)
+		levelOffsets[level] += levelOffsets[level - 1];
+	order.resize(nodes.size());
+	std::vector<uint32_t> next(levelOffsets.begin(), levelOffsets.end() - 1);
+	for(uint32_t i = 0; i < (uint32_t)nodes.size(); i++)
+		order[next[height[i]]++] = i;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "Sphere.h"
+
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(1e30f);
+	glm::vec3 max = glm::vec3(-1e30f);
+
+	void grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+	void grow(const AABB& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+
+	// half the surface area, which is all the SAH needs
+	float area() const
+	{
+		glm::vec3 e = max - min;
+		if(e.x < 0.0f)
+			return 0.0f;
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+};
+
+
+// One node of the flattened tree. The layout matches BVHNode in shaders/include/scene.glsl (std430),
+// so the node array can be copied into the storage buffer as is.
+struct BVHNode
+{
+	glm::vec3 boundsMin;
+	uint32_t  leftFirst;	// index of the left child (right child is leftFirst + 1), or the first primitive for leaves
+	glm::vec3 boundsMax;
+	uint32_t  primCount;	// 0 for inner nodes
+
+	bool isLeaf() const { return primCount > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode has to match the std430 layout in the shader");
+
+
+// what BVH::build() can be tuned with, see BVH::buildSettings
+struct BVHBuildSettings
+{
+	// nodes with more primitives are always split, smaller ones only when the SAH says it pays off
+	int maxLeafSize = 4;
+	// split candidates per axis and node, 2 to BVH::MAX_BIN_COUNT
+	int binCount = 16;
+};
+
+
+// Binned SAH bounding volume hierarchy over the spheres of a scene, or the triangles of a mesh.
+// Leaves reference primitives through primIndices, the primitives themselves are never reordered.
+//
+// Big builds run on a work-stealing TaskScheduler shared by every BVH: the two halves of a split are
+// built in parallel and the binning of the nodes near the root is split up as well. Every thread
+// allocates nodes from an arena of its own, they are put into one array in depth first order once
+// the tree is done. Scenes too small to be worth it, and builds that start while another one has
+// the scheduler (a background rebuild, say), are built on the calling thread alone.
+class BVH
+{
+public:
+	static const int MAX_BIN_COUNT = 64;
+	// deepest tree the traversal stacks in the shader and the CPU port can handle
+	static const int MAX_DEPTH = 64;
+	// a traversal step is about as expensive as a sphere or triangle test
+	static constexpr float TRAVERSAL_COST = 1.0f;
+
+	// read by every build, set it before building anything (main() sets it from the command line)
+	static BVHBuildSettings buildSettings;
+
+	void build(const std::vector<Sphere>& spheres);
+	// any kind of primitive, by its bounds, the centroids are the centers of the boxes
+	void build(const std::vector<AABB>& bounds);
+
+	// Fits the node bounds to primitives that moved, bottom up, and keeps the tree as it is. The
+	// primitives have to be the ones the tree was built over. Much cheaper than a build, but the
+	// further they move the worse the tree gets, which sahCost() tells.
+	void refit(const std::vector<Sphere>& spheres);
+	void refit(const std::vector<AABB>& bounds);
+
+	// The SAH cost of the tree: the area of every node times the cost of entering it (of testing its
+	// primitives for a leaf), summed. Divided by the area of the root it's the expected cost of a ray
+	// through the tree, left as it is it compares trees over the same primitives before and after
+	// they moved, also when that has changed the root.
+	float sahCost() const;
+
+	// Every node index grouped by height (leaves first, then the nodes right above them, ...), which
+	// is the order a refit can go in one group at a time. Group i is order[levelOffsets[i]] up to
+	// order[levelOffsets[i + 1]].
+	void refitOrder(std::vector<uint32_t>& order, std::vector<uint32_t>& levelOffsets) const;
+
+	std::vector<BVHNode>  nodes;
+	std::vector<uint32_t> primIndices;
+};
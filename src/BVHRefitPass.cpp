@@ -0,0 +1,36 @@
+#include "BVHRefitPass.h"
+#include <string>
+
+
+static const char* const REFIT_PATH = "../src/shaders/BVHRefit.comp";
+
+BVHRefitPass::BVHRefitPass(ProgramCache& programCache)
+{
+	std::vector<std::string> defines = {"REFIT_GROUP_SIZE " + std::to_string(GROUP_SIZE)};
+	program = programCache.load({{GL_COMPUTE_SHADER, REFIT_PATH, readShaderSource(REFIT_PATH, defines)}});
+}
+
+void BVHRefitPass::release()
+{
+	program.release();
+}
+
+void BVHRefitPass::run(GLuint sceneBuffer, GLuint nodeBuffer, GLuint primitiveBuffer, GLuint orderBuffer, const std::vector<uint32_t>& levelOffsets) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sceneBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, nodeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, primitiveBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, orderBuffer);
+	program.use();
+
+	// the spheres were just uploaded, the leaves can read them without a barrier
+	for(size_t level = 0; level + 1 < levelOffsets.size(); level++)
+	{
+		uint32_t count = levelOffsets[level + 1] - levelOffsets[level];
+		program.set("levelFirst", levelOffsets[level]);
+		program.set("levelCount", count);
+		glDispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		// the next level reads the nodes this one wrote
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+#include "GLItems.h"
+#include "ProgramCache.h"
+
+
+// Refits the sphere BVH where it already is, in its storage buffer, to spheres that moved (see
+// Scene::refit()), so only the spheres have to be uploaded and not the nodes. BVHRefit.comp runs
+// once per level of BVH::refitOrder(), from the leaves up, each node in a level fitting itself to
+// its spheres or to its children, which the dispatch before has finished.
+class BVHRefitPass
+{
+public:
+	static const int GROUP_SIZE = 64;  // REFIT_GROUP_SIZE
+
+	// programCache has to outlive the pass
+	explicit BVHRefitPass(ProgramCache& programCache);
+	void release();
+
+	// binds the scene's spheres, BVH nodes and primitive indices to 0, 1 and 2 like Scene::bind(), and
+	// orderBuffer, the node indices levelOffsets splits into levels, to 17
+	void run(GLuint sceneBuffer, GLuint nodeBuffer, GLuint primitiveBuffer, GLuint orderBuffer, const std::vector<uint32_t>& levelOffsets) const;
+
+private:
+	ShaderProgram program;
+};
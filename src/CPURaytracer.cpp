@@ -0,0 +1,818 @@
+#include "CPURaytracer.h"
+#include "Random.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Everything in here mirrors a function of the same name in ComputeShader.comp or its includes,
+// keep the two in sync so both backends render the same image.
+
+namespace {
+
+const float PI        = 3.1415926535f;
+const float MAX_FLOAT = 99999.99f;
+const float NO_HIT    = 1e30f;
+
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+
+struct IntersectInfo
+{
+	// surface properties
+	float     t;
+	glm::vec3 p;
+	glm::vec3 normal;
+
+	// material properties
+	int       materialType;
+	glm::vec3 albedo;
+	float     fuzz;
+	float     refractionIndex;
+};
+
+
+struct Camera
+{
+	glm::vec3 origin;
+	glm::vec3 lowerLeftCorner;
+	glm::vec3 horizontal;
+	glm::vec3 vertical;
+	glm::vec3 u, v, w;
+	float lensRadius;
+};
+
+
+// fills in rec for a hit at distance t, shared with the SIMD traversal which only finds t
+void Sphere_setHit(const Sphere& sphere, const Ray& ray, float t, IntersectInfo& rec)
+{
+	rec.t               = t;
+	rec.p               = ray.origin + rec.t * ray.direction;
+	rec.normal          = (rec.p - sphere.center) / sphere.radius;
+	rec.materialType    = sphere.materialType;
+	rec.albedo          = sphere.albedo;
+	rec.fuzz            = sphere.fuzz;
+	rec.refractionIndex = sphere.refractionIndex;
+}
+
+bool Sphere_hit(const Sphere& sphere, const Ray& ray, float t_min, float t_max, IntersectInfo& rec)
+{
+	glm::vec3 oc = ray.origin - sphere.center;
+	float a = glm::dot(ray.direction, ray.direction);
+	float b = glm::dot(oc, ray.direction);
+	float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+
+	float discriminant = b * b - a * c;
+
+	if(discriminant > 0.0f)
+	{
+		float temp = (-b - std::sqrt(discriminant)) / a;
+
+		if(!(temp < t_max && temp > t_min))
+			temp = (-b + std::sqrt(discriminant)) / a;
+
+		if(temp < t_max && temp > t_min)
+		{
+			Sphere_setHit(sphere, ray, temp, rec);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// the positions of triangle triangle of mesh
+void Mesh_triangle(const Mesh& mesh, uint32_t triangle, glm::vec3& v0, glm::vec3& v1, glm::vec3& v2)
+{
+	const uint32_t* indices = &mesh.indices[(size_t)triangle * 3];
+	v0 = mesh.vertices[indices[0]].position;
+	v1 = mesh.vertices[indices[1]].position;
+	v2 = mesh.vertices[indices[2]].position;
+}
+
+// Moeller-Trumbore, distance to the intersection in (t_min, t_max) or NO_HIT, both sides count
+float Triangle_hit(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const Ray& ray, float t_min, float t_max)
+{
+	glm::vec3 edge1 = v1 - v0;
+	glm::vec3 edge2 = v2 - v0;
+	glm::vec3 pvec = glm::cross(ray.direction, edge2);
+	float det = glm::dot(edge1, pvec);
+
+	// parallel to the triangle
+	if(det == 0.0f)
+		return NO_HIT;
+	float invDet = 1.0f / det;
+
+	glm::vec3 tvec = ray.origin - v0;
+	float u = glm::dot(tvec, pvec) * invDet;
+	if(u < 0.0f || u > 1.0f)
+		return NO_HIT;
+
+	glm::vec3 qvec = glm::cross(tvec, edge1);
+	float v = glm::dot(ray.direction, qvec) * invDet;
+	if(v < 0.0f || u + v > 1.0f)
+		return NO_HIT;
+
+	float t = glm::dot(edge2, qvec) * invDet;
+	if(t < t_max && t > t_min)
+		return t;
+	return NO_HIT;
+}
+
+// fills in the distance and the normal of a hit on triangle of mesh, the ray is in the space of the mesh
+// and so is the normal, Instance_setHit() finishes the record
+void Mesh_setHit(const Mesh& mesh, uint32_t triangle, const Ray& ray, float t, IntersectInfo& rec)
+{
+	const uint32_t* indices = &mesh.indices[(size_t)triangle * 3];
+	const MeshVertex& a = mesh.vertices[indices[0]];
+	const MeshVertex& b = mesh.vertices[indices[1]];
+	const MeshVertex& c = mesh.vertices[indices[2]];
+
+	rec.t = t;
+
+	// barycentric coordinates of the hit, for the vertex normals
+	glm::vec3 edge1 = b.position - a.position;
+	glm::vec3 edge2 = c.position - a.position;
+	glm::vec3 toHit = ray.origin + t * ray.direction - a.position;
+	float d11 = glm::dot(edge1, edge1);
+	float d12 = glm::dot(edge1, edge2);
+	float d22 = glm::dot(edge2, edge2);
+	float dp1 = glm::dot(toHit, edge1);
+	float dp2 = glm::dot(toHit, edge2);
+	float denom = d11 * d22 - d12 * d12;
+	float u = denom != 0.0f ? (d22 * dp1 - d12 * dp2) / denom : 0.0f;
+	float v = denom != 0.0f ? (d11 * dp2 - d12 * dp1) / denom : 0.0f;
+
+	rec.normal = (1.0f - u - v) * a.normal + u * b.normal + v * c.normal;
+	if(glm::dot(rec.normal, rec.normal) == 0.0f)
+		rec.normal = glm::cross(edge1, edge2);
+}
+
+// the ray in the space of the mesh of instance, the direction isn't normalized so t stays the same
+Ray Instance_objectRay(const InstanceInfo& instance, const Ray& ray)
+{
+	glm::vec4 origin(ray.origin, 1.0f);
+	glm::vec4 direction(ray.direction, 0.0f);
+	Ray objectRay;
+	objectRay.origin = glm::vec3(glm::dot(instance.worldToObject[0], origin), glm::dot(instance.worldToObject[1], origin), glm::dot(instance.worldToObject[2], origin));
+	objectRay.direction = glm::vec3(glm::dot(instance.worldToObject[0], direction), glm::dot(instance.worldToObject[1], direction), glm::dot(instance.worldToObject[2], direction));
+	return objectRay;
+}
+
+// the rest of a hit record Mesh_setHit() started, ray is in world space
+void Instance_setHit(const InstanceInfo& instance, const Material& material, const Ray& ray, IntersectInfo& rec)
+{
+	rec.p = ray.origin + rec.t * ray.direction;
+
+	// normals go to world space with the transpose of the inverse, whose columns are the rows we have
+	glm::vec3 normal = rec.normal;
+	rec.normal = glm::normalize(normal.x * glm::vec3(instance.worldToObject[0]) + normal.y * glm::vec3(instance.worldToObject[1]) + normal.z * glm::vec3(instance.worldToObject[2]));
+
+	// only glass needs to know which side is outside, everything else scatters off the side the ray came from
+	if(material.materialType != DIELECTRIC && glm::dot(rec.normal, ray.direction) > 0.0f)
+		rec.normal = -rec.normal;
+
+	rec.materialType    = material.materialType;
+	rec.albedo          = material.albedo;
+	rec.fuzz            = material.fuzz;
+	rec.refractionIndex = material.refractionIndex;
+}
+
+
+// Schlick's approximation of the Fresnel factor
+float schlick(float cos_theta, float n2)
+{
+	const float n1 = 1.0f; // refraction index for air
+
+	float r0s = (n1 - n2) / (n1 + n2);
+	float r0 = r0s * r0s;
+
+	return r0 + (1.0f - r0) * std::pow((1.0f - cos_theta), 5.0f);
+}
+
+
+bool refractVec(const glm::vec3& v, const glm::vec3& n, float ni_over_nt, glm::vec3& refracted)
+{
+	glm::vec3 uv = glm::normalize(v);
+
+	float dt = glm::dot(uv, n);
+
+	float discriminant = 1.0f - ni_over_nt * ni_over_nt * (1.0f - dt * dt);
+
+	if(discriminant > 0.0f)
+	{
+		refracted = ni_over_nt * (uv - n * dt) - n * std::sqrt(discriminant);
+		return true;
+	}
+	return false;
+}
+
+
+// random direction in unit sphere (for lambert brdf)
+glm::vec3 random_in_unit_sphere(uint32_t& rngState)
+{
+	float phi = 2.0f * PI * randomFloat(rngState);
+	float cosTheta = 2.0f * randomFloat(rngState) - 1.0f;
+	float u = randomFloat(rngState);
+
+	float theta = std::acos(cosTheta);
+	float r = std::pow(u, 1.0f / 3.0f);
+
+	float x = r * std::sin(theta) * std::cos(phi);
+	float y = r * std::sin(theta) * std::sin(phi);
+	float z = r * std::cos(theta);
+
+	return glm::vec3(x, y, z);
+}
+
+
+// random point on unit disk (for depth of field camera)
+glm::vec3 random_in_unit_disk(uint32_t& rngState)
+{
+	float spx = 2.0f * randomFloat(rngState) - 1.0f;
+	float spy = 2.0f * randomFloat(rngState) - 1.0f;
+
+	float r, phi;
+
+	if(spx > -spy)
+	{
+		if(spx > spy)
+		{
+			r = spx;
+			phi = spy / spx;
+		}
+		else
+		{
+			r = spy;
+			phi = 2.0f - spx / spy;
+		}
+	}
+	else
+	{
+		if(spx < spy)
+		{
+			r = -spx;
+			phi = 4.0f + spy / spx;
+		}
+		else
+		{
+			r = -spy;
+
+			if(spy != 0.0f)
+				phi = 6.0f - spx / spy;
+			else
+				phi = 0.0f;
+		}
+	}
+
+	phi *= PI / 4.0f;
+
+	return glm::vec3(r * std::cos(phi), r * std::sin(phi), 0.0f);
+}
+
+
+// vfov is top to bottom in degrees
+void Camera_init(Camera& camera, glm::vec3 lookfrom, glm::vec3 lookat, glm::vec3 vup, float vfov, float aspect, float aperture, float focusDist)
+{
+	camera.lensRadius = aperture / 2.0f;
+
+	float theta = vfov * PI / 180.0f;
+	float halfHeight = std::tan(theta / 2.0f);
+	float halfWidth = aspect * halfHeight;
+
+	camera.origin = lookfrom;
+
+	camera.w = glm::normalize(lookfrom - lookat);
+	camera.u = glm::normalize(glm::cross(vup, camera.w));
+	camera.v = glm::cross(camera.w, camera.u);
+
+	camera.lowerLeftCorner = camera.origin - halfWidth  * focusDist * camera.u
+					       - halfHeight * focusDist * camera.v
+					       -              focusDist * camera.w;
+
+	camera.horizontal = 2.0f * halfWidth  * focusDist * camera.u;
+	camera.vertical   = 2.0f * halfHeight * focusDist * camera.v;
+}
+
+
+Ray Camera_getRay(const Camera& camera, float s, float t, uint32_t& rngState)
+{
+	glm::vec3 rd = camera.lensRadius * random_in_unit_disk(rngState);
+	glm::vec3 offset = camera.u * rd.x + camera.v * rd.y;
+
+	Ray ray;
+	ray.origin = camera.origin + offset;
+	ray.direction = camera.lowerLeftCorner + s * camera.horizontal + t * camera.vertical - camera.origin - offset;
+
+	return ray;
+}
+
+
+bool Material_bsdf(const IntersectInfo& isectInfo, const Ray& wo, Ray& wi, glm::vec3& attenuation, uint32_t& rngState)
+{
+	int materialType = isectInfo.materialType;
+
+	if(materialType == LAMBERT)
+	{
+		glm::vec3 target = isectInfo.p + isectInfo.normal + random_in_unit_sphere(rngState);
+
+		wi.origin = isectInfo.p;
+		wi.direction = target - isectInfo.p;
+
+		attenuation = isectInfo.albedo;
+
+		return true;
+	}
+	else if(materialType == METAL)
+	{
+		float fuzz = isectInfo.fuzz;
+
+		glm::vec3 reflected = glm::reflect(glm::normalize(wo.direction), isectInfo.normal);
+
+		wi.origin = isectInfo.p;
+		wi.direction = reflected + fuzz * random_in_unit_sphere(rngState);
+
+		attenuation = isectInfo.albedo;
+
+		return (glm::dot(wi.direction, isectInfo.normal) > 0.0f);
+	}
+	else if(materialType == DIELECTRIC)
+	{
+		glm::vec3 outward_normal;
+		glm::vec3 reflected = glm::reflect(wo.direction, isectInfo.normal);
+
+		float ni_over_nt;
+
+		attenuation = glm::vec3(1.0f, 1.0f, 1.0f);
+		glm::vec3 refracted;
+		float reflect_prob;
+		float cosine;
+
+		float refractionIndex = isectInfo.refractionIndex;
+
+		if(glm::dot(wo.direction, isectInfo.normal) > 0.0f)
+		{
+			outward_normal = -isectInfo.normal;
+			ni_over_nt = refractionIndex;
+
+			cosine = glm::dot(wo.direction, isectInfo.normal) / glm::length(wo.direction);
+			cosine = std::sqrt(1.0f - refractionIndex * refractionIndex * (1.0f - cosine * cosine));
+		}
+		else
+		{
+			outward_normal = isectInfo.normal;
+			ni_over_nt = 1.0f / refractionIndex;
+			cosine = -glm::dot(wo.direction, isectInfo.normal) / glm::length(wo.direction);
+		}
+		if(refractVec(wo.direction, outward_normal, ni_over_nt, refracted))
+			reflect_prob = schlick(cosine, refractionIndex);
+		else
+			reflect_prob = 1.0f;
+
+		wi.origin = isectInfo.p;
+		if(randomFloat(rngState) < reflect_prob)
+			wi.direction = reflected;
+		else
+			wi.direction = refracted;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+// distance at which the ray enters the box, or NO_HIT
+float AABB_hit(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const Ray& ray, const glm::vec3& invDir, float t_min, float t_max)
+{
+	glm::vec3 t0 = (boundsMin - ray.origin) * invDir;
+	glm::vec3 t1 = (boundsMax - ray.origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, t_min));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, t_max));
+
+	return enter <= exit ? enter : NO_HIT;
+}
+
+
+// the scene as a path sees it, simd is nullptr for the scalar traversal
+struct SceneView
+{
+	const std::vector<Sphere>& sceneList;
+	const std::vector<Mesh>& meshes;
+	const std::vector<MeshInstance>& instances;
+	// in the order of the tlas leaves
+	const std::vector<InstanceInfo>& instanceInfos;
+	const BVH& tlas;
+	const BVH& bvh;
+	const SphereSoA& soa;
+	const SimdBackend* simd;
+	SimdScene simdScene;
+};
+
+// what a camera ray packet already found, so radiance() doesn't trace the first ray again
+struct PrimaryHit
+{
+	bool hit;
+	IntersectInfo rec;
+};
+
+
+bool intersectSpheres(const SceneView& view, const Ray& ray, float t_min, float t_max, IntersectInfo& rec)
+{
+	if(view.simd)
+	{
+		float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+		float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+		int hit = view.simd->closestHit(view.simdScene, origin, direction, t_min, t_max);
+		if(hit < 0)
+			return false;
+		Sphere_setHit(view.sceneList[view.soa.sphereIndex[hit]], ray, t_max, rec);
+		return true;
+	}
+
+	const std::vector<Sphere>& sceneList = view.sceneList;
+	const BVH& bvh = view.bvh;
+	IntersectInfo temp_rec;
+
+	bool hit_anything = false;
+	float closest_so_far = t_max;
+
+	const BVHNode* nodes = bvh.nodes.data();
+	const uint32_t* primIndices = bvh.primIndices.data();
+	glm::vec3 invDir = 1.0f / ray.direction;
+
+	if(AABB_hit(nodes[0].boundsMin, nodes[0].boundsMax, ray, invDir, t_min, closest_so_far) == NO_HIT)
+		return false;
+
+	uint32_t stack[BVH::MAX_DEPTH];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while(true)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+		if(node.isLeaf())
+		{
+			for(uint32_t i = 0; i < node.primCount; i++)
+			{
+				if(Sphere_hit(sceneList[primIndices[node.leftFirst + i]], ray, t_min, closest_so_far, temp_rec))
+				{
+					hit_anything   = true;
+					closest_so_far = temp_rec.t;
+					rec            = temp_rec;
+				}
+			}
+		}
+		else
+		{
+			// visit the nearer child first, the other one goes on the stack
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			float nearDist = AABB_hit(nodes[nearChild].boundsMin, nodes[nearChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			float farDist = AABB_hit(nodes[farChild].boundsMin, nodes[farChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			if(farDist < nearDist)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearDist, farDist);
+			}
+
+			if(nearDist != NO_HIT)
+			{
+				if(farDist != NO_HIT)
+					stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if(stackSize == 0)
+			break;
+		nodeIndex = stack[--stackSize];
+	}
+
+	return hit_anything;
+}
+
+// the same for the triangles of mesh, with the ray in the space of the mesh, closest_so_far is pulled
+// in to every hit on the way
+bool intersectMesh(const Mesh& mesh, const Ray& ray, const glm::vec3& invDir, float t_min, float& closest_so_far, uint32_t& hitTriangle)
+{
+	const BVHNode* nodes = mesh.nodes.data();
+	if(AABB_hit(nodes[0].boundsMin, nodes[0].boundsMax, ray, invDir, t_min, closest_so_far) == NO_HIT)
+		return false;
+
+	bool hit_anything = false;
+
+	uint32_t stack[BVH::MAX_DEPTH];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while(true)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+		if(node.isLeaf())
+		{
+			for(uint32_t i = 0; i < node.primCount; i++)
+			{
+				glm::vec3 v0, v1, v2;
+				Mesh_triangle(mesh, node.leftFirst + i, v0, v1, v2);
+				float t = Triangle_hit(v0, v1, v2, ray, t_min, closest_so_far);
+				if(t != NO_HIT)
+				{
+					hit_anything   = true;
+					closest_so_far = t;
+					hitTriangle    = node.leftFirst + i;
+				}
+			}
+		}
+		else
+		{
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			float nearDist = AABB_hit(nodes[nearChild].boundsMin, nodes[nearChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			float farDist = AABB_hit(nodes[farChild].boundsMin, nodes[farChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			if(farDist < nearDist)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearDist, farDist);
+			}
+
+			if(nearDist != NO_HIT)
+			{
+				if(farDist != NO_HIT)
+					stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if(stackSize == 0)
+			break;
+		nodeIndex = stack[--stackSize];
+	}
+
+	return hit_anything;
+}
+
+// instances hit closer than t_max, after the spheres have been looked at, rec is only written if there is one
+bool intersectInstances(const SceneView& view, const Ray& ray, float t_min, float t_max, IntersectInfo& rec)
+{
+	if(view.instances.empty())
+		return false;
+
+	const BVHNode* nodes = view.tlas.nodes.data();
+	glm::vec3 invDir = 1.0f / ray.direction;
+	if(AABB_hit(nodes[0].boundsMin, nodes[0].boundsMax, ray, invDir, t_min, t_max) == NO_HIT)
+		return false;
+
+	bool hit_anything = false;
+	float closest_so_far = t_max;
+	uint32_t hitInstance = 0;
+	uint32_t hitTriangle = 0;
+
+	uint32_t stack[BVH::MAX_DEPTH];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while(true)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+		if(node.isLeaf())
+		{
+			for(uint32_t i = node.leftFirst; i < node.leftFirst + node.primCount; i++)
+			{
+				const Mesh& mesh = view.meshes[view.instances[view.tlas.primIndices[i]].mesh];
+				Ray objectRay = Instance_objectRay(view.instanceInfos[i], ray);
+				if(intersectMesh(mesh, objectRay, 1.0f / objectRay.direction, t_min, closest_so_far, hitTriangle))
+				{
+					hit_anything = true;
+					hitInstance  = i;
+				}
+			}
+		}
+		else
+		{
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			float nearDist = AABB_hit(nodes[nearChild].boundsMin, nodes[nearChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			float farDist = AABB_hit(nodes[farChild].boundsMin, nodes[farChild].boundsMax, ray, invDir, t_min, closest_so_far);
+			if(farDist < nearDist)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearDist, farDist);
+			}
+
+			if(nearDist != NO_HIT)
+			{
+				if(farDist != NO_HIT)
+					stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if(stackSize == 0)
+			break;
+		nodeIndex = stack[--stackSize];
+	}
+
+	// the hit record is only worked out for the closest triangle, like in the shader
+	if(hit_anything)
+	{
+		const MeshInstance& instance = view.instances[view.tlas.primIndices[hitInstance]];
+		const InstanceInfo& info = view.instanceInfos[hitInstance];
+		Mesh_setHit(view.meshes[instance.mesh], hitTriangle, Instance_objectRay(info, ray), closest_so_far, rec);
+		Instance_setHit(info, instance.material, ray, rec);
+	}
+	return hit_anything;
+}
+
+bool intersectScene(const SceneView& view, const Ray& ray, float t_min, float t_max, IntersectInfo& rec)
+{
+	bool hit = !view.sceneList.empty() && intersectSpheres(view, ray, t_min, t_max, rec);
+	if(intersectInstances(view, ray, t_min, hit ? rec.t : t_max, rec))
+		hit = true;
+	return hit;
+}
+
+
+glm::vec3 skyColor(const Ray& ray)
+{
+	glm::vec3 unit_direction = glm::normalize(ray.direction);
+	float t = 0.5f * (unit_direction.y + 1.0f);
+
+	return (1.0f - t) * glm::vec3(1.0f, 1.0f, 1.0f) + t * glm::vec3(0.5f, 0.7f, 1.0f);
+}
+
+
+// tracedRays counts every ray sent into the scene, like tracedRays in the shader
+glm::vec3 radiance(const SceneView& view, Ray ray, int maxDepth, uint32_t& rngState, uint64_t& tracedRays, const PrimaryHit* primary = nullptr)
+{
+	IntersectInfo rec;
+
+	glm::vec3 col = glm::vec3(1.0f, 1.0f, 1.0f);
+
+	for(int i = 0; i < maxDepth; i++)
+	{
+		tracedRays++;
+		bool hit;
+		if(i == 0 && primary)
+		{
+			hit = primary->hit;
+			rec = primary->rec;
+		}
+		else
+			hit = intersectScene(view, ray, 0.001f, MAX_FLOAT, rec);
+
+		if(hit)
+		{
+			Ray wi;
+			glm::vec3 attenuation;
+
+			bool wasScattered = Material_bsdf(rec, ray, wi, attenuation, rngState);
+
+			ray = wi;
+
+			if(wasScattered)
+				col *= attenuation;
+			else
+			{
+				col = glm::vec3(0.0f, 0.0f, 0.0f);
+				break;
+			}
+		}
+		else
+		{
+			col *= skyColor(ray);
+			break;
+		}
+	}
+
+	return col;
+}
+
+}
+
+
+CPURaytracer::CPURaytracer(unsigned int threadCount)
+	: pool(threadCount), simd(bestSimdBackend())
+{
+}
+
+void CPURaytracer::render(const Scene& scene, const RenderSettings& settings, int width, int height, std::vector<float>& pixels)
+{
+	pixels.resize((size_t)width * height * 4);
+	accumulation.resize((size_t)width * height);
+
+	float distToFocus = 10.0f;
+	float aperture = 0.1f;
+
+	Camera camera;
+	Camera_init(camera, settings.lookFrom, settings.lookAt, glm::vec3(0.0f, 1.0f, 0.0f), 20.0f, float(width) / float(height), aperture, distToFocus);
+
+	SceneView view = {scene.spheres, scene.meshes, scene.instances, scene.instanceInfos(), scene.tlas, scene.bvh, scene.soa, simd, makeSimdScene(scene.soa, scene.bvh)};
+	// a packet of camera rays per simd->width pixels of a row, one pixel at a time without SIMD
+	int packetWidth = simd ? simd->width : 1;
+
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	std::atomic<uint64_t> frameRays{0};
+	pool.parallelFor(tilesX * tilesY, [&](unsigned int tile, unsigned int)
+	{
+		uint64_t tileRays = 0;
+		int x0 = (tile % tilesX) * TILE_SIZE;
+		int y0 = (tile / tilesX) * TILE_SIZE;
+		int x1 = std::min(x0 + TILE_SIZE, width);
+		int y1 = std::min(y0 + TILE_SIZE, height);
+
+		for(int y = y0; y < y1; y++)
+		for(int x = x0; x < x1; x += packetWidth)
+		{
+			int count = std::min(packetWidth, x1 - x);
+			glm::vec3 col[RayPacket::MAX_SIZE];
+			for(int lane = 0; lane < count; lane++)
+				col[lane] = glm::vec3(0.0f, 0.0f, 0.0f);
+
+			for(int s = 0; s < settings.numSamples; s++)
+			{
+				Ray rays[RayPacket::MAX_SIZE];
+				uint32_t rngStates[RayPacket::MAX_SIZE];
+				for(int lane = 0; lane < count; lane++)
+				{
+					// the frame goes into the seed, otherwise every frame draws the same samples and nothing converges
+					uint32_t& rngState = rngStates[lane];
+					rngState = rngSeed(x + lane, y, s, settings.frameIndex);
+					float u = (float(x + lane) + randomFloat(rngState)) / float(width);
+					float v = (float(y) + randomFloat(rngState)) / float(height);
+					rays[lane] = Camera_getRay(camera, u, v, rngState);
+				}
+
+				if(!view.simd)
+				{
+					col[0] += radiance(view, rays[0], settings.maxDepth, rngStates[0], tileRays);
+					continue;
+				}
+
+				// neighbouring camera rays take nearly the same way through the BVH, so they go through it together
+				RayPacket packet;
+				packet.size = count;
+				float tMax[RayPacket::MAX_SIZE];
+				int hits[RayPacket::MAX_SIZE];
+				for(int lane = 0; lane < count; lane++)
+				{
+					packet.originX[lane] = rays[lane].origin.x;
+					packet.originY[lane] = rays[lane].origin.y;
+					packet.originZ[lane] = rays[lane].origin.z;
+					packet.directionX[lane] = rays[lane].direction.x;
+					packet.directionY[lane] = rays[lane].direction.y;
+					packet.directionZ[lane] = rays[lane].direction.z;
+					tMax[lane] = MAX_FLOAT;
+				}
+				// the lanes past count are loaded too, they only have to hold numbers
+				for(int lane = count; lane < RayPacket::MAX_SIZE; lane++)
+				{
+					packet.originX[lane] = packet.originY[lane] = packet.originZ[lane] = 0.0f;
+					packet.directionX[lane] = packet.directionY[lane] = packet.directionZ[lane] = 1.0f;
+				}
+				view.simd->closestHitPacket(view.simdScene, packet, 0.001f, tMax, hits);
+
+				for(int lane = 0; lane < count; lane++)
+				{
+					PrimaryHit primary;
+					primary.hit = hits[lane] >= 0;
+					if(primary.hit)
+						Sphere_setHit(scene.spheres[scene.soa.sphereIndex[hits[lane]]], rays[lane], tMax[lane], primary.rec);
+					// the packets only know spheres, the instances get one ray at a time
+					if(intersectInstances(view, rays[lane], 0.001f, tMax[lane], primary.rec))
+						primary.hit = true;
+					col[lane] += radiance(view, rays[lane], settings.maxDepth, rngStates[lane], tileRays, &primary);
+				}
+			}
+
+			for(int lane = 0; lane < count; lane++)
+			{
+				glm::vec3 color = col[lane] / float(settings.numSamples);
+
+				glm::vec3& average = accumulation[(size_t)y * width + x + lane];
+				if(settings.frameIndex > 0)
+					color = glm::mix(average, color, 1.0f / float(settings.frameIndex + 1));
+				average = color;
+
+				color = glm::sqrt(color);
+
+				float* pixel = &pixels[((size_t)y * width + x + lane) * 4];
+				pixel[0] = color.x;
+				pixel[1] = color.y;
+				pixel[2] = color.z;
+				pixel[3] = 1.0f;
+			}
+		}
+		frameRays += tileRays;
+	});
+	lastFrameRays = frameRays;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "RenderSettings.h"
+#include "Scene.h"
+#include "SimdTraversal.h"
+#include "ThreadPool.h"
+
+
+// C++ port of ComputeShader.comp, for machines without a GPU.
+// The image is split into TILE_SIZE x TILE_SIZE tiles which are handed out to a thread pool.
+// Rays are intersected with the widest SIMD backend the CPU has (SimdTraversal.h), camera rays
+// of neighbouring pixels in packets, unless setSimdBackend() says otherwise.
+class CPURaytracer
+{
+public:
+	static const int TILE_SIZE = 16;
+
+	// threadCount of 0 uses every hardware thread
+	explicit CPURaytracer(unsigned int threadCount = 0);
+
+	// renders into an RGBA32F buffer with the same layout as screenTex (first row is the bottom one)
+	void render(const Scene& scene, const RenderSettings& settings, int width, int height, std::vector<float>& pixels);
+
+	unsigned int threadCount() const { return pool.size(); }
+	// nullptr traces one ray at a time with the plain C++ port
+	void setSimdBackend(const SimdBackend* backend) { simd = backend; }
+	const SimdBackend* simdBackend() const { return simd; }
+	// rays traced by the last render(), bounces included
+	uint64_t raysPerFrame() const { return lastFrameRays; }
+
+private:
+	ThreadPool pool;
+	const SimdBackend* simd;
+	uint64_t lastFrameRays = 0;
+	// running average in linear color, same as the accumulation image of the compute shader
+	std::vector<glm::vec3> accumulation;
+};
@@ -0,0 +1,319 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "ImageWriter.h"
+#include "logger.h"
+
+
+static float halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if(exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if(exponent != 0)
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	else if(mantissa == 0)
+		bits = sign;
+	else
+	{
+		// denormal, normalize it
+		exponent = 127 - 15 + 1;
+		while(!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// the unsigned 11 and 10 bit floats of R11F_G11F_B10F have the exponent of a half, so they only need their mantissa widened
+static float smallFloatToFloat(uint32_t value, int mantissaBits)
+{
+	uint32_t exponent = value >> mantissaBits;
+	uint32_t mantissa = value & ((1u << mantissaBits) - 1);
+	return halfToFloat((uint16_t)((exponent << 10) | (mantissa << (10 - mantissaBits))));
+}
+
+
+bool FrameCapture::start(const std::string& outputPath, CaptureFormat captureFormat, glm::ivec2 frameSize)
+{
+	if(capturing)
+		stop();
+
+	format = captureFormat;
+	output = outputPath;
+	size = frameSize;
+	std::error_code error;
+	if(format == CaptureFormat::RAW)
+	{
+		std::filesystem::path parent = std::filesystem::path(output).parent_path();
+		if(!parent.empty())
+			std::filesystem::create_directories(parent, error);
+		// opening a FIFO waits for its reader, so start that (e.g. ffmpeg) first
+		rawFile.open(output, std::ios::binary);
+		if(!rawFile.is_open())
+		{
+			logger::Log(logger::LogLevel::ERROR, "Failed to open capture output: " + output);
+			return false;
+		}
+	}
+	else if(!std::filesystem::create_directories(output, error) && error)
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to create capture directory " + output + ": " + error.message());
+		return false;
+	}
+
+	captured = 0;
+	written = 0;
+	dropped = 0;
+	nextFrame = 0;
+	quit = false;
+	capturing = true;
+	writer = std::thread(&FrameCapture::writerLoop, this);
+
+	logger::Log(logger::LogLevel::INFO, "Capturing " + std::to_string(size.x) + "x" + std::to_string(size.y) + " frames to " + output);
+	return true;
+}
+
+void FrameCapture::stop()
+{
+	if(!capturing)
+		return;
+
+	// the copies in flight are finished rather than thrown away, the user asked to stop so waiting is fine
+	for(Slot& slot : slots)
+		if(slot.state == COPYING)
+			glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	poll();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	writer.join();
+	if(rawFile.is_open())
+		rawFile.close();
+	capturing = false;
+
+	logger::Log(logger::LogLevel::INFO, "Captured " + std::to_string(written) + " frames to " + output + ", dropped " + std::to_string(dropped));
+}
+
+void FrameCapture::release()
+{
+	stop();
+	for(Slot& slot : slots)
+	{
+		if(!slot.buffer)
+			continue;
+		glUnmapNamedBuffer(slot.buffer);
+		glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+		slot.capacity = 0;
+		slot.mapped = nullptr;
+	}
+}
+
+void FrameCapture::capture(const RenderTarget& target)
+{
+	if(!capturing)
+		return;
+
+	if(target.renderSize() != size)
+	{
+		glm::ivec2 renderSize = target.renderSize();
+		drop("it is " + std::to_string(renderSize.x) + "x" + std::to_string(renderSize.y) + " instead of " + std::to_string(size.x) + "x" + std::to_string(size.y));
+		return;
+	}
+
+	Slot* slot = nullptr;
+	for(Slot& candidate : slots)
+		if(candidate.state == FREE)
+		{
+			slot = &candidate;
+			break;
+		}
+	if(!slot)
+	{
+		bool writerBehind = std::any_of(std::begin(slots), std::end(slots), [](const Slot& s) { return s.state == WRITING; });
+		drop(writerBehind ? "the writer is behind" : "the GPU is behind");
+		return;
+	}
+
+	// EXR frames want more than 8 bits, an RGBA8 screen is skipped for the accumulation image when that has the frame
+	CopyLayout layout = SCREEN_RGBA8;
+	if(format == CaptureFormat::EXR)
+	{
+		if(target.screenFormat() == ScreenFormat::RGBA16F)
+			layout = SCREEN_RGBA16F;
+		else if(target.screenFormat() == ScreenFormat::R11F_G11F_B10F)
+			layout = SCREEN_R11F_G11F_B10F;
+		else if(target.hasLinearColor())
+			layout = LINEAR_RGBA16F;
+	}
+
+	int pixelSize = layout == SCREEN_RGBA16F || layout == LINEAR_RGBA16F ? 8 : 4;
+	GLsizeiptr bytes = (GLsizeiptr)size.x * size.y * pixelSize;
+	if(slot->capacity < bytes)
+	{
+		// the slot is free, so nothing reads the old buffer any more
+		if(slot->buffer)
+		{
+			glUnmapNamedBuffer(slot->buffer);
+			glDeleteBuffers(1, &slot->buffer);
+		}
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &slot->buffer);
+		glNamedBufferStorage(slot->buffer, bytes, nullptr, flags);
+		slot->mapped = (const uint8_t*)glMapNamedBufferRange(slot->buffer, 0, bytes, flags);
+		slot->capacity = bytes;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+	if(layout == LINEAR_RGBA16F)
+		glGetTextureSubImage(target.accumulationTexture(), 0, 0, 0, 0, size.x, size.y, 1, GL_RGBA, GL_HALF_FLOAT, (GLsizei)bytes, nullptr);
+	else if(layout == SCREEN_RGBA16F)
+		glGetTextureSubImage(target.screenTexture(), 0, 0, 0, 0, size.x, size.y, 1, GL_RGBA, GL_HALF_FLOAT, (GLsizei)bytes, nullptr);
+	else if(layout == SCREEN_R11F_G11F_B10F)
+		glGetTextureSubImage(target.screenTexture(), 0, 0, 0, 0, size.x, size.y, 1, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, (GLsizei)bytes, nullptr);
+	else
+		glGetTextureSubImage(target.screenTexture(), 0, 0, 0, 0, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, (GLsizei)bytes, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	slot->layout = layout;
+	slot->width = size.x;
+	slot->height = size.y;
+	slot->frame = nextFrame++;
+	slot->state = COPYING;
+	captured++;
+}
+
+void FrameCapture::poll()
+{
+	if(!capturing)
+		return;
+
+	std::vector<Slot*> finished;
+	for(Slot& slot : slots)
+	{
+		if(slot.state != COPYING)
+			continue;
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		finished.push_back(&slot);
+	}
+	if(finished.empty())
+		return;
+
+	// raw streams have to stay in order
+	std::sort(finished.begin(), finished.end(), [](const Slot* a, const Slot* b) { return a->frame < b->frame; });
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(Slot* slot : finished)
+		{
+			slot->state = WRITING;
+			queue.push_back((int)(slot - slots));
+		}
+	}
+	wake.notify_one();
+}
+
+void FrameCapture::drop(const std::string& reason)
+{
+	dropped++;
+	// 1, 2, 4, 8, ... so a long capture doesn't flood the log
+	if((dropped & (dropped - 1)) == 0)
+		logger::Log(logger::LogLevel::WARNING, "Dropped a captured frame, " + reason + " (" + std::to_string(dropped) + " dropped so far)");
+}
+
+
+void FrameCapture::writerLoop()
+{
+	while(true)
+	{
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return quit || !queue.empty(); });
+			if(queue.empty())
+				return;
+			index = queue.front();
+			queue.pop_front();
+		}
+
+		writeFrame(slots[index]);
+		written++;
+		slots[index].state = FREE;
+	}
+}
+
+void FrameCapture::writeFrame(const Slot& slot)
+{
+	size_t pixelCount = (size_t)slot.width * slot.height;
+	if(format == CaptureFormat::RAW)
+	{
+		// top row first, the copy has the bottom one first like screenTex
+		size_t rowSize = (size_t)slot.width * 4;
+		for(int y = slot.height - 1; y >= 0; y--)
+			rawFile.write((const char*)slot.mapped + y * rowSize, rowSize);
+		if(!rawFile.good())
+			logger::Log(logger::LogLevel::ERROR, "Failed to write frame " + std::to_string(slot.frame) + " to " + output);
+		return;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%05llu.%s", (unsigned long long)slot.frame, format == CaptureFormat::EXR ? "exr" : "png");
+	std::string path = (std::filesystem::path(output) / name).string();
+
+	if(format == CaptureFormat::EXR)
+	{
+		// writeImage takes the square root of the color, like screenTex has
+		std::vector<float> pixels(pixelCount * 4);
+		if(slot.layout == SCREEN_RGBA8)
+		{
+			for(size_t i = 0; i < pixels.size(); i++)
+				pixels[i] = slot.mapped[i] / 255.0f;
+		}
+		else if(slot.layout == SCREEN_R11F_G11F_B10F)
+		{
+			const uint32_t* packed = (const uint32_t*)slot.mapped;
+			for(size_t i = 0; i < pixelCount; i++)
+			{
+				pixels[i * 4 + 0] = smallFloatToFloat(packed[i] & 0x7FF, 6);
+				pixels[i * 4 + 1] = smallFloatToFloat((packed[i] >> 11) & 0x7FF, 6);
+				pixels[i * 4 + 2] = smallFloatToFloat(packed[i] >> 22, 5);
+				pixels[i * 4 + 3] = 1.0f;
+			}
+		}
+		else
+		{
+			const uint16_t* halves = (const uint16_t*)slot.mapped;
+			for(size_t i = 0; i < pixels.size(); i++)
+				pixels[i] = slot.layout == LINEAR_RGBA16F ? std::sqrt(halfToFloat(halves[i])) : halfToFloat(halves[i]);
+		}
+		writeImage(path, slot.width, slot.height, pixels, false);
+	}
+	else
+	{
+		std::vector<uint8_t> pixels(slot.mapped, slot.mapped + pixelCount * 4);
+		writeImage(path, slot.width, slot.height, pixels, false);
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "RenderTarget.h"
+
+
+// what captured frames are written as
+enum class CaptureFormat
+{
+	PNG,	// frame_00000.png, ... in the output directory
+	EXR,	// frame_00000.exr, ... with the linear color, as half floats, copied in the screen's format unless that is RGBA8
+	RAW		// every frame appended to one file (or FIFO) as top-down RGBA8, for e.g. ffmpeg -f rawvideo
+};
+
+
+// Writes the rendered frames to disk without stalling the render loop. capture() only queues a copy of
+// the target into one of RING_SIZE persistently mapped pixel pack buffers and fences it, poll() passes the
+// copies the GPU has finished to a writer thread, which encodes them straight out of the mapped memory.
+// A buffer is only reused once its frame is written, so if the GPU or the writer fall behind, frames are
+// dropped (and counted) instead of waited for. Every frame of a capture has the size it was started with,
+// which a raw stream can't do without, frames of another size (the window was resized) are dropped too.
+class FrameCapture
+{
+public:
+	static const int RING_SIZE = 4;
+
+	// output is the directory for PNG and EXR, and the file for RAW, it is created if needed. frameSize is
+	// the render size every frame has to have, keep it from changing (e.g. dynamic resolution) while active().
+	// Needs a current GL context, returns false if the output can't be opened.
+	bool start(const std::string& output, CaptureFormat format, glm::ivec2 frameSize);
+	// writes what is still in flight (this waits for the GPU and the writer) and stops the writer thread
+	void stop();
+	bool active() const { return capturing; }
+	glm::ivec2 frameSize() const { return size; }
+
+	// copies the rendered part of target, call after the frame is rendered
+	void capture(const RenderTarget& target);
+	// hands finished copies to the writer, call once per frame
+	void poll();
+
+	// deletes the buffers, stops first if needed
+	void release();
+
+	uint64_t capturedFrames() const { return captured; }
+	uint64_t writtenFrames() const { return written; }
+	uint64_t droppedFrames() const { return dropped; }
+
+private:
+	enum SlotState { FREE, COPYING, WRITING };
+	// what a copy holds, screenTex in one of its formats or the linear color of the accumulation image
+	enum CopyLayout { SCREEN_RGBA8, SCREEN_RGBA16F, SCREEN_R11F_G11F_B10F, LINEAR_RGBA16F };
+
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsizeiptr capacity = 0;
+		const uint8_t* mapped = nullptr;
+		GLsync fence = nullptr;
+		std::atomic<int> state{FREE};
+		CopyLayout layout = SCREEN_RGBA8;
+		int width = 0;
+		int height = 0;
+		uint64_t frame = 0;
+	};
+
+	void writerLoop();
+	void writeFrame(const Slot& slot);
+	void drop(const std::string& reason);
+
+	Slot slots[RING_SIZE];
+	CaptureFormat format = CaptureFormat::PNG;
+	std::string output;
+	glm::ivec2 size = glm::ivec2(0);
+	std::ofstream rawFile;
+	bool capturing = false;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	// slots handed to the writer, oldest first
+	std::deque<int> queue;
+	bool quit = false;
+
+	uint64_t captured = 0;
+	std::atomic<uint64_t> written{0};
+	uint64_t dropped = 0;
+	// the frame number the next copied frame gets in its file name
+	uint64_t nextFrame = 0;
+};
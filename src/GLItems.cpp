@@ -1,31 +1,153 @@
 #include "GLItems.h"
 #include <iostream>
 #include <string.h>
+#include <filesystem>
 #include <fstream>
 
 #include "logger.h"
 
-GLuint loadShader(const char *shaderPath, GLenum shaderType)
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
 {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
 
-    std::ifstream file((shaderPath));
-    std::string shaderSource;
-    std::string line;
 
-    if(file.is_open())
-    {
-        while(std::getline(file, line))
-            shaderSource += line + "\n";
-        file.close();
-    }
-    else
+namespace {
+
+// resolves the #includes of one shader, every file it meets gets the next source string number
+struct IncludeResolver
+{
+	ShaderSource& source;
+	std::string& error;
+	std::unordered_map<std::string, int> fileIndex;
+
+	// the whole file in one read
+	bool readFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if(!file.is_open())
+			return false;
+		contents.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read(&contents[0], contents.size());
+	}
+
+	bool expand(const std::filesystem::path& path, const std::vector<std::string>& defines, const std::string& includedFrom)
+	{
+		std::string canonical = std::filesystem::weakly_canonical(path).string();
+		// every file goes in once, as if they all had include guards
+		if(fileIndex.count(canonical))
+			return true;
+
+		std::string contents;
+		if(!readFile(path.string(), contents))
+		{
+			error = "Failed to open shader file: " + path.string() + includedFrom;
+			return false;
+		}
+
+		int index = (int)source.files.size();
+		fileIndex[canonical] = index;
+		source.files.push_back(canonical);
+		if(index > 0)
+			source.text += "#line 1 " + std::to_string(index) + "\n";
+
+		bool versionSeen = false;
+		int lineNumber = 0;
+		for(size_t lineStart = 0; lineStart < contents.size();)
+		{
+			size_t lineEnd = contents.find('\n', lineStart);
+			if(lineEnd == std::string::npos)
+				lineEnd = contents.size();
+			std::string line = contents.substr(lineStart, lineEnd - lineStart);
+			if(!line.empty() && line.back() == '\r')
+				line.pop_back();
+			lineStart = lineEnd + 1;
+			lineNumber++;
+
+			size_t first = line.find_first_not_of(" \t");
+			if(first != std::string::npos && line.compare(first, 8, "#include") == 0)
+			{
+				size_t open = line.find('"', first + 8);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if(close == std::string::npos)
+				{
+					error = "Malformed #include in " + path.string() + ":" + std::to_string(lineNumber);
+					return false;
+				}
+
+				std::filesystem::path included = path.parent_path() / line.substr(open + 1, close - open - 1);
+				if(!expand(included, {}, " (included from " + path.string() + ":" + std::to_string(lineNumber) + ")"))
+					return false;
+				source.text += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+				continue;
+			}
+
+			source.text += line + "\n";
+
+			// the defines have to come after #version, which has to stay the first statement
+			if(index == 0 && !versionSeen && first != std::string::npos && line.compare(first, 8, "#version") == 0)
+			{
+				versionSeen = true;
+				if(!defines.empty())
+				{
+					for(const std::string& define : defines)
+						source.text += "#define " + define + "\n";
+					source.text += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+				}
+			}
+		}
+		return true;
+	}
+};
+
+}
+
+
+bool tryReadShaderSource(const char *shaderPath, const std::vector<std::string>& defines, ShaderSource& shaderSource, std::string& error)
+{
+	shaderSource = ShaderSource();
+	IncludeResolver resolver = {shaderSource, error};
+	if(!resolver.expand(shaderPath, defines, ""))
+		return false;
+
+	shaderSource.hash = hashBytes(FNV_OFFSET_BASIS, shaderSource.text.data(), shaderSource.text.size());
+	return true;
+}
+
+
+ShaderSource readShaderSource(const char *shaderPath, const std::vector<std::string>& defines)
+{
+    ShaderSource shaderSource;
+    std::string error;
+    if(!tryReadShaderSource(shaderPath, defines, shaderSource, error))
     {
-	logger::Log(logger::LogLevel::FATAL, "Failed to open shader file: " + std::string(shaderPath));
+	logger::Log(logger::LogLevel::FATAL, error);
 	ForceTerminate();
     }
+    return shaderSource;
+}
+
+
+std::string describeSourceFiles(const ShaderSource& shaderSource)
+{
+	std::string description;
+	for(size_t i = 0; i < shaderSource.files.size(); i++)
+		description += "\n  source " + std::to_string(i) + ": " + shaderSource.files[i];
+	return description;
+}
+
 
+GLuint compileShader(const ShaderSource& shaderSource, GLenum shaderType, const std::string& name)
+{
     GLuint shader = glCreateShader(shaderType);
-    const char* source = shaderSource.c_str();
+    const char* source = shaderSource.text.c_str();
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
 
@@ -36,19 +158,28 @@ GLuint loadShader(const char *shaderPath, GLenum shaderType)
     {
         glGetShaderInfoLog(shader, 512, NULL, infoLog);
         // TODO: Only add infoLog if in DEBUG mode
-	logger::Log(logger::LogLevel::FATAL, "Failed to compile shader: " + std::string(infoLog));
+	logger::Log(logger::LogLevel::FATAL, "Failed to compile shader: " + std::string(infoLog) + describeSourceFiles(shaderSource));
         glDeleteShader(shader);
 	ForceTerminate();
         return 0;
     }
-    logger::Log(logger::LogLevel::DEBUG, "Compiled shader: " + std::string(shaderPath));
+    logger::Log(logger::LogLevel::DEBUG, "Compiled shader: " + name);
     return shader;
 }
 
 
-GLuint createShaderProgram(std::vector<GLuint> shaderList)
+GLuint loadShader(const char *shaderPath, GLenum shaderType, const std::vector<std::string>& defines)
+{
+    return compileShader(readShaderSource(shaderPath, defines), shaderType, shaderPath);
+}
+
+
+GLuint createShaderProgram(std::vector<GLuint> shaderList, bool retrievable)
 {
 	    GLuint program = glCreateProgram();
+    // has to be set before linking for glGetProgramBinary to work
+    if(retrievable)
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     for(GLuint shader : shaderList)
 	glAttachShader(program, shader);
     glLinkProgram(program);
@@ -67,6 +198,127 @@ GLuint createShaderProgram(std::vector<GLuint> shaderList)
 }
 
 
+// bools, samplers and images are set through glUniform1i as well
+static bool isSetWithInt(GLenum type)
+{
+	switch(type)
+	{
+	case GL_INT:
+	case GL_BOOL:
+	case GL_SAMPLER_1D:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_IMAGE_2D:
+	case GL_IMAGE_3D:
+		return true;
+	default:
+		return false;
+	}
+}
+
+
+ShaderProgram::ShaderProgram(std::vector<GLuint> shaderList)
+	: program(createShaderProgram(std::move(shaderList)))
+{
+	reflectUniforms();
+}
+
+ShaderProgram ShaderProgram::fromLinked(GLuint linkedProgram)
+{
+	ShaderProgram shaderProgram;
+	shaderProgram.program = linkedProgram;
+	shaderProgram.reflectUniforms();
+	return shaderProgram;
+}
+
+void ShaderProgram::release()
+{
+	if(program)
+		glDeleteProgram(program);
+	program = 0;
+	uniforms.clear();
+}
+
+void ShaderProgram::reflectUniforms()
+{
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+
+	const GLenum properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX};
+	for(GLint i = 0; i < uniformCount; i++)
+	{
+		GLint values[5];
+		glGetProgramResourceiv(program, GL_UNIFORM, i, 5, properties, 5, NULL, values);
+
+		// members of uniform blocks don't have a location, they are set through their buffer
+		if(values[4] != -1)
+			continue;
+
+		std::string name(values[0], '\0');
+		glGetProgramResourceName(program, GL_UNIFORM, i, values[0], NULL, &name[0]);
+		name.resize(values[0] - 1);
+		// arrays are reported as "name[0]"
+		if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			name.resize(name.size() - 3);
+
+		uniforms[name] = Uniform{values[2], (GLenum)values[1], values[3]};
+	}
+
+	logger::Log(logger::LogLevel::DEBUG, "Program " + std::to_string(program) + " has " + std::to_string(uniforms.size()) + " active uniforms");
+}
+
+GLint ShaderProgram::location(const std::string& name) const
+{
+	auto it = uniforms.find(name);
+	return it == uniforms.end() ? -1 : it->second.location;
+}
+
+const ShaderProgram::Uniform* ShaderProgram::find(const std::string& name, GLenum type) const
+{
+	auto it = uniforms.find(name);
+	if(it == uniforms.end())
+		return nullptr;
+	if(it->second.type != type && !(type == GL_INT && isSetWithInt(it->second.type)))
+	{
+		logger::Log(logger::LogLevel::ERROR, "Uniform " + name + " set with the wrong type");
+		return nullptr;
+	}
+	return &it->second;
+}
+
+void ShaderProgram::set(const std::string& name, int value) const
+{
+	if(const Uniform* uniform = find(name, GL_INT))
+		glProgramUniform1i(program, uniform->location, value);
+}
+
+void ShaderProgram::set(const std::string& name, unsigned int value) const
+{
+	if(const Uniform* uniform = find(name, GL_UNSIGNED_INT))
+		glProgramUniform1ui(program, uniform->location, value);
+}
+
+void ShaderProgram::set(const std::string& name, float value) const
+{
+	if(const Uniform* uniform = find(name, GL_FLOAT))
+		glProgramUniform1f(program, uniform->location, value);
+}
+
+void ShaderProgram::set(const std::string& name, const glm::vec2& value) const
+{
+	if(const Uniform* uniform = find(name, GL_FLOAT_VEC2))
+		glProgramUniform2f(program, uniform->location, value.x, value.y);
+}
+
+void ShaderProgram::set(const std::string& name, const glm::vec3& value) const
+{
+	if(const Uniform* uniform = find(name, GL_FLOAT_VEC3))
+		glProgramUniform3f(program, uniform->location, value.x, value.y, value.z);
+}
+
+
 
 
 
@@ -1,12 +1,91 @@
+#pragma once
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
+// the windowed context is created with this version, the shaders are #version 450, nothing in them needs 4.6
+const unsigned short OPENGL_MAJOR_VERSION = 4;
+const unsigned short OPENGL_MINOR_VERSION = 6;
+// headless contexts fall back to this, llvmpipe only has 4.5
+const unsigned short OPENGL_HEADLESS_MINOR_VERSION = 5;
+
+
+// A shader file with every #include "file" in it resolved, relative to the file the #include is in.
+// Each file is read in one go and included at most once, as if they all had include guards.
+// #line directives keep the line numbers of compile errors right, source string N is files[N].
+struct ShaderSource
+{
+	std::string text;
+	// canonical paths, files[0] is the shader itself
+	std::vector<std::string> files;
+	// of text, the program cache is keyed on it
+	uint64_t hash = 0;
+};
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+// FNV-1a, start with FNV_OFFSET_BASIS
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
+
 // loads a shader from a file, than returns it.
-GLuint loadShader(const char* shaderPath, GLenum shaderType);
+// Every entry of defines (e.g. "LOCAL_SIZE_X 16") is added as a #define right after the #version line.
+GLuint loadShader(const char* shaderPath, GLenum shaderType, const std::vector<std::string>& defines = {});
+
+// the two halves of loadShader(), for callers that need the source before compiling it
+ShaderSource readShaderSource(const char* shaderPath, const std::vector<std::string>& defines = {});
+// returns false instead of terminating when a file can't be read, error says which
+bool tryReadShaderSource(const char* shaderPath, const std::vector<std::string>& defines, ShaderSource& shaderSource, std::string& error);
+GLuint compileShader(const ShaderSource& shaderSource, GLenum shaderType, const std::string& name);
+// which file each source string number of an info log is, one per line
+std::string describeSourceFiles(const ShaderSource& shaderSource);
+
+// retrievable programs can be read back with glGetProgramBinary
+GLuint createShaderProgram(std::vector<GLuint> shaderList, bool retrievable = false);
+
+
+// A linked program together with every active uniform it has. The uniforms are reflected once
+// right after linking, so the setters never have to ask the driver for a location by name.
+class ShaderProgram
+{
+public:
+	struct Uniform
+	{
+		GLint  location;
+		GLenum type;
+		GLint  arraySize;
+	};
+
+	ShaderProgram() = default;
+	// links the shaders with createShaderProgram()
+	explicit ShaderProgram(std::vector<GLuint> shaderList);
+	// takes ownership of an already linked program, e.g. one loaded with glProgramBinary
+	static ShaderProgram fromLinked(GLuint linkedProgram);
+
+	GLuint id() const { return program; }
+	void use() const { glUseProgram(program); }
+	void release();
+
+	// -1 if the program has no active uniform of that name
+	GLint location(const std::string& name) const;
+
+	// glProgramUniform*, so the program doesn't have to be bound
+	void set(const std::string& name, int value) const;
+	void set(const std::string& name, unsigned int value) const;
+	void set(const std::string& name, float value) const;
+	void set(const std::string& name, const glm::vec2& value) const;
+	void set(const std::string& name, const glm::vec3& value) const;
+
+private:
+	void reflectUniforms();
+	const Uniform* find(const std::string& name, GLenum type) const;
 
-GLuint createShaderProgram(std::vector<GLuint> shaderList);
+	GLuint program = 0;
+	std::unordered_map<std::string, Uniform> uniforms;
+};
 
 
 void DeleteGLItem(GLuint item);
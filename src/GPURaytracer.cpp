@@ -0,0 +1,254 @@
+#include "GPURaytracer.h"
+#include <string>
+
+#include "ShaderReloader.h"
+#include "logger.h"
+
+
+// mirrors the RenderParams uniform block in ComputeShader.comp (std140)
+struct RenderParams
+{
+	glm::vec3  lookFrom;
+	float      time;
+	glm::vec3  lookAt;
+	GLuint     frameIndex;
+	GLint      maxDepth;
+	GLint      numSamples;
+	glm::ivec2 renderSize;
+};
+static_assert(sizeof(RenderParams) == 48, "RenderParams has to match the std140 layout in the shader");
+
+
+const char* const GPURaytracer::KERNEL_PATH = "../src/shaders/ComputeShader.comp";
+
+std::vector<std::string> GPURaytracer::kernelDefines(glm::ivec2 localSize, ScreenFormat format, const KernelVariant* variant)
+{
+	std::vector<std::string> defines = {
+		"LOCAL_SIZE_X " + std::to_string(localSize.x),
+		"LOCAL_SIZE_Y " + std::to_string(localSize.y),
+		std::string("SCREEN_FORMAT ") + glslFormat(format)
+	};
+	if(variant)
+	{
+		defines.push_back("SPECIALIZED_MAX_DEPTH " + std::to_string(variant->maxDepth));
+		defines.push_back("SPECIALIZED_NUM_SAMPLES " + std::to_string(variant->numSamples));
+		defines.push_back("MATERIAL_MASK " + std::to_string(variant->materialMask));
+	}
+	return defines;
+}
+
+static ShaderProgram createComputeProgram(ProgramCache& programCache, glm::ivec2 localSize, ScreenFormat format, const KernelVariant* variant = nullptr)
+{
+	const char* path = GPURaytracer::KERNEL_PATH;
+	std::vector<std::string> defines = GPURaytracer::kernelDefines(localSize, format, variant);
+	ShaderProgram program = programCache.load({{GL_COMPUTE_SHADER, path, readShaderSource(path, defines)}});
+
+	logger::Log(logger::LogLevel::DEBUG, "Compute shader has " + std::to_string(localSize.x) + "x" + std::to_string(localSize.y) + " work groups");
+	return program;
+}
+
+// enough work groups to cover every pixel, the shader skips the invocations that fall outside
+static glm::ivec2 workGroupCount(glm::ivec2 imageSize, glm::ivec2 localSize)
+{
+	return (imageSize + localSize - glm::ivec2(1)) / localSize;
+}
+
+
+GPURaytracer::GPURaytracer(ProgramCache& programCache, glm::ivec2 localSize)
+	: programCache(&programCache), program(createComputeProgram(programCache, localSize, ScreenFormat::RGBA8)), wavefront(programCache), refitPass(programCache), currentLocalSize(localSize), programLocalSize(localSize)
+{
+	// per frame parameters of the compute shader, one small upload per frame instead of a call per uniform
+	glCreateBuffers(1, &renderParamsBuffer);
+	glNamedBufferStorage(renderParamsBuffer, sizeof(RenderParams), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+void GPURaytracer::release()
+{
+	releaseVariants();
+	program.release();
+	if(reloader && kernelReloadId >= 0)
+		reloader->unwatch(kernelReloadId);
+	kernelReloadId = -1;
+	wavefront.release();
+	refitPass.release();
+	rayCounter.release();
+	if(renderParamsBuffer)
+		glDeleteBuffers(1, &renderParamsBuffer);
+	renderParamsBuffer = 0;
+}
+
+void GPURaytracer::setLocalSize(glm::ivec2 localSize)
+{
+	currentLocalSize = localSize;
+	rebuildKernel();
+}
+
+void GPURaytracer::setScreenFormat(ScreenFormat format)
+{
+	if(format == currentFormat)
+		return;
+	currentFormat = format;
+	wavefront.setScreenFormat(format);
+	rebuildKernel();
+}
+
+void GPURaytracer::setShaderReloader(ShaderReloader* shaderReloader)
+{
+	reloader = shaderReloader;
+	kernelReloadId = reloader->watch({{{GL_COMPUTE_SHADER, KERNEL_PATH}}, kernelDefines(programLocalSize, programFormat)});
+	wavefront.setShaderReloader(shaderReloader);
+}
+
+bool GPURaytracer::collectReloads()
+{
+	wavefront.collectReloads();
+	ShaderProgram reloaded;
+	if(!reloader || !reloader->takeReloaded(kernelReloadId, reloaded))
+		return false;
+
+	// the reloader only hands out builds with the latest defines
+	bool edited = programLocalSize == currentLocalSize && programFormat == currentFormat;
+	swapKernel(reloaded);
+	return edited;
+}
+
+// builds the generic kernel for currentLocalSize and currentFormat, program keeps running until it is swapped
+void GPURaytracer::rebuildKernel()
+{
+	if(reloader)
+	{
+		// going back to what program already is only has to throw away the build in flight
+		reloader->setDefines(kernelReloadId, kernelDefines(currentLocalSize, currentFormat));
+		if(currentLocalSize != programLocalSize || currentFormat != programFormat)
+			reloader->requestBuild(kernelReloadId);
+		return;
+	}
+	swapKernel(createComputeProgram(*programCache, currentLocalSize, currentFormat));
+}
+
+void GPURaytracer::swapKernel(ShaderProgram built)
+{
+	program.release();
+	program = built;
+	if(programLocalSize != currentLocalSize || programFormat != currentFormat)
+	{
+		// every variant has the old shape and format compiled in
+		releaseVariants();
+		programLocalSize = currentLocalSize;
+		programFormat = currentFormat;
+	}
+}
+
+void GPURaytracer::render(Scene& scene, const RenderSettings& settings, RenderTarget& target)
+{
+	// only touches the buffer contents, the program never has to be relinked for a new scene
+	scene.upload(&refitPass);
+	scene.bind();
+	// the image format in the kernel has to match the screen's, so the screen only follows a new
+	// format once the kernel built for it runs
+	target.setScreenFormat(currentPipeline == GPUPipeline::WAVEFRONT ? wavefront.screenFormat() : programFormat);
+	target.bindImages();
+
+	glm::ivec2 renderSize = target.renderSize();
+
+	RenderParams params = {};
+	params.lookFrom = settings.lookFrom;
+	// time elapsed since the beginning of the program
+	params.time = (float)glfwGetTime();
+	params.lookAt = settings.lookAt;
+	params.frameIndex = settings.frameIndex;
+	params.maxDepth = settings.maxDepth;
+	params.numSamples = settings.numSamples;
+	params.renderSize = renderSize;
+	glNamedBufferSubData(renderParamsBuffer, 0, sizeof(params), &params);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, renderParamsBuffer);
+
+	rayCounter.beginFrame();
+	if(currentPipeline == GPUPipeline::WAVEFRONT)
+	{
+		collectVariants();
+		lastUsedVariant = false;
+		wavefront.render(settings, renderSize, scene.materialMask());
+	}
+	else
+	{
+		selectKernel(scene, settings).use();
+		glm::ivec2 groups = workGroupCount(renderSize, programLocalSize);
+		glDispatchCompute(groups.x, groups.y, 1);
+	}
+	rayCounter.endFrame();
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+const ShaderProgram& GPURaytracer::selectKernel(const Scene& scene, const RenderSettings& settings)
+{
+	collectVariants();
+	lastUsedVariant = false;
+	if(!specialize)
+		return program;
+
+	KernelVariant wanted = {settings.maxDepth, settings.numSamples, scene.materialMask()};
+	auto it = variants.find(wanted);
+	if(it == variants.end())
+	{
+		if(!(wanted == settlingVariant))
+		{
+			settlingVariant = wanted;
+			settledFrames = 0;
+		}
+		// building in the background costs nothing to wait for, building right away stalls
+		// the frame, so only the latter is worth doing as soon as the settings are known
+		if(reloader && ++settledFrames < VARIANT_SETTLE_FRAMES)
+			return program;
+
+		logger::Log(logger::LogLevel::DEBUG, "Building kernel variant for depth " + std::to_string(wanted.maxDepth) + ", " + std::to_string(wanted.numSamples) + " samples, material mask " + std::to_string(wanted.materialMask));
+		Variant variant;
+		if(reloader)
+		{
+			variant.reloadId = reloader->watch({{{GL_COMPUTE_SHADER, KERNEL_PATH}}, kernelDefines(programLocalSize, programFormat, &wanted)});
+			reloader->requestBuild(variant.reloadId);
+		}
+		else
+		{
+			variant.program = createComputeProgram(*programCache, programLocalSize, programFormat, &wanted);
+			variant.ready = true;
+		}
+		it = variants.emplace(wanted, variant).first;
+	}
+
+	lastUsedVariant = it->second.ready;
+	return it->second.ready ? it->second.program : program;
+}
+
+// picks up variants that finished building, and rebuilds after the kernel was edited
+void GPURaytracer::collectVariants()
+{
+	if(!reloader)
+		return;
+
+	for(auto& entry : variants)
+	{
+		Variant& variant = entry.second;
+		ShaderProgram built;
+		if(variant.reloadId >= 0 && reloader->takeReloaded(variant.reloadId, built))
+		{
+			if(variant.ready)
+				variant.program.release();
+			variant.program = built;
+			variant.ready = true;
+		}
+	}
+}
+
+void GPURaytracer::releaseVariants()
+{
+	for(auto& entry : variants)
+	{
+		if(entry.second.ready)
+			entry.second.program.release();
+		if(entry.second.reloadId >= 0 && reloader)
+			reloader->unwatch(entry.second.reloadId);
+	}
+	variants.clear();
+	settledFrames = 0;
+}
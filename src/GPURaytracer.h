@@ -0,0 +1,129 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "BVHRefitPass.h"
+#include "GLItems.h"
+#include "ProgramCache.h"
+#include "RayCounter.h"
+#include "RenderSettings.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "WavefrontPipeline.h"
+
+class ShaderReloader;
+
+
+// the work group shape the kernel starts with, can be set at configure time
+// (RAYTRACER_LOCAL_SIZE_X/Y in CMakeLists.txt) and changed at run time
+#ifndef DEFAULT_LOCAL_SIZE_X
+#define DEFAULT_LOCAL_SIZE_X 8
+#endif
+#ifndef DEFAULT_LOCAL_SIZE_Y
+#define DEFAULT_LOCAL_SIZE_Y 4
+#endif
+
+
+// what a specialized kernel is built for, see the SPECIALIZED_* defines in ComputeShader.comp
+struct KernelVariant
+{
+	int maxDepth;
+	int numSamples;
+	unsigned int materialMask;
+
+	bool operator<(const KernelVariant& other) const
+	{
+		return std::tie(maxDepth, numSamples, materialMask) < std::tie(other.maxDepth, other.numSamples, other.materialMask);
+	}
+	bool operator==(const KernelVariant& other) const
+	{
+		return maxDepth == other.maxDepth && numSamples == other.numSamples && materialMask == other.materialMask;
+	}
+};
+
+
+// Runs ComputeShader.comp, or the wavefront stages. Needs a current GL context for its whole lifetime.
+// Besides the generic kernel, which takes the depth and sample count from RenderParams, a variant
+// is built for every combination of depth, sample count and scene materials that gets rendered.
+class GPURaytracer
+{
+public:
+	// builds the kernel with work groups of localSize.x by localSize.y invocations,
+	// programCache has to outlive the raytracer
+	GPURaytracer(ProgramCache& programCache, glm::ivec2 localSize);
+	void release();
+
+	// Rebuilds the kernels for another work group shape or screen format. With a reloader the build
+	// happens in the background and the old kernel keeps running until the new one has linked (a kernel
+	// that fails to build is only logged), render() switches the target to the format of the kernel it runs.
+	void setLocalSize(glm::ivec2 localSize);
+	glm::ivec2 localSize() const { return currentLocalSize; }
+	void setScreenFormat(ScreenFormat format);
+	ScreenFormat screenFormat() const { return currentFormat; }
+
+	// Kernels are built in the background on reloader if there is one (the generic kernel runs until
+	// variants are ready), and right away otherwise. The reloader has to outlive the raytracer.
+	void setShaderReloader(ShaderReloader* shaderReloader);
+	// swaps in the kernels the reloader has finished, once a frame before render(),
+	// true if the generic kernel was rebuilt because its files changed
+	bool collectReloads();
+	void setSpecialization(bool enabled) { specialize = enabled; }
+	bool specialization() const { return specialize; }
+	// whether the last frame was rendered by a variant
+	bool usedVariant() const { return lastUsedVariant; }
+	size_t variantCount() const { return variants.size(); }
+
+	void setPipeline(GPUPipeline newPipeline) { currentPipeline = newPipeline; }
+	GPUPipeline pipeline() const { return currentPipeline; }
+	// rays traced by a recent frame, counted on the GPU and read back a few frames late
+	uint32_t raysPerFrame() { rayCounter.collect(); return rayCounter.lastCount(); }
+
+	// uploads any scene changes and traces target.renderSize() with the current pipeline
+	void render(Scene& scene, const RenderSettings& settings, RenderTarget& target);
+
+	// what the kernel is built from, for anything that builds it outside of this class
+	static const char* const KERNEL_PATH;
+	static std::vector<std::string> kernelDefines(glm::ivec2 localSize, ScreenFormat format, const KernelVariant* variant = nullptr);
+
+	// dragging a slider would build a variant per value otherwise
+	static const int VARIANT_SETTLE_FRAMES = 30;
+
+private:
+	struct Variant
+	{
+		ShaderProgram program;
+		bool ready = false;
+		// -1 for variants built right away
+		int reloadId = -1;
+	};
+
+	void rebuildKernel();
+	void swapKernel(ShaderProgram built);
+	const ShaderProgram& selectKernel(const Scene& scene, const RenderSettings& settings);
+	void collectVariants();
+	void releaseVariants();
+
+	ProgramCache* programCache;
+	ShaderReloader* reloader = nullptr;
+	ShaderProgram program;
+	int kernelReloadId = -1;
+	std::map<KernelVariant, Variant> variants;
+	bool specialize = true;
+	bool lastUsedVariant = false;
+	KernelVariant settlingVariant = {};
+	int settledFrames = 0;
+	GPUPipeline currentPipeline = GPUPipeline::MEGAKERNEL;
+	WavefrontPipeline wavefront;
+	BVHRefitPass refitPass;
+	RayCounter rayCounter;
+	GLuint renderParamsBuffer = 0;
+	// what was asked for, and what program and the variants are built for
+	glm::ivec2 currentLocalSize;
+	ScreenFormat currentFormat = ScreenFormat::RGBA8;
+	glm::ivec2 programLocalSize;
+	ScreenFormat programFormat = ScreenFormat::RGBA8;
+};
@@ -0,0 +1,341 @@
+#include "ImageWriter.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "logger.h"
+
+
+static uint8_t toByte(float value)
+{
+	return (uint8_t)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// 8 bit RGB rows, top row first
+static std::vector<uint8_t> toRGB8(int width, int height, const std::vector<float>& pixels)
+{
+	std::vector<uint8_t> rgb((size_t)width * height * 3);
+	for(int y = 0; y < height; y++)
+	{
+		const float* src = &pixels[(size_t)(height - 1 - y) * width * 4];
+		uint8_t* dst = &rgb[(size_t)y * width * 3];
+		for(int x = 0; x < width; x++)
+		{
+			dst[x * 3 + 0] = toByte(src[x * 4 + 0]);
+			dst[x * 3 + 1] = toByte(src[x * 4 + 1]);
+			dst[x * 3 + 2] = toByte(src[x * 4 + 2]);
+		}
+	}
+	return rgb;
+}
+
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if(!tableReady)
+	{
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for(int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = ~crc;
+	for(size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	putBigEndian(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+	file.write((const char*)chunk.data(), chunk.size());
+}
+
+// PNG with the image data in uncompressed deflate blocks, which keeps this free of a zlib dependency
+static bool writePNG(std::ofstream& file, int width, int height, const std::vector<uint8_t>& rgb)
+{
+	const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	file.write((const char*)signature, sizeof(signature));
+
+	std::vector<uint8_t> header;
+	putBigEndian(header, (uint32_t)width);
+	putBigEndian(header, (uint32_t)height);
+	header.push_back(8);	// bit depth
+	header.push_back(2);	// truecolor
+	header.push_back(0);	// deflate
+	header.push_back(0);	// adaptive filtering
+	header.push_back(0);	// no interlacing
+	writeChunk(file, "IHDR", header);
+
+	// every row starts with its filter type, 0 is none
+	std::vector<uint8_t> raw;
+	raw.reserve((size_t)height * (width * 3 + 1));
+	for(int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgb.begin() + (size_t)y * width * 3, rgb.begin() + (size_t)(y + 1) * width * 3);
+	}
+
+	std::vector<uint8_t> zlib = {0x78, 0x01};
+	const size_t MAX_BLOCK = 65535;
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = std::min(MAX_BLOCK, raw.size() - offset);
+		bool last = offset + blockSize == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back((uint8_t)blockSize);
+		zlib.push_back((uint8_t)(blockSize >> 8));
+		zlib.push_back((uint8_t)~blockSize);
+		zlib.push_back((uint8_t)(~blockSize >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	} while(offset < raw.size());
+
+	uint32_t a = 1, b = 0;
+	for(uint8_t byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	putBigEndian(zlib, (b << 16) | a);
+
+	writeChunk(file, "IDAT", zlib);
+	writeChunk(file, "IEND", {});
+	return true;
+}
+
+// IEEE half from float, rounded to nearest, overflow becomes infinity
+static uint16_t toHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if(((bits >> 23) & 0xFF) == 0xFF)
+		return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+	if(exponent >= 31)
+		return sign | 0x7C00;
+	if(exponent <= 0)
+	{
+		// denormal or zero
+		if(exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		if((mantissa >> (shift - 1)) & 1)
+			half++;
+		return sign | (uint16_t)half;
+	}
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if(mantissa & 0x1000)
+		half++;
+	return sign | (uint16_t)half;
+}
+
+static void putLittleEndian(std::vector<uint8_t>& out, uint32_t value, int bytes = 4)
+{
+	for(int i = 0; i < bytes; i++)
+		out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void putAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+{
+	out.insert(out.end(), name, name + std::strlen(name) + 1);
+	out.insert(out.end(), type, type + std::strlen(type) + 1);
+	putLittleEndian(out, (uint32_t)value.size());
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+// Single part scanline OpenEXR, uncompressed, with half float RGBA channels, top row first
+static bool writeEXR(std::ofstream& file, int width, int height, const std::vector<float>& pixels)
+{
+	std::vector<uint8_t> header = {0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0};
+
+	// channels are stored in alphabetical order
+	const char* channelNames[] = {"A", "B", "G", "R"};
+	const int channelOffsets[] = {3, 2, 1, 0};
+	std::vector<uint8_t> channels;
+	for(const char* name : channelNames)
+	{
+		channels.push_back((uint8_t)name[0]);
+		channels.push_back(0);
+		putLittleEndian(channels, 1);	// HALF
+		putLittleEndian(channels, 0);	// pLinear and reserved
+		putLittleEndian(channels, 1);	// x sampling
+		putLittleEndian(channels, 1);	// y sampling
+	}
+	channels.push_back(0);
+	putAttribute(header, "channels", "chlist", channels);
+	putAttribute(header, "compression", "compression", {0});
+
+	std::vector<uint8_t> window;
+	putLittleEndian(window, 0);
+	putLittleEndian(window, 0);
+	putLittleEndian(window, (uint32_t)(width - 1));
+	putLittleEndian(window, (uint32_t)(height - 1));
+	putAttribute(header, "dataWindow", "box2i", window);
+	putAttribute(header, "displayWindow", "box2i", window);
+	putAttribute(header, "lineOrder", "lineOrder", {0});
+
+	std::vector<uint8_t> one, center;
+	float oneValue = 1.0f;
+	uint32_t oneBits;
+	std::memcpy(&oneBits, &oneValue, sizeof(oneBits));
+	putLittleEndian(one, oneBits);
+	putLittleEndian(center, 0);
+	putLittleEndian(center, 0);
+	putAttribute(header, "pixelAspectRatio", "float", one);
+	putAttribute(header, "screenWindowCenter", "v2f", center);
+	putAttribute(header, "screenWindowWidth", "float", one);
+	header.push_back(0);
+
+	// every scanline is a block of its own: y, size, then each channel of the whole line
+	uint32_t lineSize = (uint32_t)width * 4 * sizeof(uint16_t);
+	uint64_t blockOffset = header.size() + (uint64_t)height * sizeof(uint64_t);
+	for(int y = 0; y < height; y++)
+	{
+		uint64_t offset = blockOffset + (uint64_t)y * (8 + lineSize);
+		putLittleEndian(header, (uint32_t)offset);
+		putLittleEndian(header, (uint32_t)(offset >> 32));
+	}
+	file.write((const char*)header.data(), header.size());
+
+	std::vector<uint8_t> line;
+	for(int y = 0; y < height; y++)
+	{
+		line.clear();
+		putLittleEndian(line, (uint32_t)y);
+		putLittleEndian(line, lineSize);
+		const float* src = &pixels[(size_t)(height - 1 - y) * width * 4];
+		for(int channel : channelOffsets)
+		for(int x = 0; x < width; x++)
+		{
+			float value = src[x * 4 + channel];
+			// undo the sqrt the kernel applies for display, alpha stays as it is
+			if(channel < 3)
+				value *= value;
+			putLittleEndian(line, toHalf(value), 2);
+		}
+		file.write((const char*)line.data(), line.size());
+	}
+	return true;
+}
+
+static bool writePPM(std::ofstream& file, int width, int height, const std::vector<uint8_t>& rgb)
+{
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write((const char*)rgb.data(), rgb.size());
+	return true;
+}
+
+
+static std::string extensionOf(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if(dot == std::string::npos)
+		return "";
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension;
+}
+
+// opens path for one of the given extensions, logs and returns false otherwise
+static bool openImage(const std::string& path, const std::vector<std::string>& extensions, std::string& extension, std::ofstream& file)
+{
+	extension = extensionOf(path);
+	if(std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+	{
+		std::string supported;
+		for(const std::string& name : extensions)
+			supported += (supported.empty() ? "." : ", .") + name;
+		logger::Log(logger::LogLevel::ERROR, "Unsupported image format: " + path + " (use " + supported + ")");
+		return false;
+	}
+
+	file.open(path, std::ios::binary);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open image file: " + path);
+		return false;
+	}
+	return true;
+}
+
+static bool finishImage(const std::string& path, int width, int height, bool written, const std::ofstream& file, bool logWritten)
+{
+	if(!written || !file.good())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to write image file: " + path);
+		return false;
+	}
+
+	if(logWritten)
+		logger::Log(logger::LogLevel::INFO, "Wrote " + std::to_string(width) + "x" + std::to_string(height) + " image to " + path);
+	return true;
+}
+
+bool writeImage(const std::string& path, int width, int height, const std::vector<float>& pixels, bool logWritten)
+{
+	std::string extension;
+	std::ofstream file;
+	if(!openImage(path, {"png", "ppm", "exr"}, extension, file))
+		return false;
+
+	bool written;
+	if(extension == "exr")
+		written = writeEXR(file, width, height, pixels);
+	else
+	{
+		std::vector<uint8_t> rgb = toRGB8(width, height, pixels);
+		written = extension == "png" ? writePNG(file, width, height, rgb) : writePPM(file, width, height, rgb);
+	}
+	return finishImage(path, width, height, written, file, logWritten);
+}
+
+bool writeImage(const std::string& path, int width, int height, const std::vector<uint8_t>& pixels, bool logWritten)
+{
+	std::string extension;
+	std::ofstream file;
+	if(!openImage(path, {"png", "ppm"}, extension, file))
+		return false;
+
+	std::vector<uint8_t> rgb((size_t)width * height * 3);
+	for(int y = 0; y < height; y++)
+	{
+		const uint8_t* src = &pixels[(size_t)(height - 1 - y) * width * 4];
+		uint8_t* dst = &rgb[(size_t)y * width * 3];
+		for(int x = 0; x < width; x++)
+		{
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+	bool written = extension == "png" ? writePNG(file, width, height, rgb) : writePPM(file, width, height, rgb);
+	return finishImage(path, width, height, written, file, logWritten);
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Writes RGBA32F pixels (first row is the bottom one, like screenTex) to disk. The format is
+// picked from the extension: .png or .ppm, both 8 bits per channel with values clamped to [0, 1],
+// or .exr with 16 bit floats. pixels hold the square root of the linear color (like screenTex),
+// EXR files get the linear color back.
+// Returns false and logs an error if the file can't be written, logs the written file if logWritten is set.
+bool writeImage(const std::string& path, int width, int height, const std::vector<float>& pixels, bool logWritten = true);
+// the same for RGBA8 pixels, as read back from screenTex with GL_UNSIGNED_BYTE, only .png and .ppm
+bool writeImage(const std::string& path, int width, int height, const std::vector<uint8_t>& pixels, bool logWritten = true);
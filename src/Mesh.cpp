@@ -0,0 +1,29 @@
+#include "Mesh.h"
+
+
+void Mesh::build()
+{
+	size_t count = triangleCount();
+	std::vector<AABB> bounds(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		bounds[i].grow(vertices[indices[i * 3 + 0]].position);
+		bounds[i].grow(vertices[indices[i * 3 + 1]].position);
+		bounds[i].grow(vertices[indices[i * 3 + 2]].position);
+	}
+
+	BVH bvh;
+	bvh.build(bounds);
+
+	// triangle i of the sorted mesh is triangle primIndices[i] of the original one
+	std::vector<uint32_t> sorted(indices.size());
+	for(size_t i = 0; i < count; i++)
+	{
+		const uint32_t* triangle = &indices[bvh.primIndices[i] * 3];
+		sorted[i * 3 + 0] = triangle[0];
+		sorted[i * 3 + 1] = triangle[1];
+		sorted[i * 3 + 2] = triangle[2];
+	}
+	indices = std::move(sorted);
+	nodes = std::move(bvh.nodes);
+}
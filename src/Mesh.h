@@ -0,0 +1,64 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Sphere.h"
+
+
+// One vertex of a mesh, laid out like MeshVertex in shaders/include/mesh.glsl (std430). The normal
+// is zero if the file had none, the shaders and the CPU backend use the triangle's own normal then.
+struct MeshVertex
+{
+	glm::vec3 position;
+	float     u;
+	glm::vec3 normal;
+	float     v;
+};
+static_assert(sizeof(MeshVertex) == 32, "MeshVertex has to match the std430 layout in the shader");
+
+// Mirrors InstanceInfo in shaders/include/mesh.glsl. The inverse of the instance's transform as the
+// rows of a 3x4 matrix, which take rays into the space of the mesh, where the arrays of its mesh start
+// in the shared mesh buffers, and its index into the material table.
+struct InstanceInfo
+{
+	glm::vec4 worldToObject[3];
+	uint32_t  nodeOffset;
+	uint32_t  triangleOffset;
+	uint32_t  vertexOffset;
+	uint32_t  materialIndex;
+};
+static_assert(sizeof(InstanceInfo) == 64, "InstanceInfo has to match the std430 layout in the shader");
+
+
+// A triangle mesh with its own BVH (the bottom level of the scene's two level hierarchy). It is put
+// into the scene by instances, which give it a place and a material. After build() the triangles are
+// sorted into the order of the BVH leaves, so a leaf references a range of triangles directly.
+struct Mesh
+{
+	// call after filling vertices and indices, builds the BVH and sorts the triangles
+	void build();
+
+	size_t triangleCount() const { return indices.size() / 3; }
+
+	// the OBJ file it was loaded from (see loadObj())
+	std::string path;
+
+	std::vector<MeshVertex> vertices;
+	// three per triangle, into vertices
+	std::vector<uint32_t> indices;
+	// leaves reference triangles, child and triangle indices start at 0 for every mesh
+	std::vector<BVHNode> nodes;
+};
+
+// One placement of a mesh, any number of them can share a mesh, which is stored and has its BVH built once.
+struct MeshInstance
+{
+	// index into Scene::meshes
+	uint32_t  mesh;
+	// object to world, affine
+	glm::mat4 transform;
+	Material  material;
+};
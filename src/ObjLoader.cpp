@@ -0,0 +1,405 @@
+#include "ObjLoader.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "ThreadPool.h"
+#include "logger.h"
+
+
+namespace {
+
+// read from the file at a time, and roughly what one thread parses in one go
+const size_t BLOCK_SIZE = 32 << 20;
+const size_t CHUNK_SIZE = 1 << 20;
+
+const uint32_t NO_INDEX = ~0u;
+
+// one corner of a triangle, 0 based indices into the positions, texture coordinates and normals of the file
+struct Corner
+{
+	uint32_t position;
+	uint32_t texcoord;
+	uint32_t normal;
+
+	bool operator==(const Corner& other) const
+	{
+		return position == other.position && texcoord == other.texcoord && normal == other.normal;
+	}
+};
+
+struct CornerHash
+{
+	size_t operator()(const Corner& corner) const
+	{
+		uint64_t hash = corner.position * 0x9E3779B97F4A7C15ull ^ corner.texcoord * 0xC2B2AE3D27D4EB4Full ^ corner.normal * 0x165667B19E3779F9ull;
+		return (size_t)(hash ^ (hash >> 32));
+	}
+};
+
+// what the file has been read into so far
+struct ObjData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texcoords;
+	std::vector<glm::vec3> normals;
+	// three per triangle
+	std::vector<Corner> corners;
+};
+
+// a piece of a block that ends at a line end, parsed by one thread
+struct Chunk
+{
+	const char* begin;
+	const char* end;
+
+	// the v, vt and vn lines, counted before parsing so every chunk knows where its elements go
+	size_t positionCount = 0;
+	size_t texcoordCount = 0;
+	size_t normalCount = 0;
+	size_t positionBase = 0;
+	size_t texcoordBase = 0;
+	size_t normalBase = 0;
+
+	std::vector<Corner> corners;
+	// the first line that couldn't be read
+	std::string error;
+};
+
+enum LineType
+{
+	OTHER,
+	POSITION,
+	TEXCOORD,
+	NORMAL,
+	FACE
+};
+
+
+bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* skipSpaces(const char* p, const char* end)
+{
+	while(p < end && isSpace(*p))
+		p++;
+	return p;
+}
+
+// reads the keyword at the start of a line, p is left after it
+LineType lineType(const char*& p, const char* end)
+{
+	p = skipSpaces(p, end);
+	const char* keyword = p;
+	while(p < end && !isSpace(*p))
+		p++;
+
+	size_t length = p - keyword;
+	if(length == 1 && keyword[0] == 'v')
+		return POSITION;
+	if(length == 1 && keyword[0] == 'f')
+		return FACE;
+	if(length == 2 && keyword[0] == 'v' && keyword[1] == 't')
+		return TEXCOORD;
+	if(length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+		return NORMAL;
+	return OTHER;
+}
+
+bool readFloat(const char*& p, const char* end, float& value)
+{
+	p = skipSpaces(p, end);
+	if(p < end && *p == '+')
+		p++;
+	std::from_chars_result result = std::from_chars(p, end, value);
+	if(result.ec != std::errc())
+		return false;
+	p = result.ptr;
+	return true;
+}
+
+// 1 based as in the file, negative ones count back from the last element defined so far (count)
+bool readIndex(const char*& p, const char* end, size_t count, uint32_t& index)
+{
+	long long value;
+	std::from_chars_result result = std::from_chars(p, end, value);
+	if(result.ec != std::errc() || value == 0)
+		return false;
+	p = result.ptr;
+
+	long long resolved = value > 0 ? value - 1 : (long long)count + value;
+	// too large ones are caught once the whole file is read, it may define them further down
+	if(resolved < 0 || resolved >= NO_INDEX)
+		return false;
+	index = (uint32_t)resolved;
+	return true;
+}
+
+// corners are v, v/vt, v//vn or v/vt/vn, polygons become a fan of triangles around the first corner
+bool readFace(const char* p, const char* end, Chunk& chunk, size_t positions, size_t texcoords, size_t normals)
+{
+	Corner first = {}, previous = {};
+	int count = 0;
+	while(true)
+	{
+		p = skipSpaces(p, end);
+		if(p == end)
+			break;
+
+		Corner corner = {NO_INDEX, NO_INDEX, NO_INDEX};
+		if(!readIndex(p, end, positions, corner.position))
+			return false;
+		if(p < end && *p == '/')
+		{
+			p++;
+			if(p < end && *p != '/' && !readIndex(p, end, texcoords, corner.texcoord))
+				return false;
+			if(p < end && *p == '/')
+			{
+				p++;
+				if(!readIndex(p, end, normals, corner.normal))
+					return false;
+			}
+		}
+		if(p < end && !isSpace(*p))
+			return false;
+
+		if(count == 0)
+			first = corner;
+		else if(count >= 2)
+		{
+			chunk.corners.push_back(first);
+			chunk.corners.push_back(previous);
+			chunk.corners.push_back(corner);
+		}
+		previous = corner;
+		count++;
+	}
+	return count >= 3;
+}
+
+void countElements(Chunk& chunk)
+{
+	const char* p = chunk.begin;
+	while(p < chunk.end)
+	{
+		const char* lineEnd = (const char*)std::memchr(p, '\n', chunk.end - p);
+		if(!lineEnd)
+			lineEnd = chunk.end;
+
+		LineType type = lineType(p, lineEnd);
+		chunk.positionCount += type == POSITION;
+		chunk.texcoordCount += type == TEXCOORD;
+		chunk.normalCount += type == NORMAL;
+		p = lineEnd + 1;
+	}
+}
+
+// the elements go straight into data at the chunk's bases, which have room for them already
+void parseChunk(Chunk& chunk, ObjData& data)
+{
+	size_t positions = chunk.positionBase;
+	size_t texcoords = chunk.texcoordBase;
+	size_t normals = chunk.normalBase;
+
+	const char* p = chunk.begin;
+	while(p < chunk.end)
+	{
+		const char* lineStart = p;
+		const char* lineEnd = (const char*)std::memchr(p, '\n', chunk.end - p);
+		if(!lineEnd)
+			lineEnd = chunk.end;
+
+		bool valid = true;
+		switch(lineType(p, lineEnd))
+		{
+		case POSITION:
+		{
+			// a w or vertex colors may follow, they are ignored
+			glm::vec3& position = data.positions[positions++];
+			valid = readFloat(p, lineEnd, position.x) && readFloat(p, lineEnd, position.y) && readFloat(p, lineEnd, position.z);
+			break;
+		}
+		case TEXCOORD:
+		{
+			// v and w are optional
+			glm::vec2& texcoord = data.texcoords[texcoords++];
+			valid = readFloat(p, lineEnd, texcoord.x);
+			if(valid && !readFloat(p, lineEnd, texcoord.y))
+				texcoord.y = 0.0f;
+			break;
+		}
+		case NORMAL:
+		{
+			glm::vec3& normal = data.normals[normals++];
+			valid = readFloat(p, lineEnd, normal.x) && readFloat(p, lineEnd, normal.y) && readFloat(p, lineEnd, normal.z);
+			break;
+		}
+		case FACE:
+			valid = readFace(p, lineEnd, chunk, positions, texcoords, normals);
+			break;
+		case OTHER:
+			break;
+		}
+
+		if(!valid && chunk.error.empty())
+			chunk.error.assign(lineStart, lineEnd);
+		p = lineEnd + 1;
+	}
+}
+
+}
+
+
+bool loadObj(const std::string& path, Mesh& mesh)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	std::ifstream file(path, std::ios::binary);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open OBJ file: " + path);
+		return false;
+	}
+
+	ThreadPool pool;
+	ObjData data;
+	std::vector<char> block;
+	// the unfinished last line of the previous block, at the start of block
+	size_t carried = 0;
+	bool endOfFile = false;
+	while(!endOfFile)
+	{
+		block.resize(carried + BLOCK_SIZE);
+		file.read(block.data() + carried, BLOCK_SIZE);
+		size_t size = carried + (size_t)file.gcount();
+		if(file.bad())
+		{
+			logger::Log(logger::LogLevel::ERROR, "Failed to read OBJ file: " + path);
+			return false;
+		}
+		endOfFile = file.eof();
+
+		// everything up to the last line end is parsed now, the rest waits for the next block
+		size_t parsed = size;
+		if(!endOfFile)
+		{
+			while(parsed > 0 && block[parsed - 1] != '\n')
+				parsed--;
+			// a line longer than a block, read on until it ends
+			if(parsed == 0)
+			{
+				carried = size;
+				continue;
+			}
+		}
+
+		std::vector<Chunk> chunks;
+		const char* p = block.data();
+		const char* end = p + parsed;
+		while(p < end)
+		{
+			const char* chunkEnd = p + std::min(CHUNK_SIZE, (size_t)(end - p));
+			while(chunkEnd < end && chunkEnd[-1] != '\n')
+				chunkEnd++;
+			chunks.emplace_back();
+			chunks.back().begin = p;
+			chunks.back().end = chunkEnd;
+			p = chunkEnd;
+		}
+
+		pool.parallelFor((unsigned int)chunks.size(), [&](unsigned int index, unsigned int)
+		{
+			countElements(chunks[index]);
+		});
+
+		// the elements of every chunk go right after the ones of the chunks before it
+		size_t positionCount = data.positions.size();
+		size_t texcoordCount = data.texcoords.size();
+		size_t normalCount = data.normals.size();
+		for(Chunk& chunk : chunks)
+		{
+			chunk.positionBase = positionCount;
+			chunk.texcoordBase = texcoordCount;
+			chunk.normalBase = normalCount;
+			positionCount += chunk.positionCount;
+			texcoordCount += chunk.texcoordCount;
+			normalCount += chunk.normalCount;
+		}
+		data.positions.resize(positionCount);
+		data.texcoords.resize(texcoordCount);
+		data.normals.resize(normalCount);
+
+		pool.parallelFor((unsigned int)chunks.size(), [&](unsigned int index, unsigned int)
+		{
+			parseChunk(chunks[index], data);
+		});
+
+		for(const Chunk& chunk : chunks)
+		{
+			if(!chunk.error.empty())
+			{
+				logger::Log(logger::LogLevel::ERROR, "Invalid line in OBJ file " + path + ": " + chunk.error);
+				return false;
+			}
+			data.corners.insert(data.corners.end(), chunk.corners.begin(), chunk.corners.end());
+		}
+
+		carried = size - parsed;
+		std::memmove(block.data(), block.data() + parsed, carried);
+	}
+
+	if(data.corners.empty())
+	{
+		logger::Log(logger::LogLevel::ERROR, "OBJ file " + path + " has no faces");
+		return false;
+	}
+
+	// one vertex per distinct corner, and the triangles as indices into them
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+	indices.reserve(data.corners.size());
+	// corners with only a position (scans often have nothing else) need no hashing, just a table by position
+	std::vector<uint32_t> positionVertices(data.positions.size(), NO_INDEX);
+	std::unordered_map<Corner, uint32_t, CornerHash> vertexIndices;
+	for(const Corner& corner : data.corners)
+	{
+		bool inRange = corner.position < data.positions.size()
+			&& (corner.texcoord == NO_INDEX || corner.texcoord < data.texcoords.size())
+			&& (corner.normal == NO_INDEX || corner.normal < data.normals.size());
+		if(!inRange)
+		{
+			logger::Log(logger::LogLevel::ERROR, "OBJ file " + path + " has a face with an index out of range");
+			return false;
+		}
+
+		uint32_t& vertexIndex = corner.texcoord == NO_INDEX && corner.normal == NO_INDEX ? positionVertices[corner.position]
+			: vertexIndices.emplace(corner, NO_INDEX).first->second;
+		if(vertexIndex == NO_INDEX)
+		{
+			vertexIndex = (uint32_t)vertices.size();
+			MeshVertex vertex;
+			vertex.position = data.positions[corner.position];
+			glm::vec2 texcoord = corner.texcoord != NO_INDEX ? data.texcoords[corner.texcoord] : glm::vec2(0.0f);
+			vertex.u = texcoord.x;
+			vertex.v = texcoord.y;
+			vertex.normal = corner.normal != NO_INDEX ? data.normals[corner.normal] : glm::vec3(0.0f);
+			vertices.push_back(vertex);
+		}
+		indices.push_back(vertexIndex);
+	}
+
+	mesh.path = path;
+	mesh.vertices = std::move(vertices);
+	mesh.indices = std::move(indices);
+	mesh.build();
+
+	float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	logger::Log(logger::LogLevel::INFO, "Loaded " + std::to_string(mesh.triangleCount()) + " triangles with " + std::to_string(mesh.vertices.size()) + " vertices from " + path + " in " + std::to_string(elapsed) + " ms");
+	return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+#include "Mesh.h"
+
+
+// Reads the triangles of a Wavefront OBJ file into mesh and builds its BVH. Positions, texture
+// coordinates and normals are read, polygons are split into fans, everything else (groups, objects,
+// .mtl materials, ...) is skipped. Corners with the same position, texture coordinate and normal
+// share one vertex.
+//
+// The file is read a block at a time, and each block is split at line ends into chunks that are
+// parsed in parallel, so only the mesh itself has to fit into memory, not the text.
+// Returns false and logs why if the file can't be used.
+bool loadObj(const std::string& path, Mesh& mesh);
@@ -0,0 +1,141 @@
+#include "Offline.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "CPURaytracer.h"
+#include "GLItems.h"
+#include "GPURaytracer.h"
+#include "ImageWriter.h"
+#include "RenderTarget.h"
+#include "Scene.h"
+#include "logger.h"
+
+
+static void headless_error_callback(int error, const char* description)
+{
+	logger::Log(logger::LogLevel::ERROR, std::string("GLFW error: ") + description);
+}
+
+GLFWwindow* createHeadlessContext(const Options& options)
+{
+	glfwSetErrorCallback(headless_error_callback);
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	if(!glfwInit())
+	{
+		logger::Log(logger::LogLevel::FATAL, "Failed to initialize GLFW");
+		return nullptr;
+	}
+
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, options.context == HeadlessContext::OSMESA ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OPENGL_MAJOR_VERSION);
+
+	// the newest version first, software renderers like llvmpipe refuse it and get 4.5
+	GLFWwindow* window = nullptr;
+	for(int minor = OPENGL_MINOR_VERSION; !window && minor >= OPENGL_HEADLESS_MINOR_VERSION; minor--)
+	{
+		bool last = minor == OPENGL_HEADLESS_MINOR_VERSION;
+		glfwSetErrorCallback(last ? headless_error_callback : nullptr);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+		window = glfwCreateWindow(options.width, options.height, "Raytracing In OpenGL", NULL, NULL);
+		if(!window && !last)
+			logger::Log(logger::LogLevel::DEBUG, "No OpenGL " + std::to_string(OPENGL_MAJOR_VERSION) + "." + std::to_string(minor) + " core context, trying an older one");
+	}
+	glfwSetErrorCallback(headless_error_callback);
+	if(!window)
+	{
+		logger::Log(logger::LogLevel::FATAL, std::string("Failed to create headless ") + (options.context == HeadlessContext::OSMESA ? "OSMesa" : "EGL") + " context");
+		glfwTerminate();
+		return nullptr;
+	}
+	glfwMakeContextCurrent(window);
+
+	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		logger::Log(logger::LogLevel::FATAL, "Failed to initialize GLAD");
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return nullptr;
+	}
+
+	logger::Log(logger::LogLevel::INFO, std::string("Headless context: ") + (const char*)glGetString(GL_RENDERER) + ", " + (const char*)glGetString(GL_VERSION));
+	return window;
+}
+
+static void logProgress(int frame, int frames)
+{
+	// about every tenth of the way, and always for the last frame
+	int step = std::max(frames / 10, 1);
+	if((frame + 1) % step == 0 || frame + 1 == frames)
+		logger::Log(logger::LogLevel::INFO, "Rendered frame " + std::to_string(frame + 1) + "/" + std::to_string(frames));
+}
+
+
+int renderOffline(const Options& options)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	Scene scene(defaultSceneList());
+	if(!options.scene.empty() && !scene.load(options.scene))
+		return EXIT_FAILURE;
+	RenderSettings settings = {options.lookFrom, options.lookAt, options.maxDepth, options.samples, 0};
+	std::vector<float> pixels;
+
+	if(options.backend == Backend::CPU)
+	{
+		CPURaytracer raytracer(options.threads);
+		raytracer.setSimdBackend(selectedSimdBackend(options));
+		const char* simdName = raytracer.simdBackend() ? raytracer.simdBackend()->name : "no SIMD";
+		logger::Log(logger::LogLevel::INFO, "Rendering on the CPU with " + std::to_string(raytracer.threadCount()) + " threads and " + simdName);
+
+		for(int frame = 0; frame < options.frames; frame++)
+		{
+			settings.frameIndex = frame;
+			raytracer.render(scene, settings, options.width, options.height, pixels);
+			logProgress(frame, options.frames);
+		}
+	}
+	else
+	{
+		GLFWwindow* window = createHeadlessContext(options);
+		if(!window)
+			return EXIT_FAILURE;
+
+		RenderTarget target;
+		target.setScreenFormat(options.screenFormat);
+		target.create(glm::ivec2(options.width, options.height));
+		ProgramCache programCache(options.shaderCache);
+		GPURaytracer raytracer(programCache, glm::ivec2(DEFAULT_LOCAL_SIZE_X, DEFAULT_LOCAL_SIZE_Y));
+		raytracer.setPipeline(options.pipeline);
+		raytracer.setScreenFormat(options.screenFormat);
+
+		uint64_t rays = 0;
+		auto traceStart = std::chrono::high_resolution_clock::now();
+		for(int frame = 0; frame < options.frames; frame++)
+		{
+			settings.frameIndex = frame;
+			raytracer.render(scene, settings, target);
+			// one frame at a time, so a long render doesn't queue up more work than the driver likes
+			glFinish();
+			rays += raytracer.raysPerFrame();
+			logProgress(frame, options.frames);
+		}
+		double traceSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - traceStart).count();
+		logger::Log(logger::LogLevel::INFO, "Traced " + std::to_string(rays) + " rays, " + std::to_string(rays / traceSeconds / 1e6) + " Mrays/s");
+		target.readScreen(pixels);
+
+		raytracer.release();
+		target.release();
+		scene.releaseBuffers();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	logger::Log(logger::LogLevel::INFO, "Rendered " + std::to_string(options.width) + "x" + std::to_string(options.height) + " at " + std::to_string(options.samples * options.frames) + " samples per pixel in " + std::to_string(std::chrono::duration<double>(endTime - startTime).count()) + " s");
+
+	return writeImage(options.output, options.width, options.height, pixels) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "Options.h"
+
+struct GLFWwindow;
+
+
+// Renders options.frames frames without opening a window and writes the result to options.output.
+// The GPU backend runs in a surfaceless OSMesa or EGL context, the CPU backend needs no GL at all.
+// Returns the exit code for main().
+int renderOffline(const Options& options);
+
+// A hidden window on GLFW's null platform, so nothing needs a display server. The context itself comes
+// from OSMesa or from EGL's surfaceless platform, as options.context says, and is made current.
+// It is OpenGL 4.6 core, or 4.5 where that's all there is, like on llvmpipe.
+// Returns nullptr if it can't be created, the caller owns the window and terminates GLFW otherwise.
+GLFWwindow* createHeadlessContext(const Options& options);
@@ -0,0 +1,187 @@
+#include "Options.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "BVH.h"
+#include "SimdTraversal.h"
+#include "logger.h"
+
+
+static bool parseInt(const char* text, int minValue, int& value)
+{
+	char* end;
+	long parsed = std::strtol(text, &end, 10);
+	if(*end != '\0' || parsed < minValue)
+		return false;
+	value = (int)parsed;
+	return true;
+}
+
+static bool parseVec3(const char* text, glm::vec3& value)
+{
+	return std::sscanf(text, "%f,%f,%f", &value.x, &value.y, &value.z) == 3;
+}
+
+
+static bool takesValue(const std::string& arg)
+{
+	const char* valueOptions[] = {"--backend", "--pipeline", "--screen-format", "--context", "--width", "--height", "--samples", "--frames", "--depth", "--threads", "--simd", "--bvh-leaf-size", "--bvh-bins", "--lookfrom", "--lookat", "--scene", "--output", "-o", "--shader-cache"};
+	for(const char* option : valueOptions)
+		if(arg == option)
+			return true;
+	return false;
+}
+
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		// every option but the flags takes one value
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool valid = true;
+		bool usedValue = true;
+
+		if(arg == "--help" || arg == "-h")
+		{
+			options.help = true;
+			printUsage(argv[0]);
+			return false;
+		}
+		else if(arg == "--headless")
+		{
+			options.headless = true;
+			usedValue = false;
+		}
+		else if(!takesValue(arg))
+		{
+			logger::Log(logger::LogLevel::ERROR, "Unknown option: " + arg);
+			printUsage(argv[0]);
+			return false;
+		}
+		else if(!value)
+			valid = false;
+		else if(arg == "--backend")
+		{
+			if(std::strcmp(value, "gpu") == 0)
+				options.backend = Backend::GPU;
+			else if(std::strcmp(value, "cpu") == 0)
+				options.backend = Backend::CPU;
+			else
+				valid = false;
+		}
+		else if(arg == "--pipeline")
+		{
+			if(std::strcmp(value, "mega") == 0)
+				options.pipeline = GPUPipeline::MEGAKERNEL;
+			else if(std::strcmp(value, "wavefront") == 0)
+				options.pipeline = GPUPipeline::WAVEFRONT;
+			else
+				valid = false;
+		}
+		else if(arg == "--screen-format")
+		{
+			if(std::strcmp(value, "rgba8") == 0)
+				options.screenFormat = ScreenFormat::RGBA8;
+			else if(std::strcmp(value, "rgba16f") == 0)
+				options.screenFormat = ScreenFormat::RGBA16F;
+			else if(std::strcmp(value, "r11g11b10f") == 0)
+				options.screenFormat = ScreenFormat::R11F_G11F_B10F;
+			else
+				valid = false;
+		}
+		else if(arg == "--context")
+		{
+			if(std::strcmp(value, "osmesa") == 0)
+				options.context = HeadlessContext::OSMESA;
+			else if(std::strcmp(value, "egl") == 0)
+				options.context = HeadlessContext::EGL;
+			else
+				valid = false;
+		}
+		else if(arg == "--width")
+			valid = parseInt(value, 1, options.width);
+		else if(arg == "--height")
+			valid = parseInt(value, 1, options.height);
+		else if(arg == "--samples")
+			valid = parseInt(value, 1, options.samples);
+		else if(arg == "--frames")
+			valid = parseInt(value, 1, options.frames);
+		else if(arg == "--depth")
+			valid = parseInt(value, 1, options.maxDepth);
+		else if(arg == "--threads")
+		{
+			int threads;
+			valid = parseInt(value, 0, threads);
+			options.threads = (unsigned int)threads;
+		}
+		else if(arg == "--simd")
+		{
+			options.simd = value;
+			if(options.simd != "auto" && options.simd != "off" && !findSimdBackend(options.simd))
+			{
+				logger::Log(logger::LogLevel::ERROR, "This CPU can't run " + options.simd);
+				valid = false;
+			}
+		}
+		else if(arg == "--bvh-leaf-size")
+			valid = parseInt(value, 1, options.bvhLeafSize);
+		else if(arg == "--bvh-bins")
+			valid = parseInt(value, 2, options.bvhBins) && options.bvhBins <= BVH::MAX_BIN_COUNT;
+		else if(arg == "--lookfrom")
+			valid = parseVec3(value, options.lookFrom);
+		else if(arg == "--lookat")
+			valid = parseVec3(value, options.lookAt);
+		else if(arg == "--scene")
+			options.scene = value;
+		else if(arg == "--output" || arg == "-o")
+			options.output = value;
+		else if(arg == "--shader-cache")
+			options.shaderCache = value;
+
+		if(!valid)
+		{
+			logger::Log(logger::LogLevel::ERROR, "Invalid or missing value for " + arg);
+			printUsage(argv[0]);
+			return false;
+		}
+		if(usedValue)
+			i++;
+	}
+	return true;
+}
+
+const SimdBackend* selectedSimdBackend(const Options& options)
+{
+	return options.simd == "auto" ? bestSimdBackend() : findSimdBackend(options.simd);
+}
+
+void printUsage(const char* program)
+{
+	std::printf(
+		"Usage: %s [options]\n"
+		"\n"
+		"  --headless            render without a window, write the image to --output and exit\n"
+		"  --backend gpu|cpu     compute shader or CPU raytracer (default gpu)\n"
+		"  --pipeline NAME       GPU backend pipeline, mega or wavefront (default mega)\n"
+		"  --screen-format FMT   GPU display image, rgba8, rgba16f or r11g11b10f (default rgba8)\n"
+		"  --context osmesa|egl  how the headless GL context is created (default osmesa)\n"
+		"  --width N             image width (default 800)\n"
+		"  --height N            image height (default 400)\n"
+		"  --samples N           samples per pixel per frame (default 2)\n"
+		"  --frames N            frames averaged in headless mode (default 1)\n"
+		"  --depth N             maximum bounces (default 2)\n"
+		"  --lookfrom X,Y,Z      camera position (default 13,2,3)\n"
+		"  --lookat X,Y,Z        point the camera looks at (default 0,0,0)\n"
+		"  --scene PATH          .rtscene or text scene to render (default the built in one)\n"
+		"  --threads N           CPU backend threads, 0 for all (default 0)\n"
+		"  --simd NAME           CPU backend SIMD: auto, off, sse, avx2 or avx512 (default auto)\n"
+		"  --bvh-leaf-size N     most primitives a BVH leaf is made of rather than split (default 4)\n"
+		"  --bvh-bins N          SAH bins per axis of the BVH builder, 2 to 64 (default 16)\n"
+		"  -o, --output PATH     .png, .ppm or .exr file for headless mode (default render.png)\n"
+		"  --shader-cache DIR    where linked shaders are cached, \"\" to disable (default shader_cache)\n"
+		"  -h, --help            show this message\n",
+		program);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+
+#include "RenderSettings.h"
+
+struct SimdBackend;
+
+
+// how the GL context is created when there is no window
+enum class HeadlessContext { OSMESA, EGL };
+
+// everything that can be set on the command line, see printUsage()
+struct Options
+{
+	// --help was given, only the usage gets printed
+	bool help = false;
+	// render once without a window, write the image and exit
+	bool headless = false;
+	Backend backend = Backend::GPU;
+	GPUPipeline pipeline = GPUPipeline::MEGAKERNEL;
+	ScreenFormat screenFormat = ScreenFormat::RGBA8;
+	HeadlessContext context = HeadlessContext::OSMESA;
+
+	int width = 800;
+	int height = 400;
+	// samples per pixel in every frame, and how many frames are averaged in headless mode
+	int samples = 2;
+	int frames = 1;
+	int maxDepth = 2;
+	glm::vec3 lookFrom = glm::vec3(13.0f, 2.0f, 3.0f);
+	glm::vec3 lookAt = glm::vec3(0.0f, 0.0f, 0.0f);
+	// 0 uses every hardware thread
+	unsigned int threads = 0;
+	// SIMD backend of the CPU raytracer (see SimdTraversal.h), "auto" for the widest one there is, "off" for none
+	std::string simd = "auto";
+	// BVH builds (see BVHBuildSettings)
+	int bvhLeafSize = 4;
+	int bvhBins = 16;
+
+	// .rtscene or text scene to render instead of the default one (see Scene::load())
+	std::string scene;
+	std::string output = "render.png";
+	// linked shader programs are kept here between runs, empty turns the cache off
+	std::string shaderCache = "shader_cache";
+};
+
+
+// the SIMD backend options.simd asks for, nullptr for none
+const SimdBackend* selectedSimdBackend(const Options& options);
+
+// returns false if the arguments are invalid or --help was given (options.help tells which),
+// the usage has been printed then
+bool parseOptions(int argc, char** argv, Options& options);
+void printUsage(const char* program);
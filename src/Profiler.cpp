@@ -0,0 +1,186 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <imgui.h>
+
+#include "logger.h"
+
+
+Profiler::Profiler(std::vector<Stage> stages)
+	: stages(std::move(stages))
+{
+	size_t stageCount = this->stages.size();
+	queries.resize(QUERY_RING_SIZE * stageCount);
+	queryFrame.resize(queries.size(), 0);
+	queryPending.resize(queries.size(), false);
+	glCreateQueries(GL_TIME_ELAPSED, (GLsizei)queries.size(), queries.data());
+
+	stageStart.resize(stageCount);
+	latestCpuTime.resize(stageCount, 0.0f);
+	latestGpuTime.resize(stageCount, 0.0f);
+	latestGpuFrame.resize(stageCount, 0);
+}
+
+void Profiler::release()
+{
+	if(!queries.empty())
+		glDeleteQueries((GLsizei)queries.size(), queries.data());
+	queries.clear();
+}
+
+void Profiler::beginFrame()
+{
+	collectQueries();
+
+	FrameTimes times;
+	times.frame = frameNumber;
+	times.cpu.resize(stages.size(), 0.0f);
+	times.gpu.resize(stages.size(), -1.0f);
+	history.push_back(std::move(times));
+	if(history.size() > HISTORY_SIZE)
+		history.pop_front();
+}
+
+void Profiler::endFrame()
+{
+	frameNumber++;
+}
+
+void Profiler::beginStage(int stage)
+{
+	stageStart[stage] = std::chrono::high_resolution_clock::now();
+	if(!stages[stage].gpuTimed)
+		return;
+
+	size_t query = (frameNumber % QUERY_RING_SIZE) * stages.size() + stage;
+	// the GPU is more than QUERY_RING_SIZE frames behind, this result is lost
+	if(queryPending[query])
+		droppedQueries++;
+	queryFrame[query] = frameNumber;
+	glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+}
+
+void Profiler::endStage(int stage)
+{
+	if(stages[stage].gpuTimed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		queryPending[(frameNumber % QUERY_RING_SIZE) * stages.size() + stage] = true;
+	}
+
+	float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - stageStart[stage]).count();
+	latestCpuTime[stage] = elapsed;
+	history.back().cpu[stage] = elapsed;
+}
+
+void Profiler::collectQueries()
+{
+	for(size_t query = 0; query < queries.size(); query++)
+	{
+		if(!queryPending[query])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			continue;
+
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+		queryPending[query] = false;
+
+		size_t stage = query % stages.size();
+		float milliseconds = elapsed / 1e6f;
+		if(queryFrame[query] >= latestGpuFrame[stage])
+		{
+			latestGpuFrame[stage] = queryFrame[query];
+			latestGpuTime[stage] = milliseconds;
+		}
+
+		if(!history.empty() && queryFrame[query] >= history.front().frame)
+			history[queryFrame[query] - history.front().frame].gpu[stage] = milliseconds;
+	}
+}
+
+void Profiler::drawWindow()
+{
+	ImGui::Begin("Profiler");
+
+	std::vector<float> cpuValues(history.size()), gpuValues(history.size());
+	for(size_t stage = 0; stage < stages.size(); stage++)
+	{
+		float cpuAverage = 0.0f, gpuAverage = 0.0f;
+		int gpuCount = 0;
+		for(size_t i = 0; i < history.size(); i++)
+		{
+			cpuValues[i] = history[i].cpu[stage];
+			gpuValues[i] = std::max(history[i].gpu[stage], 0.0f);
+			cpuAverage += cpuValues[i];
+			if(history[i].gpu[stage] >= 0.0f)
+			{
+				gpuAverage += history[i].gpu[stage];
+				gpuCount++;
+			}
+		}
+		cpuAverage /= std::max<size_t>(history.size(), 1);
+		gpuAverage /= std::max(gpuCount, 1);
+
+		const Stage& s = stages[stage];
+		if(s.gpuTimed)
+		{
+			ImGui::Text("%s: %.3f ms GPU, %.3f ms CPU", s.name.c_str(), gpuAverage, cpuAverage);
+			ImGui::PlotLines((s.name + " GPU").c_str(), gpuValues.data(), (int)gpuValues.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+		}
+		else
+			ImGui::Text("%s: %.3f ms CPU", s.name.c_str(), cpuAverage);
+		ImGui::PlotLines((s.name + " CPU").c_str(), cpuValues.data(), (int)cpuValues.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+	}
+
+	if(droppedQueries > 0)
+		ImGui::Text("Dropped GPU timings: %u", droppedQueries);
+
+	ImGui::InputText("CSV file", csvPath, sizeof(csvPath));
+	if(ImGui::Button("Export CSV"))
+		exportCSV(csvPath);
+
+	ImGui::End();
+}
+
+bool Profiler::exportCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open profile file: " + path);
+		return false;
+	}
+
+	file << "frame";
+	for(const Stage& stage : stages)
+	{
+		file << "," << stage.name << " CPU ms";
+		if(stage.gpuTimed)
+			file << "," << stage.name << " GPU ms";
+	}
+	file << "\n";
+
+	for(const FrameTimes& times : history)
+	{
+		file << times.frame;
+		for(size_t stage = 0; stage < stages.size(); stage++)
+		{
+			file << "," << times.cpu[stage];
+			if(stages[stage].gpuTimed)
+			{
+				file << ",";
+				if(times.gpu[stage] >= 0.0f)
+					file << times.gpu[stage];
+			}
+		}
+		file << "\n";
+	}
+
+	logger::Log(logger::LogLevel::INFO, "Exported " + std::to_string(history.size()) + " frames of timings to " + path);
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+// Per stage CPU and GPU timings of the last HISTORY_SIZE frames.
+// GPU times come from GL_TIME_ELAPSED queries kept in a ring of QUERY_RING_SIZE frames, so a result
+// is only read once the GPU is done with it and the render loop never waits on a query.
+// Stages can't overlap, GL only allows one GL_TIME_ELAPSED query at a time.
+class Profiler
+{
+public:
+	static const int QUERY_RING_SIZE = 4;
+	static const int HISTORY_SIZE = 300;
+
+	struct Stage
+	{
+		std::string name;
+		// CPU only stages (like waiting for the swap) don't get a query
+		bool gpuTimed;
+	};
+
+	explicit Profiler(std::vector<Stage> stages);
+	// deletes the queries, has to happen while the GL context is still alive
+	void release();
+
+	// reads whatever queries have finished since the last frame
+	void beginFrame();
+	void endFrame();
+
+	void beginStage(int stage);
+	void endStage(int stage);
+
+	// most recent time in ms, the GPU one lags a few frames behind
+	float cpuTime(int stage) const { return latestCpuTime[stage]; }
+	float gpuTime(int stage) const { return latestGpuTime[stage]; }
+
+	// graphs of every stage, in its own ImGui window
+	void drawWindow();
+	// one row per frame in the history, GPU times that never arrived are left empty
+	bool exportCSV(const std::string& path) const;
+
+private:
+	struct FrameTimes
+	{
+		uint64_t frame;
+		std::vector<float> cpu;
+		// negative until the query result is in
+		std::vector<float> gpu;
+	};
+
+	void collectQueries();
+
+	std::vector<Stage> stages;
+
+	// QUERY_RING_SIZE slots of one query per stage
+	std::vector<GLuint> queries;
+	std::vector<uint64_t> queryFrame;
+	std::vector<bool> queryPending;
+	unsigned int droppedQueries = 0;
+
+	std::deque<FrameTimes> history;
+	uint64_t frameNumber = 0;
+	std::vector<std::chrono::high_resolution_clock::time_point> stageStart;
+	std::vector<float> latestCpuTime;
+	std::vector<float> latestGpuTime;
+	std::vector<uint64_t> latestGpuFrame;
+
+	char csvPath[256] = "profile.csv";
+};
@@ -0,0 +1,188 @@
+#include "ProgramCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "logger.h"
+
+
+// every binary file starts with this, so an unrelated or truncated file is never handed to the driver
+struct BinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+static const char BINARY_MAGIC[4] = {'R', 'T', 'P', 'B'};
+static const uint32_t BINARY_VERSION = 1;
+
+
+static std::string glString(GLenum name)
+{
+	const GLubyte* value = glGetString(name);
+	return value ? std::string((const char*)value) : std::string();
+}
+
+
+ProgramCache::ProgramCache(std::string directory)
+	: directory(std::move(directory))
+{
+	driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+	enabled = !this->directory.empty();
+	if(!enabled)
+		return;
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	enabled = formatCount > 0;
+	if(!enabled)
+	{
+		logger::Log(logger::LogLevel::WARNING, "Driver supports no program binary formats, shaders are always compiled from source");
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if(error)
+	{
+		logger::Log(logger::LogLevel::WARNING, "Failed to create shader cache " + this->directory + ": " + error.message());
+		enabled = false;
+	}
+}
+
+ShaderProgram ProgramCache::load(const std::vector<Stage>& stages)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t programKey = key(stages);
+
+	if(enabled)
+	{
+		if(GLuint program = loadBinary(programKey))
+		{
+			cacheHits++;
+			float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			logger::Log(logger::LogLevel::DEBUG, "Loaded " + stages.front().name + " from the shader cache in " + std::to_string(elapsed) + " ms");
+			return ShaderProgram::fromLinked(program);
+		}
+	}
+	cacheMisses++;
+
+	std::vector<GLuint> shaders;
+	for(const Stage& stage : stages)
+		shaders.push_back(compileShader(stage.source, stage.type, stage.name));
+	GLuint program = createShaderProgram(shaders, enabled);
+	for(GLuint shader : shaders)
+		glDeleteShader(shader);
+
+	if(enabled)
+		storeBinary(programKey, program);
+
+	float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	logger::Log(logger::LogLevel::DEBUG, "Built " + stages.front().name + " from source in " + std::to_string(elapsed) + " ms");
+	return ShaderProgram::fromLinked(program);
+}
+
+void ProgramCache::store(const std::vector<Stage>& stages, GLuint program) const
+{
+	if(enabled)
+		storeBinary(key(stages), program);
+}
+
+uint64_t ProgramCache::key(const std::vector<Stage>& stages) const
+{
+	// collisions don't matter much, the key is stored and checked in the header too
+	uint64_t hash = hashBytes(FNV_OFFSET_BASIS, driver.data(), driver.size());
+	for(const Stage& stage : stages)
+	{
+		hash = hashBytes(hash, &stage.type, sizeof(stage.type));
+		hash = hashBytes(hash, &stage.source.hash, sizeof(stage.source.hash));
+	}
+	return hash;
+}
+
+std::string ProgramCache::path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+GLuint ProgramCache::loadBinary(uint64_t key) const
+{
+	std::ifstream file(path(key), std::ios::binary);
+	if(!file.is_open())
+		return 0;
+
+	BinaryHeader header;
+	if(!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, BINARY_MAGIC, 4) != 0 ||
+		header.version != BINARY_VERSION || header.key != key)
+	{
+		logger::Log(logger::LogLevel::WARNING, "Ignoring invalid shader cache file " + path(key));
+		return 0;
+	}
+
+	std::vector<char> binary(header.length);
+	if(!file.read(binary.data(), binary.size()))
+	{
+		logger::Log(logger::LogLevel::WARNING, "Shader cache file " + path(key) + " is truncated");
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+	// drivers reject binaries after an update even when the version string stays the same
+	GLint success = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if(!success)
+	{
+		logger::Log(logger::LogLevel::INFO, "Driver rejected cached shader binary " + path(key) + ", compiling from source");
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ProgramCache::storeBinary(uint64_t key, GLuint program) const
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	BinaryHeader header;
+	std::memcpy(header.magic, BINARY_MAGIC, 4);
+	header.version = BINARY_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	// written to a temporary first, so a crash halfway never leaves a broken file under the real name
+	std::string finalPath = path(key);
+	std::string tempPath = finalPath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary);
+		if(!file.is_open())
+		{
+			logger::Log(logger::LogLevel::WARNING, "Failed to write shader cache file " + tempPath);
+			return;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, finalPath, error);
+	if(error)
+		logger::Log(logger::LogLevel::WARNING, "Failed to store shader cache file " + finalPath + ": " + error.message());
+}
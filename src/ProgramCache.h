@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GLItems.h"
+
+
+// Keeps linked programs on disk with glGetProgramBinary, so later launches skip compiling and linking.
+// A binary is keyed on the source hash of every stage (defines and includes are part of the source
+// by then) and on the driver's vendor, renderer and version strings, as a binary is only valid
+// for the exact driver that made it. Anything that doesn't load falls back to the source.
+class ProgramCache
+{
+public:
+	struct Stage
+	{
+		GLenum type;
+		// only used in the log
+		std::string name;
+		ShaderSource source;
+	};
+
+	// needs a current GL context, binaries are stored in directory, an empty one disables the cache
+	explicit ProgramCache(std::string directory);
+
+	ShaderProgram load(const std::vector<Stage>& stages);
+	// stores a program linked elsewhere, it has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	void store(const std::vector<Stage>& stages, GLuint program) const;
+	bool isEnabled() const { return enabled; }
+
+	unsigned int hits() const { return cacheHits; }
+	unsigned int misses() const { return cacheMisses; }
+
+private:
+	uint64_t key(const std::vector<Stage>& stages) const;
+	std::string path(uint64_t key) const;
+	GLuint loadBinary(uint64_t key) const;
+	void storeBinary(uint64_t key, GLuint program) const;
+
+	std::string directory;
+	std::string driver;
+	// drivers are allowed to support no binary formats at all
+	bool enabled;
+	unsigned int cacheHits = 0;
+	unsigned int cacheMisses = 0;
+};
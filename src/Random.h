@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Integer random number generator shared by the CPU backend, the functions of the same name in
+// shaders/include/random.glsl do exactly the same with GLSL uints so both backends draw the same numbers.
+// The state is a single PCG32 word, seeded per pixel, sample and frame.
+
+// PCG-RXS-M-XS output permutation, good enough on its own to hash seeds
+inline uint32_t pcgHash(uint32_t v)
+{
+	uint32_t state = v * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+inline uint32_t rngSeed(uint32_t x, uint32_t y, uint32_t sample, uint32_t frame)
+{
+	return pcgHash(x + pcgHash(y + pcgHash(sample + pcgHash(frame))));
+}
+
+// uniform in [0, 1), the top 24 bits are exactly representable as a float
+inline float randomFloat(uint32_t& rngState)
+{
+	rngState = rngState * 747796405u + 2891336453u;
+	uint32_t word = ((rngState >> ((rngState >> 28u) + 4u)) ^ rngState) * 277803737u;
+	word = (word >> 22u) ^ word;
+	return float(word >> 8u) * (1.0f / 16777216.0f);
+}
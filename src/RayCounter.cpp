@@ -0,0 +1,71 @@
+#include "RayCounter.h"
+
+
+RayCounter::RayCounter()
+{
+	glCreateBuffers(RING_SIZE, buffers);
+	for(int i = 0; i < RING_SIZE; i++)
+	{
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glNamedBufferStorage(buffers[i], sizeof(uint32_t), nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+		counts[i] = (const volatile uint32_t*)glMapNamedBufferRange(buffers[i], 0, sizeof(uint32_t), flags);
+	}
+}
+
+void RayCounter::release()
+{
+	for(int i = 0; i < RING_SIZE; i++)
+	{
+		if(fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = nullptr;
+		if(buffers[i])
+			glUnmapNamedBuffer(buffers[i]);
+	}
+	glDeleteBuffers(RING_SIZE, buffers);
+	for(int i = 0; i < RING_SIZE; i++)
+		buffers[i] = 0;
+}
+
+void RayCounter::beginFrame()
+{
+	collect();
+	current = (current + 1) % RING_SIZE;
+
+	// the GPU is more than RING_SIZE frames behind, waiting for it costs next to nothing then
+	if(fences[current])
+	{
+		glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		collect();
+	}
+
+	GLuint zero = 0;
+	glClearNamedBufferData(buffers[current], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, buffers[current]);
+}
+
+void RayCounter::endFrame()
+{
+	// shader writes only reach a mapped buffer after this barrier
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// reads every finished frame, oldest first, so latestCount ends up with the newest
+void RayCounter::collect()
+{
+	for(int age = RING_SIZE - 1; age >= 0; age--)
+	{
+		int slot = (current - age + RING_SIZE) % RING_SIZE;
+		if(!fences[slot])
+			continue;
+
+		GLenum status = glClientWaitSync(fences[slot], 0, 0);
+		if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+
+		latestCount = *counts[slot];
+		glDeleteSync(fences[slot]);
+		fences[slot] = nullptr;
+	}
+}
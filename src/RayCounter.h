@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+
+// How many rays the kernels traced per frame (rayCount in shaders/include/stats.glsl).
+// Every frame counts into its own buffer from a ring, which is persistently mapped and read once its
+// fence has passed, so getting the number never stalls the GPU.
+class RayCounter
+{
+public:
+	static const int RING_SIZE = 4;
+
+	// needs a current GL context
+	RayCounter();
+	void release();
+
+	// clears the counter of this frame and binds it to binding 9
+	void beginFrame();
+	// fences the frame, the count can be read once the GPU has passed it
+	void endFrame();
+
+	// reads every frame the GPU has finished since, beginFrame() does it as well
+	void collect();
+	// rays of the latest frame the GPU has finished as of the last collect(), 0 until there is one
+	uint32_t lastCount() const { return latestCount; }
+
+private:
+
+	GLuint buffers[RING_SIZE] = {};
+	const volatile uint32_t* counts[RING_SIZE] = {};
+	GLsync fences[RING_SIZE] = {};
+	int current = 0;
+	uint32_t latestCount = 0;
+};
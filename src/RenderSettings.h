@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+
+
+// which backend renders the image, the compute shader or the CPU port of it
+enum class Backend { GPU, CPU };
+
+// how the GPU backend traces a frame: one kernel doing all of every path (ComputeShader.comp),
+// or a dispatch per stage with the paths kept in buffers in between (WavefrontPipeline)
+enum class GPUPipeline { MEGAKERNEL, WAVEFRONT };
+
+// Storage of screenTex, the image that is shown and that captures and offline renders copy (see RenderTarget).
+// The running average stays in an RGBA32F image so it keeps converging, this is only what leaves it.
+// RGBA8 is clamped to [0, 1], RGBA16F and R11F_G11F_B10F (6 and 5 bit mantissas, no alpha) keep the
+// whole range for EXR at 8 and 4 bytes per pixel, where RGBA32F would take 16.
+enum class ScreenFormat { RGBA8, RGBA16F, R11F_G11F_B10F };
+
+// what both backends need to know to render a frame
+struct RenderSettings
+{
+	glm::vec3 lookFrom;
+	glm::vec3 lookAt;
+	int maxDepth;
+	int numSamples;
+	// number of frames already accumulated, 0 starts a new average
+	unsigned int frameIndex;
+};
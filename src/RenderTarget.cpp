@@ -0,0 +1,132 @@
+#include "RenderTarget.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "logger.h"
+
+
+GLenum internalFormat(ScreenFormat format)
+{
+	switch(format)
+	{
+	case ScreenFormat::RGBA16F: return GL_RGBA16F;
+	case ScreenFormat::R11F_G11F_B10F: return GL_R11F_G11F_B10F;
+	default: return GL_RGBA8;
+	}
+}
+
+const char* glslFormat(ScreenFormat format)
+{
+	switch(format)
+	{
+	case ScreenFormat::RGBA16F: return "rgba16f";
+	case ScreenFormat::R11F_G11F_B10F: return "r11f_g11f_b10f";
+	default: return "rgba8";
+	}
+}
+
+const char* formatName(ScreenFormat format)
+{
+	switch(format)
+	{
+	case ScreenFormat::RGBA16F: return "rgba16f";
+	case ScreenFormat::R11F_G11F_B10F: return "r11g11b10f";
+	default: return "rgba8";
+	}
+}
+
+
+void RenderTarget::create(glm::ivec2 size)
+{
+	release();
+
+	allocatedSize = glm::max(size, glm::ivec2(1));
+	currentRenderSize = allocatedSize;
+
+	createScreen();
+
+	// the compute shader keeps a running average of all frames since the view last changed in here,
+	// at full precision, the smaller formats would stop it converging after a few dozen frames
+	glCreateTextures(GL_TEXTURE_2D, 1, &accumulationTex);
+	glTextureStorage2D(accumulationTex, 1, GL_RGBA32F, allocatedSize.x, allocatedSize.y);
+	linearColor = false;
+
+	logger::Log(logger::LogLevel::DEBUG, "Created render target " + std::to_string(allocatedSize.x) + "x" + std::to_string(allocatedSize.y) + ", " + formatName(currentFormat) + " screen");
+}
+
+void RenderTarget::createScreen()
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &screenTex);
+	// linear, the screen shader upsamples from it when the render size is smaller than the window
+	glTextureParameteri(screenTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(screenTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(screenTex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(screenTex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// RGBA8 by default, only ever shown, so 8 bits are enough and it costs a quarter of a float image to write and sample
+	glTextureStorage2D(screenTex, 1, internalFormat(currentFormat), allocatedSize.x, allocatedSize.y);
+}
+
+void RenderTarget::setScreenFormat(ScreenFormat format)
+{
+	if(format == currentFormat)
+		return;
+	currentFormat = format;
+	if(!screenTex)
+		return;
+
+	glDeleteTextures(1, &screenTex);
+	createScreen();
+	logger::Log(logger::LogLevel::DEBUG, std::string("Screen format is now ") + formatName(currentFormat));
+}
+
+void RenderTarget::release()
+{
+	if(screenTex)
+	{
+		glDeleteTextures(1, &screenTex);
+		glDeleteTextures(1, &accumulationTex);
+	}
+	screenTex = accumulationTex = 0;
+}
+
+void RenderTarget::bindImages()
+{
+	glBindImageTexture(0, screenTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, internalFormat(currentFormat));
+	glBindImageTexture(1, accumulationTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	linearColor = true;
+}
+
+void RenderTarget::readScreen(std::vector<float>& pixels) const
+{
+	pixels.resize((size_t)currentRenderSize.x * currentRenderSize.y * 4);
+	GLsizei bytes = (GLsizei)(pixels.size() * sizeof(float));
+	if(currentFormat != ScreenFormat::RGBA8 || !linearColor)
+	{
+		glGetTextureSubImage(screenTex, 0, 0, 0, 0, currentRenderSize.x, currentRenderSize.y, 1, GL_RGBA, GL_FLOAT, bytes, pixels.data());
+		return;
+	}
+
+	glGetTextureSubImage(accumulationTex, 0, 0, 0, 0, currentRenderSize.x, currentRenderSize.y, 1, GL_RGBA, GL_FLOAT, bytes, pixels.data());
+	for(size_t i = 0; i < pixels.size(); i += 4)
+	{
+		pixels[i + 0] = std::sqrt(pixels[i + 0]);
+		pixels[i + 1] = std::sqrt(pixels[i + 1]);
+		pixels[i + 2] = std::sqrt(pixels[i + 2]);
+	}
+}
+
+void RenderTarget::uploadScreen(const std::vector<float>& pixels)
+{
+	glTextureSubImage2D(screenTex, 0, 0, 0, currentRenderSize.x, currentRenderSize.y, GL_RGBA, GL_FLOAT, pixels.data());
+	linearColor = false;
+}
+
+bool RenderTarget::setRenderSize(glm::ivec2 size)
+{
+	size = glm::clamp(size, glm::ivec2(1), allocatedSize);
+	if(size == currentRenderSize)
+		return false;
+	currentRenderSize = size;
+	return true;
+}
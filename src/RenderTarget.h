@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "RenderSettings.h"
+
+
+GLenum internalFormat(ScreenFormat format);
+// the image format qualifier the shaders declare the screen with (SCREEN_FORMAT)
+const char* glslFormat(ScreenFormat format);
+// the name --screen-format takes, rgba8, rgba16f or r11g11b10f
+const char* formatName(ScreenFormat format);
+
+
+// The images the compute shader writes into: screenTex, the display image the screen quad samples
+// (RGBA8 unless setScreenFormat() says otherwise), and the RGBA32F accumulation image with the linear
+// color. Both are allocated at the framebuffer size, but only the lower left renderSize() pixels
+// are rendered, which lets the internal resolution change without reallocating anything.
+class RenderTarget
+{
+public:
+	// (re)allocates both images, immutable textures can't be resized in place
+	void create(glm::ivec2 size);
+	void release();
+
+	// reallocates screenTex if the target was created, its contents are lost then.
+	// The kernels have to be built for the same format, see GPURaytracer::setScreenFormat().
+	void setScreenFormat(ScreenFormat format);
+	ScreenFormat screenFormat() const { return currentFormat; }
+
+	// screenTex at image unit 0, the accumulation image at image unit 1, for a kernel to render both
+	void bindImages();
+
+	// Copies the rendered part into RGBA32F pixels (first row is the bottom one) with the square
+	// root of the accumulated color, like screenTex. An RGBA8 screen is skipped for the accumulation
+	// when that has the frame, so its 8 bit rounding doesn't end up in the pixels.
+	// Waits for the GPU, so it's meant for offline rendering and not for the render loop.
+	void readScreen(std::vector<float>& pixels) const;
+	// writes pixels rendered elsewhere (by the CPU raytracer) with the square root already taken,
+	// renderSize() of them, into screenTex. The accumulation image is left as it is.
+	void uploadScreen(const std::vector<float>& pixels);
+	// whether the accumulation image holds the last frame, false after uploadScreen()
+	bool hasLinearColor() const { return linearColor; }
+
+	// clamped to the allocated size, returns true if the size actually changed
+	bool setRenderSize(glm::ivec2 size);
+
+	GLuint screenTexture() const { return screenTex; }
+	GLuint accumulationTexture() const { return accumulationTex; }
+	glm::ivec2 size() const { return allocatedSize; }
+	glm::ivec2 renderSize() const { return currentRenderSize; }
+
+private:
+	void createScreen();
+
+	GLuint screenTex = 0;
+	GLuint accumulationTex = 0;
+	ScreenFormat currentFormat = ScreenFormat::RGBA8;
+	bool linearColor = false;
+	glm::ivec2 allocatedSize = glm::ivec2(0);
+	glm::ivec2 currentRenderSize = glm::ivec2(0);
+};
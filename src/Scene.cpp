@@ -0,0 +1,619 @@
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "BVHRefitPass.h"
+#include "ObjLoader.h"
+#include "logger.h"
+
+
+// mirrors the header of SceneBuffer in shaders/include/sphere.glsl, and of InstanceBuffer in mesh.glsl
+struct SceneHeader
+{
+	uint32_t sphereCount;
+	uint32_t padding[3];
+};
+
+
+Scene::Scene(std::vector<Sphere> spheres)
+	: spheres(std::move(spheres))
+{
+	commit();
+}
+
+void Scene::releaseBuffers()
+{
+	if(!sceneBuffer)
+		return;
+
+	GLuint buffers[] = {sceneBuffer, bvhNodeBuffer, bvhPrimitiveBuffer, sphereMaterialBuffer, materialBuffer, instanceBuffer, meshNodeBuffer, meshTriangleBuffer, meshVertexBuffer, tlasNodeBuffer, refitOrderBuffer};
+	glDeleteBuffers(11, buffers);
+	sceneBuffer = bvhNodeBuffer = bvhPrimitiveBuffer = sphereMaterialBuffer = materialBuffer = 0;
+	instanceBuffer = meshNodeBuffer = meshTriangleBuffer = meshVertexBuffer = tlasNodeBuffer = refitOrderBuffer = 0;
+	sceneCapacity = bvhNodeCapacity = bvhPrimitiveCapacity = sphereMaterialCapacity = materialCapacity = 0;
+	instanceCapacity = meshNodeCapacity = meshTriangleCapacity = meshVertexCapacity = tlasNodeCapacity = refitOrderCapacity = 0;
+	immutableBuffers = false;
+	uploadedVersion = ~0u;
+}
+
+void Scene::commit()
+{
+	// the spheres have been edited, from here on the buffers are filled from them
+	file.close();
+
+	bvh.build(spheres);
+	soa.build(spheres, bvh);
+	bvh.refitOrder(refitNodeOrder, refitLevels);
+	builtBVHCost = bvhCost = bvh.sahCost();
+	// a background build still running was started from the spheres before this
+	treeGeneration++;
+
+	usedMaterials = 0;
+	geometry.resize(spheres.size());
+	sphereMaterials.resize(spheres.size());
+	materials.clear();
+	// most spheres share their material with others in bigger scenes, every distinct one is stored once
+	std::map<std::tuple<int, float, float, float, float, float>, uint32_t> materialIndices;
+	auto materialIndex = [&](const Material& material)
+	{
+		usedMaterials |= 1u << material.materialType;
+		auto key = std::make_tuple(material.materialType, material.albedo.x, material.albedo.y, material.albedo.z, material.fuzz, material.refractionIndex);
+		auto it = materialIndices.find(key);
+		if(it == materialIndices.end())
+		{
+			it = materialIndices.emplace(key, (uint32_t)materials.size()).first;
+			materials.push_back(material);
+		}
+		return it->second;
+	};
+	for(size_t i = 0; i < spheres.size(); i++)
+	{
+		const Sphere& sphere = spheres[i];
+		geometry[i] = glm::vec4(sphere.center, sphere.radius);
+		sphereMaterials[i] = materialIndex(Material{sphere.albedo, sphere.fuzz, sphere.materialType, sphere.refractionIndex, {0.0f, 0.0f}});
+	}
+
+	meshOffsets.resize(meshes.size());
+	glm::uvec3 offsets(0u);
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		meshOffsets[i] = offsets;
+		offsets += glm::uvec3((uint32_t)meshes[i].nodes.size(), (uint32_t)meshes[i].triangleCount(), (uint32_t)meshes[i].vertices.size());
+	}
+	instanceMaterials.resize(instances.size());
+	for(size_t i = 0; i < instances.size(); i++)
+		instanceMaterials[i] = materialIndex(instances[i].material);
+	buildTopLevel();
+
+	geometryChanged = true;
+	spheresMoved = sphereTreeChanged = false;
+	sceneVersion++;
+}
+
+void Scene::commitInstances()
+{
+	// added or removed instances need their materials looked up
+	if(instances.size() != instanceMaterials.size())
+	{
+		commit();
+		return;
+	}
+
+	// the tlas is small next to the meshes, so it is rebuilt right away once it's too slow
+	tlas.refit(instanceBounds());
+	if(tlas.sahCost() > REBUILD_COST_GROWTH * builtTlasCost)
+	{
+		buildTopLevel();
+		logger::Log(logger::LogLevel::DEBUG, "Rebuilt the top level BVH, refitting had made it too slow");
+	}
+	else
+		updateInstanceData();
+	sceneVersion++;
+}
+
+void Scene::refit()
+{
+	// the spheres of a mapped file have no arrays of their own to refit yet
+	if(file.isOpen() || geometry.size() != spheres.size())
+	{
+		commit();
+		return;
+	}
+
+	collectRebuild();
+	bvh.refit(spheres);
+	soa.update(spheres, bvh);
+	for(size_t i = 0; i < spheres.size(); i++)
+		geometry[i] = glm::vec4(spheres[i].center, spheres[i].radius);
+
+	bvhCost = bvh.sahCost();
+	if(bvhCost > REBUILD_COST_GROWTH * builtBVHCost && !rebuild.valid())
+		startRebuild();
+
+	spheresMoved = true;
+	sceneVersion++;
+}
+
+void Scene::startRebuild()
+{
+	rebuildGeneration = treeGeneration;
+	rebuild = std::async(std::launch::async, [snapshot = spheres]()
+	{
+		BVH rebuilt;
+		rebuilt.build(snapshot);
+		return rebuilt;
+	});
+}
+
+void Scene::collectRebuild()
+{
+	if(!rebuild.valid() || rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	BVH rebuilt = rebuild.get();
+	if(rebuildGeneration != treeGeneration)
+		return;
+
+	// built over where the spheres were when it started, refit() moves it to where they are now
+	bvh = std::move(rebuilt);
+	builtBVHCost = bvh.sahCost();
+	soa.build(spheres, bvh);
+	bvh.refitOrder(refitNodeOrder, refitLevels);
+	sphereTreeChanged = true;
+	logger::Log(logger::LogLevel::DEBUG, "Swapped in the rebuilt sphere BVH, the refitted one had grown to " + std::to_string(bvhCost / std::max(builtBVHCost, 1e-6f)) + " times the cost of the new one");
+}
+
+std::vector<AABB> Scene::instanceBounds() const
+{
+	// the bounds of an instance are those of its mesh's root box, moved into place
+	std::vector<AABB> bounds(instances.size());
+	for(size_t i = 0; i < instances.size(); i++)
+	{
+		const MeshInstance& instance = instances[i];
+		const BVHNode& root = meshes[instance.mesh].nodes[0];
+		for(int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p((corner & 1) ? root.boundsMax.x : root.boundsMin.x, (corner & 2) ? root.boundsMax.y : root.boundsMin.y, (corner & 4) ? root.boundsMax.z : root.boundsMin.z);
+			bounds[i].grow(glm::vec3(instance.transform * glm::vec4(p, 1.0f)));
+		}
+	}
+	return bounds;
+}
+
+void Scene::buildTopLevel()
+{
+	tlas.build(instanceBounds());
+	builtTlasCost = tlas.sahCost();
+	updateInstanceData();
+}
+
+void Scene::updateInstanceData()
+{
+	instanceData.resize(instances.size());
+	for(size_t i = 0; i < instances.size(); i++)
+	{
+		uint32_t instanceIndex = tlas.primIndices[i];
+		const MeshInstance& instance = instances[instanceIndex];
+		glm::mat4 worldToObject = glm::inverse(instance.transform);
+
+		InstanceInfo& info = instanceData[i];
+		for(int row = 0; row < 3; row++)
+			info.worldToObject[row] = glm::vec4(worldToObject[0][row], worldToObject[1][row], worldToObject[2][row], worldToObject[3][row]);
+		info.nodeOffset = meshOffsets[instance.mesh].x;
+		info.triangleOffset = meshOffsets[instance.mesh].y;
+		info.vertexOffset = meshOffsets[instance.mesh].z;
+		info.materialIndex = instanceMaterials[instanceIndex];
+	}
+}
+
+bool Scene::load(const std::string& path)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if(std::filesystem::path(path).extension() != ".rtscene")
+	{
+		std::vector<Sphere> loaded;
+		std::vector<SceneInstanceEntry> instanceEntries;
+		if(!readSceneText(path, loaded, instanceEntries))
+			return false;
+
+		// every OBJ file is loaded once, however many instances it has
+		std::vector<Mesh> loadedMeshes;
+		std::vector<MeshInstance> loadedInstances;
+		std::map<std::string, uint32_t> meshIndices;
+		for(const SceneInstanceEntry& entry : instanceEntries)
+		{
+			auto it = meshIndices.find(entry.path);
+			if(it == meshIndices.end())
+			{
+				loadedMeshes.emplace_back();
+				if(!loadObj(entry.path, loadedMeshes.back()))
+					return false;
+				it = meshIndices.emplace(entry.path, (uint32_t)loadedMeshes.size() - 1).first;
+			}
+			loadedInstances.push_back(MeshInstance{it->second, entry.transform, entry.material});
+		}
+
+		spheres = std::move(loaded);
+		meshes = std::move(loadedMeshes);
+		instances = std::move(loadedInstances);
+		commit();
+		logger::Log(logger::LogLevel::INFO, "Loaded " + std::to_string(spheres.size()) + " spheres and " + std::to_string(instances.size()) + " instances of " + std::to_string(meshes.size()) + " meshes from " + path);
+		return true;
+	}
+
+	SceneFile loaded;
+	if(!loaded.open(path))
+		return false;
+	GPUArrays arrays;
+	std::string problem;
+	if(!fileArrays(loaded, arrays, problem))
+	{
+		logger::Log(logger::LogLevel::ERROR, "Invalid scene file " + path + ": " + problem);
+		return false;
+	}
+
+	// the CPU backend and the editor still need their own copies, which are plain copies of the pages
+	spheres.resize(arrays.sphereCount);
+	for(size_t i = 0; i < arrays.sphereCount; i++)
+	{
+		const Material& material = arrays.materials[arrays.sphereMaterials[i]];
+		spheres[i] = Sphere{glm::vec3(arrays.geometry[i]), arrays.geometry[i].w, material.albedo, material.fuzz, material.materialType, material.refractionIndex};
+	}
+	meshes.clear();
+	instances.clear();
+	meshOffsets.clear();
+	instanceMaterials.clear();
+	buildTopLevel();
+	bvh.nodes.assign(arrays.nodes, arrays.nodes + arrays.nodeCount);
+	bvh.primIndices.assign(arrays.primIndices, arrays.primIndices + arrays.sphereCount);
+	soa.build(spheres, bvh);
+	builtBVHCost = bvhCost = bvh.sahCost();
+	treeGeneration++;
+
+	usedMaterials = 0;
+	for(size_t i = 0; i < arrays.materialCount; i++)
+		usedMaterials |= 1u << arrays.materials[i].materialType;
+
+	file = std::move(loaded);
+	std::vector<glm::vec4>().swap(geometry);
+	std::vector<uint32_t>().swap(sphereMaterials);
+	std::vector<Material>().swap(materials);
+	geometryChanged = true;
+	spheresMoved = sphereTreeChanged = false;
+	sceneVersion++;
+
+	float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	logger::Log(logger::LogLevel::INFO, "Loaded " + std::to_string(spheres.size()) + " spheres from " + path + " in " + std::to_string(elapsed) + " ms");
+	return true;
+}
+
+bool Scene::save(const std::string& path) const
+{
+	if(!instances.empty())
+		logger::Log(logger::LogLevel::WARNING, "Scene files only hold spheres, " + std::to_string(instances.size()) + " mesh instances are left out of " + path);
+
+	GPUArrays arrays = gpuArrays();
+	return writeSceneFile(path, {
+		{SceneSection::GEOMETRY, sizeof(glm::vec4), arrays.geometry, arrays.sphereCount},
+		{SceneSection::SPHERE_MATERIALS, sizeof(uint32_t), arrays.sphereMaterials, arrays.sphereCount},
+		{SceneSection::MATERIALS, sizeof(Material), arrays.materials, arrays.materialCount},
+		{SceneSection::BVH_NODES, sizeof(BVHNode), arrays.nodes, arrays.nodeCount},
+		{SceneSection::BVH_PRIMITIVES, sizeof(uint32_t), arrays.primIndices, arrays.sphereCount},
+	});
+}
+
+Scene::GPUArrays Scene::gpuArrays() const
+{
+	GPUArrays arrays = {geometry.data(), sphereMaterials.data(), geometry.size(), materials.data(), materials.size(), bvh.nodes.data(), bvh.nodes.size(), bvh.primIndices.data()};
+	std::string problem;
+	if(file.isOpen())
+		fileArrays(file, arrays, problem);
+	return arrays;
+}
+
+bool Scene::fileArrays(const SceneFile& file, GPUArrays& arrays, std::string& problem)
+{
+	size_t materialIndexCount, primIndexCount;
+	arrays.geometry = file.section<glm::vec4>(SceneSection::GEOMETRY, arrays.sphereCount);
+	arrays.sphereMaterials = file.section<uint32_t>(SceneSection::SPHERE_MATERIALS, materialIndexCount);
+	arrays.materials = file.section<Material>(SceneSection::MATERIALS, arrays.materialCount);
+	arrays.nodes = file.section<BVHNode>(SceneSection::BVH_NODES, arrays.nodeCount);
+	arrays.primIndices = file.section<uint32_t>(SceneSection::BVH_PRIMITIVES, primIndexCount);
+
+	if(!arrays.geometry || !arrays.sphereMaterials || !arrays.materials || !arrays.nodes || !arrays.primIndices)
+		problem = "a section is missing";
+	else if(materialIndexCount != arrays.sphereCount || primIndexCount != arrays.sphereCount)
+		problem = "the sections don't have the same number of spheres";
+	else if(arrays.nodeCount == 0)
+		problem = "the BVH has no root";
+	if(!problem.empty())
+		return false;
+
+	// everything the GPU indexes with has to be in bounds, it would read past the buffers otherwise
+	for(size_t i = 0; i < arrays.sphereCount; i++)
+		if(arrays.sphereMaterials[i] >= arrays.materialCount || arrays.primIndices[i] >= arrays.sphereCount)
+		{
+			problem = "sphere " + std::to_string(i) + " has an index out of range";
+			return false;
+		}
+	for(size_t i = 0; i < arrays.materialCount; i++)
+		if(arrays.materials[i].materialType < LAMBERT || arrays.materials[i].materialType > DIELECTRIC)
+		{
+			problem = "material " + std::to_string(i) + " has an unknown type";
+			return false;
+		}
+	// the shaders don't look at the BVH of an empty scene, its root is an inner node without children
+	if(arrays.sphereCount == 0)
+		return true;
+	// the traversal stacks hold a node per level, a deeper tree would overflow them
+	std::vector<int> depths(arrays.nodeCount, 0);
+	for(size_t i = 0; i < arrays.nodeCount; i++)
+	{
+		const BVHNode& node = arrays.nodes[i];
+		// children always come after their parent, so the tree can't loop
+		// and a node's depth is known by the time the loop gets to it
+		bool valid = node.isLeaf() ? (uint64_t)node.leftFirst + node.primCount <= arrays.sphereCount
+			: node.leftFirst > i && (uint64_t)node.leftFirst + 1 < arrays.nodeCount;
+		if(!valid)
+		{
+			problem = "BVH node " + std::to_string(i) + " is out of range";
+			return false;
+		}
+		if(depths[i] > BVH::MAX_DEPTH)
+		{
+			problem = "the BVH is deeper than " + std::to_string(BVH::MAX_DEPTH) + " levels";
+			return false;
+		}
+		if(!node.isLeaf())
+			for(uint32_t child = node.leftFirst; child <= node.leftFirst + 1; child++)
+				depths[child] = std::max(depths[child], depths[i] + 1);
+	}
+	return true;
+}
+
+void Scene::upload(const BVHRefitPass* refitPass)
+{
+	if(uploadedVersion == sceneVersion)
+		return;
+
+	// only spheres or instances moved, the rest of the buffers is still what it was
+	if(!geometryChanged && sceneBuffer && !immutableBuffers)
+	{
+		if(spheresMoved)
+			uploadSpheres(refitPass);
+		uploadInstances();
+		uploadedVersion = sceneVersion;
+		return;
+	}
+
+	// immutable storage can't be resized, so the buffers of a mapped file are made anew every time,
+	// and replaced by the usual ones once the scene is edited
+	if(file.isOpen() || immutableBuffers)
+		releaseBuffers();
+
+	if(!sceneBuffer)
+	{
+		glCreateBuffers(1, &sceneBuffer);
+		glCreateBuffers(1, &bvhNodeBuffer);
+		glCreateBuffers(1, &bvhPrimitiveBuffer);
+		glCreateBuffers(1, &sphereMaterialBuffer);
+		glCreateBuffers(1, &materialBuffer);
+		glCreateBuffers(1, &instanceBuffer);
+		glCreateBuffers(1, &meshNodeBuffer);
+		glCreateBuffers(1, &meshTriangleBuffer);
+		glCreateBuffers(1, &meshVertexBuffer);
+		glCreateBuffers(1, &tlasNodeBuffer);
+		glCreateBuffers(1, &refitOrderBuffer);
+	}
+
+	GPUArrays arrays = gpuArrays();
+	SceneHeader header = {(uint32_t)arrays.sphereCount, {0, 0, 0}};
+	uploadBuffer(sceneBuffer, sceneCapacity, sizeof(header), &header, {{arrays.geometry, (GLsizeiptr)(arrays.sphereCount * sizeof(glm::vec4))}});
+	uploadBuffer(bvhNodeBuffer, bvhNodeCapacity, 0, nullptr, {{arrays.nodes, (GLsizeiptr)(arrays.nodeCount * sizeof(BVHNode))}});
+	uploadBuffer(bvhPrimitiveBuffer, bvhPrimitiveCapacity, 0, nullptr, {{arrays.primIndices, (GLsizeiptr)(arrays.sphereCount * sizeof(uint32_t))}});
+	uploadBuffer(sphereMaterialBuffer, sphereMaterialCapacity, 0, nullptr, {{arrays.sphereMaterials, (GLsizeiptr)(arrays.sphereCount * sizeof(uint32_t))}});
+	uploadBuffer(materialBuffer, materialCapacity, 0, nullptr, {{arrays.materials, (GLsizeiptr)(arrays.materialCount * sizeof(Material))}});
+	uploadBuffer(refitOrderBuffer, refitOrderCapacity, 0, nullptr, {{refitNodeOrder.data(), (GLsizeiptr)(refitNodeOrder.size() * sizeof(uint32_t))}});
+	uploadMeshes();
+	uploadInstances();
+	immutableBuffers = file.isOpen();
+	geometryChanged = spheresMoved = sphereTreeChanged = false;
+
+	uploadedVersion = sceneVersion;
+	logger::Log(logger::LogLevel::DEBUG, "Uploaded scene with " + std::to_string(arrays.sphereCount) + " spheres, " + std::to_string(instances.size()) + " instances of " + std::to_string(meshes.size()) + " meshes and " + std::to_string(arrays.materialCount) + " materials");
+}
+
+void Scene::bind() const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sceneBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, bvhNodeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, bvhPrimitiveBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, sphereMaterialBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, materialBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, meshNodeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, meshTriangleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, meshVertexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, tlasNodeBuffer);
+}
+
+// the arrays of all meshes one after the other, at the offsets commit() put into meshOffsets
+void Scene::uploadMeshes()
+{
+	std::vector<BufferPiece> nodes, triangles, vertices;
+	for(const Mesh& mesh : meshes)
+	{
+		nodes.push_back({mesh.nodes.data(), (GLsizeiptr)(mesh.nodes.size() * sizeof(BVHNode))});
+		triangles.push_back({mesh.indices.data(), (GLsizeiptr)(mesh.indices.size() * sizeof(uint32_t))});
+		vertices.push_back({mesh.vertices.data(), (GLsizeiptr)(mesh.vertices.size() * sizeof(MeshVertex))});
+	}
+
+	uploadBuffer(meshNodeBuffer, meshNodeCapacity, 0, nullptr, nodes);
+	uploadBuffer(meshTriangleBuffer, meshTriangleCapacity, 0, nullptr, triangles);
+	uploadBuffer(meshVertexBuffer, meshVertexCapacity, 0, nullptr, vertices);
+}
+
+void Scene::uploadSpheres(const BVHRefitPass* refitPass)
+{
+	SceneHeader header = {(uint32_t)geometry.size(), {0, 0, 0}};
+	uploadBuffer(sceneBuffer, sceneCapacity, sizeof(header), &header, {{geometry.data(), (GLsizeiptr)(geometry.size() * sizeof(glm::vec4))}});
+	if(sphereTreeChanged)
+	{
+		uploadBuffer(bvhPrimitiveBuffer, bvhPrimitiveCapacity, 0, nullptr, {{bvh.primIndices.data(), (GLsizeiptr)(bvh.primIndices.size() * sizeof(uint32_t))}});
+		uploadBuffer(refitOrderBuffer, refitOrderCapacity, 0, nullptr, {{refitNodeOrder.data(), (GLsizeiptr)(refitNodeOrder.size() * sizeof(uint32_t))}});
+	}
+
+	// a tree that was swapped for another one has other nodes, not just other bounds
+	if(refitPass && !sphereTreeChanged)
+		refitPass->run(sceneBuffer, bvhNodeBuffer, bvhPrimitiveBuffer, refitOrderBuffer, refitLevels);
+	else
+		uploadBuffer(bvhNodeBuffer, bvhNodeCapacity, 0, nullptr, {{bvh.nodes.data(), (GLsizeiptr)(bvh.nodes.size() * sizeof(BVHNode))}});
+	spheresMoved = sphereTreeChanged = false;
+}
+
+void Scene::uploadInstances()
+{
+	SceneHeader header = {(uint32_t)instanceData.size(), {0, 0, 0}};
+	uploadBuffer(instanceBuffer, instanceCapacity, sizeof(header), &header, {{instanceData.data(), (GLsizeiptr)(instanceData.size() * sizeof(InstanceInfo))}});
+	uploadBuffer(tlasNodeBuffer, tlasNodeCapacity, 0, nullptr, {{tlas.nodes.data(), (GLsizeiptr)(tlas.nodes.size() * sizeof(BVHNode))}});
+}
+
+void Scene::uploadBuffer(GLuint buffer, GLsizeiptr& capacity, GLsizeiptr headerSize, const void* header, const std::vector<BufferPiece>& pieces)
+{
+	GLsizeiptr required = headerSize;
+	for(const BufferPiece& piece : pieces)
+		required += piece.size;
+	if(file.isOpen())
+	{
+		// Storage of the exact size, mapped once to copy the header and the file's pages into. That
+		// is the only copy there is, glNamedBufferSubData would stage the data in the driver first.
+		capacity = std::max<GLsizeiptr>(required, 16);
+		glNamedBufferStorage(buffer, capacity, nullptr, GL_MAP_WRITE_BIT);
+		uint8_t* mapped = (uint8_t*)glMapNamedBufferRange(buffer, 0, capacity, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if(headerSize > 0)
+			std::memcpy(mapped, header, headerSize);
+		GLsizeiptr offset = headerSize;
+		for(const BufferPiece& piece : pieces)
+		{
+			if(piece.size > 0)
+				std::memcpy(mapped + offset, piece.data, piece.size);
+			offset += piece.size;
+		}
+		glUnmapNamedBuffer(buffer);
+		return;
+	}
+
+	if(required > capacity || capacity == 0)
+	{
+		// grow by half again so adding a few spheres at a time doesn't reallocate every time
+		capacity = std::max<GLsizeiptr>(required + required / 2, 16);
+		glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	if(headerSize > 0)
+		glNamedBufferSubData(buffer, 0, headerSize, header);
+	GLsizeiptr offset = headerSize;
+	for(const BufferPiece& piece : pieces)
+	{
+		if(piece.size > 0)
+			glNamedBufferSubData(buffer, offset, piece.size, piece.data);
+		offset += piece.size;
+	}
+}
+
+
+std::vector<Sphere> defaultSceneList()
+{
+	return std::vector<Sphere>{
+		{glm::vec3(0.000000f, -1000.000000f, 0.000000f), 1000.000000f, glm::vec3(0.500000f, 0.500000f, 0.500000f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.995381f, 0.200000f, -7.478668f), 0.200000f, glm::vec3(0.380012f, 0.506085f, 0.762437f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.696819f, 0.200000f, -5.468978f), 0.200000f, glm::vec3(0.596282f, 0.140784f, 0.017972f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.824804f, 0.200000f, -3.120637f), 0.200000f, glm::vec3(0.288507f, 0.465652f, 0.665070f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.132909f, 0.200000f, -1.701323f), 0.200000f, glm::vec3(0.101047f, 0.293493f, 0.813446f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.569523f, 0.200000f, 0.494554f), 0.200000f, glm::vec3(0.365924f, 0.221622f, 0.058332f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.730332f, 0.200000f, 2.358976f), 0.200000f, glm::vec3(0.051231f, 0.430547f, 0.454086f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.892865f, 0.200000f, 4.753728f), 0.200000f, glm::vec3(0.826684f, 0.820511f, 0.908836f), 0.389611f, 1, 1.000000f},
+		{glm::vec3(-7.656691f, 0.200000f, 6.888913f), 0.200000f, glm::vec3(0.346542f, 0.225385f, 0.180132f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-7.217835f, 0.200000f, 8.203466f), 0.200000f, glm::vec3(0.600463f, 0.582386f, 0.608277f), 0.427369f, 1, 1.000000f},
+		{glm::vec3(-5.115232f, 0.200000f, -7.980404f), 0.200000f, glm::vec3(0.256969f, 0.138639f, 0.080293f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.323222f, 0.200000f, -5.113037f), 0.200000f, glm::vec3(0.193093f, 0.510542f, 0.613362f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.410681f, 0.200000f, -3.527741f), 0.200000f, glm::vec3(0.352200f, 0.191551f, 0.115972f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.460670f, 0.200000f, -1.166543f), 0.200000f, glm::vec3(0.029486f, 0.249874f, 0.077989f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.457659f, 0.200000f, 0.363870f), 0.200000f, glm::vec3(0.395713f, 0.762043f, 0.108515f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.798715f, 0.200000f, 2.161684f), 0.200000f, glm::vec3(0.000000f, 0.000000f, 0.000000f), 1.000000f, 2, 1.500000f},
+		{glm::vec3(-5.116586f, 0.200000f, 4.470188f), 0.200000f, glm::vec3(0.059444f, 0.404603f, 0.171767f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.273591f, 0.200000f, 6.795187f), 0.200000f, glm::vec3(0.499454f, 0.131330f, 0.158348f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-5.120286f, 0.200000f, 8.731398f), 0.200000f, glm::vec3(0.267365f, 0.136024f, 0.300483f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.601565f, 0.200000f, -7.895600f), 0.200000f, glm::vec3(0.027752f, 0.155209f, 0.330428f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.735860f, 0.200000f, -5.163056f), 0.200000f, glm::vec3(0.576768f, 0.884712f, 0.993335f), 0.359385f, 1, 1.000000f},
+		{glm::vec3(-3.481116f, 0.200000f, -3.794556f), 0.200000f, glm::vec3(0.405104f, 0.066436f, 0.009339f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.866858f, 0.200000f, -1.465965f), 0.200000f, glm::vec3(0.027570f, 0.021652f, 0.252798f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.168870f, 0.200000f, 0.553099f), 0.200000f, glm::vec3(0.421992f, 0.107577f, 0.177504f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.428552f, 0.200000f, 2.627547f), 0.200000f, glm::vec3(0.974029f, 0.653443f, 0.571877f), 0.312780f, 1, 1.000000f},
+		{glm::vec3(-3.771736f, 0.200000f, 4.324785f), 0.200000f, glm::vec3(0.685957f, 0.000043f, 0.181270f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.768522f, 0.200000f, 6.384588f), 0.200000f, glm::vec3(0.025972f, 0.082246f, 0.138765f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-3.286992f, 0.200000f, 8.441148f), 0.200000f, glm::vec3(0.186577f, 0.560376f, 0.367045f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.552127f, 0.200000f, -7.728200f), 0.200000f, glm::vec3(0.202998f, 0.002459f, 0.015350f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.360796f, 0.200000f, -5.346098f), 0.200000f, glm::vec3(0.690820f, 0.028470f, 0.179907f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.287209f, 0.200000f, -3.735321f), 0.200000f, glm::vec3(0.345974f, 0.672353f, 0.450180f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.344859f, 0.200000f, -1.726654f), 0.200000f, glm::vec3(0.209209f, 0.431116f, 0.164732f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.974774f, 0.200000f, 0.183260f), 0.200000f, glm::vec3(0.006736f, 0.675637f, 0.622067f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.542872f, 0.200000f, 2.067868f), 0.200000f, glm::vec3(0.192247f, 0.016661f, 0.010109f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.743856f, 0.200000f, 4.752810f), 0.200000f, glm::vec3(0.295270f, 0.108339f, 0.276513f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.955621f, 0.200000f, 6.493702f), 0.200000f, glm::vec3(0.270527f, 0.270494f, 0.202029f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(-1.350449f, 0.200000f, 8.068503f), 0.200000f, glm::vec3(0.646942f, 0.501660f, 0.573693f), 0.346551f, 1, 1.000000f},
+		{glm::vec3(0.706123f, 0.200000f, -7.116040f), 0.200000f, glm::vec3(0.027695f, 0.029917f, 0.235781f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.897766f, 0.200000f, -5.938681f), 0.200000f, glm::vec3(0.114934f, 0.046258f, 0.039647f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.744113f, 0.200000f, -3.402960f), 0.200000f, glm::vec3(0.513631f, 0.335578f, 0.204787f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.867750f, 0.200000f, -1.311908f), 0.200000f, glm::vec3(0.400246f, 0.000956f, 0.040513f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.082480f, 0.200000f, 0.838206f), 0.200000f, glm::vec3(0.594141f, 0.215068f, 0.025718f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.649692f, 0.200000f, 2.525103f), 0.200000f, glm::vec3(0.602157f, 0.797249f, 0.614694f), 0.341860f, 1, 1.000000f},
+		{glm::vec3(0.378574f, 0.200000f, 4.055579f), 0.200000f, glm::vec3(0.005086f, 0.003349f, 0.064403f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.425844f, 0.200000f, 6.098526f), 0.200000f, glm::vec3(0.266812f, 0.016602f, 0.000853f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.261365f, 0.200000f, 8.661150f), 0.200000f, glm::vec3(0.150201f, 0.007353f, 0.152506f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.814218f, 0.200000f, -7.751227f), 0.200000f, glm::vec3(0.570094f, 0.610319f, 0.584192f), 0.018611f, 1, 1.000000f},
+		{glm::vec3(2.050073f, 0.200000f, -5.731364f), 0.200000f, glm::vec3(0.109886f, 0.029498f, 0.303265f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.020130f, 0.200000f, -3.472627f), 0.200000f, glm::vec3(0.216908f, 0.216448f, 0.221775f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.884277f, 0.200000f, -1.232662f), 0.200000f, glm::vec3(0.483428f, 0.027275f, 0.113898f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.644454f, 0.200000f, 0.596324f), 0.200000f, glm::vec3(0.005872f, 0.860718f, 0.561933f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.194283f, 0.200000f, 2.880603f), 0.200000f, glm::vec3(0.452710f, 0.824152f, 0.045179f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.281000f, 0.200000f, 4.094307f), 0.200000f, glm::vec3(0.002091f, 0.145849f, 0.032535f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.080841f, 0.200000f, 6.716384f), 0.200000f, glm::vec3(0.468539f, 0.032772f, 0.018071f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(2.287131f, 0.200000f, 8.583242f), 0.200000f, glm::vec3(0.000000f, 0.000000f, 0.000000f), 1.000000f, 2, 1.500000f},
+		{glm::vec3(4.329136f, 0.200000f, -7.497218f), 0.200000f, glm::vec3(0.030865f, 0.071452f, 0.016051f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.502115f, 0.200000f, -5.941060f), 0.200000f, glm::vec3(0.000000f, 0.000000f, 0.000000f), 1.000000f, 2, 1.500000f},
+		{glm::vec3(4.750631f, 0.200000f, -3.836759f), 0.200000f, glm::vec3(0.702578f, 0.084798f, 0.141374f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.082084f, 0.200000f, -1.180746f), 0.200000f, glm::vec3(0.043052f, 0.793077f, 0.018707f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.429173f, 0.200000f, 2.069721f), 0.200000f, glm::vec3(0.179009f, 0.147750f, 0.617371f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.277152f, 0.200000f, 4.297482f), 0.200000f, glm::vec3(0.422693f, 0.011222f, 0.211945f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.012743f, 0.200000f, 6.225072f), 0.200000f, glm::vec3(0.986275f, 0.073358f, 0.133628f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.047066f, 0.200000f, 8.419360f), 0.200000f, glm::vec3(0.878749f, 0.677170f, 0.684995f), 0.243932f, 1, 1.000000f},
+		{glm::vec3(6.441846f, 0.200000f, -7.700798f), 0.200000f, glm::vec3(0.309255f, 0.342524f, 0.489512f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.047810f, 0.200000f, -5.519369f), 0.200000f, glm::vec3(0.532361f, 0.008200f, 0.077522f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.779211f, 0.200000f, -3.740542f), 0.200000f, glm::vec3(0.161234f, 0.539314f, 0.016667f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.430776f, 0.200000f, -1.332107f), 0.200000f, glm::vec3(0.641951f, 0.661402f, 0.326114f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.476387f, 0.200000f, 0.329973f), 0.200000f, glm::vec3(0.033000f, 0.648388f, 0.166911f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.568686f, 0.200000f, 2.116949f), 0.200000f, glm::vec3(0.590952f, 0.072292f, 0.125672f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.371189f, 0.200000f, 4.609841f), 0.200000f, glm::vec3(0.870345f, 0.753830f, 0.933118f), 0.233489f, 1, 1.000000f},
+		{glm::vec3(6.011877f, 0.200000f, 6.569579f), 0.200000f, glm::vec3(0.044868f, 0.651697f, 0.086779f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(6.096087f, 0.200000f, 8.892333f), 0.200000f, glm::vec3(0.588587f, 0.078723f, 0.044928f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.185763f, 0.200000f, -7.191109f), 0.200000f, glm::vec3(0.989702f, 0.886784f, 0.540759f), 0.104229f, 1, 1.000000f},
+		{glm::vec3(8.411960f, 0.200000f, -5.285309f), 0.200000f, glm::vec3(0.139604f, 0.022029f, 0.461688f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.047109f, 0.200000f, -3.427552f), 0.200000f, glm::vec3(0.815002f, 0.631228f, 0.806757f), 0.150782f, 1, 1.000000f},
+		{glm::vec3(8.119639f, 0.200000f, -1.652587f), 0.200000f, glm::vec3(0.177852f, 0.429797f, 0.042251f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.818120f, 0.200000f, 0.401292f), 0.200000f, glm::vec3(0.065416f, 0.087694f, 0.040518f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.754155f, 0.200000f, 2.152549f), 0.200000f, glm::vec3(0.230659f, 0.035665f, 0.435895f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.595298f, 0.200000f, 4.802001f), 0.200000f, glm::vec3(0.188493f, 0.184933f, 0.040215f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.036216f, 0.200000f, 6.739752f), 0.200000f, glm::vec3(0.023192f, 0.364636f, 0.464844f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(8.256561f, 0.200000f, 8.129115f), 0.200000f, glm::vec3(0.002612f, 0.598319f, 0.435378f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(0.000000f, 1.000000f, 0.000000f), 1.000000f, glm::vec3(0.000000f, 0.000000f, 0.000000f), 1.000000f, 2, 1.500000f},
+		{glm::vec3(-4.000000f, 1.000000f, 0.000000f), 1.000000f, glm::vec3(0.400000f, 0.200000f, 0.100000f), 1.000000f, 0, 1.000000f},
+		{glm::vec3(4.000000f, 1.000000f, 0.000000f), 1.000000f, glm::vec3(0.700000f, 0.600000f, 0.500000f), 0.000000f, 1, 1.000000f},
+	};
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Mesh.h"
+#include "SceneFile.h"
+#include "Sphere.h"
+#include "SphereSoA.h"
+
+class BVHRefitPass;
+
+
+// The spheres and mesh instances that make up the scene and the BVHs over them, plus the GPU copies of
+// all of it. The compute shader reads the sphere centers and radii from binding 0, the BVH over them
+// from bindings 1 and 2, and the material index of every sphere and the material table from bindings
+// 10 and 11.
+//
+// Meshes are put into the scene by instances (see Mesh.h), in two levels: every mesh has its own BVH
+// (the bottom level), built once however many instances it has, and a BVH over the instances (the top
+// level, tlas) is built on top, which is all that has to be redone when instances move. The meshes
+// share three buffers, the BVH nodes (13), the triangles (14) and the vertices (15), the instances
+// are in binding 12 and the top level BVH in binding 16.
+//
+// Moving things doesn't have to rebuild their BVH, refit() and commitInstances() only fit the bounds
+// of the nodes to where the spheres and instances are now. Once that has made a tree too much slower
+// to traverse (REBUILD_COST_GROWTH), it is built again, the sphere BVH on a thread of its own.
+class Scene
+{
+public:
+	Scene() = default;
+	explicit Scene(std::vector<Sphere> spheres);
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	// call after editing spheres, meshes or instances, rebuilds the sphere and the top level BVH and flags
+	// the GPU buffers as out of date. The BVH of a mesh is built when it's loaded (see Mesh::build()).
+	void commit();
+	// Call after moving instances (editing their transforms), only refits the top level BVH, or
+	// rebuilds it if the refit has made it too slow, and only the instance buffers are uploaded again.
+	// Anything else needs commit().
+	void commitInstances();
+	// Call after moving spheres or changing their radius, refits the sphere BVH. Starts a build in
+	// the background when the refitted tree has become too slow, and the next refit() after it has
+	// finished swaps it in. Adding or removing spheres, or changing their materials, needs commit().
+	void refit();
+
+	// Replaces the scene with an .rtscene file (see SceneFile.h) or a text description (readSceneText()).
+	// An .rtscene file stays mapped until the next commit() or load(), the GPU buffers are filled
+	// straight from its pages and its BVH is used as it is. The meshes of a text scene are loaded from
+	// their OBJ files. Returns false and keeps the current scene if path can't be loaded.
+	bool load(const std::string& path);
+	// writes the scene as an .rtscene file, which only holds spheres, the mesh instances are left out
+	bool save(const std::string& path) const;
+
+	// the SAH cost a refit can grow a BVH to, relative to the cost it had when it was built
+	static constexpr float REBUILD_COST_GROWTH = 1.5f;
+	// the SAH cost of the sphere BVH relative to when it was built, 1 until it's refitted
+	float bvhCostGrowth() const { return builtBVHCost > 0.0f ? bvhCost / builtBVHCost : 1.0f; }
+	bool rebuildingBVH() const { return rebuild.valid(); }
+
+	// Creates the buffers on first use, afterwards only rewrites their contents with glNamedBufferSubData
+	// (the storage just grows when needed). A mapped .rtscene is copied from the file's pages into newly
+	// mapped buffers instead. Needs a current GL context, does nothing if nothing changed.
+	// With refitPass, the BVH nodes of spheres that only moved are refitted on the GPU instead of
+	// uploading the ones refit() computed, only the spheres themselves are uploaded.
+	void upload(const BVHRefitPass* refitPass = nullptr);
+	void bind() const;
+	// deletes the GPU buffers, has to happen while the GL context is still alive
+	void releaseBuffers();
+
+	// bumped by every commit(), so users can tell when the scene has changed
+	unsigned int version() const { return sceneVersion; }
+	// bit (1 << materialType) of every material type some sphere or instance has, as of the last commit()
+	unsigned int materialMask() const { return usedMaterials; }
+
+	std::vector<Sphere> spheres;
+	std::vector<Mesh> meshes;
+	std::vector<MeshInstance> instances;
+	BVH bvh;
+	// the spheres again in BVH order, for the SIMD paths of the CPU backend
+	SphereSoA soa;
+	// over the instances, leaves reference them through tlas.primIndices
+	BVH tlas;
+
+	// the instances in the order of the tlas leaves, the way the GPU gets them
+	const std::vector<InstanceInfo>& instanceInfos() const { return instanceData; }
+
+private:
+	// the arrays the GPU buffers are filled from, out of the mapped file if there is one
+	struct GPUArrays
+	{
+		const glm::vec4* geometry;
+		const uint32_t* sphereMaterials;
+		size_t sphereCount;
+		const Material* materials;
+		size_t materialCount;
+		const BVHNode* nodes;
+		size_t nodeCount;
+		const uint32_t* primIndices;
+	};
+	GPUArrays gpuArrays() const;
+	// the arrays of file, false with the reason in problem if they don't make a valid scene
+	static bool fileArrays(const SceneFile& file, GPUArrays& arrays, std::string& problem);
+
+	// a run of bytes that goes into a buffer after the ones before it
+	struct BufferPiece
+	{
+		const void* data;
+		GLsizeiptr size;
+	};
+	void uploadBuffer(GLuint buffer, GLsizeiptr& capacity, GLsizeiptr headerSize, const void* header, const std::vector<BufferPiece>& pieces);
+	void uploadMeshes();
+	void uploadInstances();
+	// the spheres after refit(), and the BVH over them
+	void uploadSpheres(const BVHRefitPass* refitPass);
+	// the bounds of the instances, the tlas over them and instanceData
+	void buildTopLevel();
+	// the world space bounds of every instance
+	std::vector<AABB> instanceBounds() const;
+	void updateInstanceData();
+	// swaps in the background build if it's done, and starts one if the BVH has become too slow
+	void collectRebuild();
+	void startRebuild();
+
+	// what the GPU gets of spheres, built by commit(): center and radius, and the materials
+	// (each distinct one once) with an index into them for every sphere
+	std::vector<glm::vec4> geometry;
+	std::vector<uint32_t> sphereMaterials;
+	std::vector<Material> materials;
+	// where the nodes, triangles and vertices of every mesh start in the mesh buffers, and the material
+	// index of every instance, as of the last commit()
+	std::vector<glm::uvec3> meshOffsets;
+	std::vector<uint32_t> instanceMaterials;
+	std::vector<InstanceInfo> instanceData;
+	// something other than the instances changed since the last upload(), so every buffer has to be filled
+	bool geometryChanged = true;
+	// spheres were refitted, or their BVH was swapped for a background build, since the last upload()
+	bool spheresMoved = false;
+	bool sphereTreeChanged = false;
+
+	// SAH costs of the sphere BVH when it was built and as of the last refit, and of the tlas when built
+	float builtBVHCost = 0.0f;
+	float bvhCost = 0.0f;
+	float builtTlasCost = 0.0f;
+	// the sphere BVH nodes by height, for refitting them on the GPU (see BVH::refitOrder())
+	std::vector<uint32_t> refitNodeOrder;
+	std::vector<uint32_t> refitLevels;
+	// a build over the spheres as they were when it started, dropped if commit() builds a tree of its own
+	std::future<BVH> rebuild;
+	unsigned int rebuildGeneration = 0;
+	unsigned int treeGeneration = 0;
+	// the last load()ed .rtscene, closed by commit(), the arrays above are empty while it's open
+	SceneFile file;
+	// the buffers of a mapped file are created at their exact size and can't be resized
+	bool immutableBuffers = false;
+
+	GLuint sceneBuffer = 0;
+	GLuint bvhNodeBuffer = 0;
+	GLuint bvhPrimitiveBuffer = 0;
+	GLuint sphereMaterialBuffer = 0;
+	GLuint materialBuffer = 0;
+	GLuint instanceBuffer = 0;
+	GLuint meshNodeBuffer = 0;
+	GLuint meshTriangleBuffer = 0;
+	GLuint meshVertexBuffer = 0;
+	GLuint tlasNodeBuffer = 0;
+	GLuint refitOrderBuffer = 0;
+	GLsizeiptr sceneCapacity = 0;
+	GLsizeiptr bvhNodeCapacity = 0;
+	GLsizeiptr bvhPrimitiveCapacity = 0;
+	GLsizeiptr sphereMaterialCapacity = 0;
+	GLsizeiptr materialCapacity = 0;
+	GLsizeiptr instanceCapacity = 0;
+	GLsizeiptr meshNodeCapacity = 0;
+	GLsizeiptr meshTriangleCapacity = 0;
+	GLsizeiptr meshVertexCapacity = 0;
+	GLsizeiptr tlasNodeCapacity = 0;
+	GLsizeiptr refitOrderCapacity = 0;
+
+	unsigned int sceneVersion = 0;
+	unsigned int usedMaterials = 0;
+	unsigned int uploadedVersion = ~0u;
+};
+
+
+// the 84 sphere 'scene' that used to be hard coded into ComputeShader.comp
+std::vector<Sphere> defaultSceneList();
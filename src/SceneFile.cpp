@@ -0,0 +1,439 @@
+#include "SceneFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+
+static const char SCENE_FILE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+
+// The rounds of xxHash64 on four independent lanes, so checking a file runs at about the speed
+// the pages come in. Fed in pieces of any size, the result only depends on the bytes.
+class Checksum
+{
+public:
+	void update(const uint8_t* bytes, size_t size)
+	{
+		total += size;
+		if(pending > 0)
+		{
+			size_t take = std::min(size, sizeof(block) - pending);
+			std::memcpy(block + pending, bytes, take);
+			pending += take;
+			bytes += take;
+			size -= take;
+			if(pending < sizeof(block))
+				return;
+			round(block);
+			pending = 0;
+		}
+		for(; size >= sizeof(block); bytes += sizeof(block), size -= sizeof(block))
+			round(bytes);
+		std::memcpy(block, bytes, size);
+		pending = size;
+	}
+
+	uint64_t finish() const
+	{
+		uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + total;
+		for(size_t i = 0; i < pending; i++)
+			hash = rotl(hash ^ (block[i] * PRIME_5), 11) * PRIME_1;
+		hash ^= hash >> 33;
+		hash *= PRIME_2;
+		hash ^= hash >> 29;
+		hash *= PRIME_3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+private:
+	static const uint64_t PRIME_1 = 11400714785074694791ull;
+	static const uint64_t PRIME_2 = 14029467366897019727ull;
+	static const uint64_t PRIME_3 = 1609587929392839161ull;
+	static const uint64_t PRIME_5 = 2870177450012600261ull;
+
+	static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+	void round(const uint8_t* bytes)
+	{
+		for(int lane = 0; lane < 4; lane++)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes + lane * 8, 8);
+			lanes[lane] = rotl(lanes[lane] + word * PRIME_2, 31) * PRIME_1;
+		}
+	}
+
+	uint64_t lanes[4] = {PRIME_1 + PRIME_2, PRIME_2, 0, 0 - PRIME_1};
+	uint8_t block[32];
+	size_t pending = 0;
+	uint64_t total = 0;
+};
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+}
+
+
+bool writeSceneFile(const std::string& path, const std::vector<SceneSectionData>& sections)
+{
+	if(sections.size() > (size_t)SCENE_FILE_MAX_SECTIONS)
+	{
+		logger::Log(logger::LogLevel::ERROR, "Too many sections for a scene file: " + path);
+		return false;
+	}
+
+	SceneFileHeader header = {};
+	std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_FILE_VERSION;
+	header.sectionCount = (uint32_t)sections.size();
+	uint64_t offset = alignUp(sizeof(header));
+	for(size_t i = 0; i < sections.size(); i++)
+	{
+		header.sections[i] = {(uint32_t)sections[i].type, sections[i].elementSize, offset, sections[i].count};
+		offset = alignUp(offset + sections[i].count * sections[i].elementSize);
+	}
+	header.fileSize = offset;
+
+	// the padding is zeros, and part of the checksum like everything else after the header
+	static const uint8_t zeros[SCENE_FILE_ALIGNMENT] = {};
+	Checksum checksum;
+	uint64_t position = sizeof(header);
+	for(size_t i = 0; i < sections.size(); i++)
+	{
+		checksum.update(zeros, header.sections[i].offset - position);
+		uint64_t bytes = sections[i].count * sections[i].elementSize;
+		checksum.update((const uint8_t*)sections[i].data, bytes);
+		position = header.sections[i].offset + bytes;
+	}
+	checksum.update(zeros, header.fileSize - position);
+	header.checksum = checksum.finish();
+
+	std::ofstream file(path, std::ios::binary);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open scene file: " + path);
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	position = sizeof(header);
+	for(size_t i = 0; i < sections.size(); i++)
+	{
+		file.write((const char*)zeros, header.sections[i].offset - position);
+		uint64_t bytes = sections[i].count * sections[i].elementSize;
+		file.write((const char*)sections[i].data, bytes);
+		position = header.sections[i].offset + bytes;
+	}
+	file.write((const char*)zeros, header.fileSize - position);
+
+	if(!file.good())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to write scene file: " + path);
+		return false;
+	}
+	logger::Log(logger::LogLevel::INFO, "Wrote " + std::to_string(header.fileSize) + " byte scene file " + path);
+	return true;
+}
+
+
+bool SceneFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER fileSize;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+	{
+		if(file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		logger::Log(logger::LogLevel::ERROR, "Failed to open scene file: " + path);
+		return false;
+	}
+	fileHandle = file;
+	size = (size_t)fileSize.QuadPart;
+	mappingHandle = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if(mappingHandle)
+		data = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	struct stat status;
+	if(file < 0 || fstat(file, &status) != 0)
+	{
+		if(file >= 0)
+			::close(file);
+		logger::Log(logger::LogLevel::ERROR, "Failed to open scene file: " + path);
+		return false;
+	}
+	size = (size_t)status.st_size;
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	// read the whole file in right away, it's all going to be touched by the checksum anyway
+	flags |= MAP_POPULATE;
+#endif
+	void* mapped = size > 0 ? mmap(nullptr, size, PROT_READ, flags, file, 0) : MAP_FAILED;
+	// the mapping keeps the file open by itself
+	::close(file);
+	if(mapped != MAP_FAILED)
+	{
+		data = (const uint8_t*)mapped;
+		madvise(mapped, size, MADV_SEQUENTIAL);
+	}
+#endif
+	if(!data)
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to map scene file: " + path);
+		close();
+		return false;
+	}
+
+	const SceneFileHeader* header = (const SceneFileHeader*)data;
+	std::string problem;
+	if(size < sizeof(SceneFileHeader) || std::memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic)) != 0)
+		problem = "not a scene file";
+	else if(header->version != SCENE_FILE_VERSION)
+		problem = "version " + std::to_string(header->version) + ", this build reads version " + std::to_string(SCENE_FILE_VERSION);
+	else if(header->fileSize != size)
+		problem = "truncated, " + std::to_string(size) + " of " + std::to_string(header->fileSize) + " bytes";
+	else if(header->sectionCount > (uint32_t)SCENE_FILE_MAX_SECTIONS)
+		problem = "too many sections";
+	else
+	{
+		for(uint32_t i = 0; i < header->sectionCount && problem.empty(); i++)
+		{
+			const SceneSectionEntry& entry = header->sections[i];
+			// written so none of it can overflow
+			if(entry.offset % SCENE_FILE_ALIGNMENT != 0 || entry.offset > size || entry.elementSize == 0
+				|| entry.count > (size - entry.offset) / entry.elementSize)
+				problem = "section " + std::to_string(i) + " is out of bounds";
+		}
+	}
+	if(problem.empty())
+	{
+		Checksum checksum;
+		checksum.update(data + sizeof(SceneFileHeader), size - sizeof(SceneFileHeader));
+		if(checksum.finish() != header->checksum)
+			problem = "checksum mismatch";
+	}
+	if(!problem.empty())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Invalid scene file " + path + ": " + problem);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SceneFile::close()
+{
+#ifdef _WIN32
+	if(data)
+		UnmapViewOfFile(data);
+	if(mappingHandle)
+		CloseHandle(mappingHandle);
+	if(fileHandle)
+		CloseHandle(fileHandle);
+	fileHandle = mappingHandle = nullptr;
+#else
+	if(data)
+		munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+const void* SceneFile::sectionData(SceneSection type, size_t elementSize, size_t& count) const
+{
+	count = 0;
+	if(!data)
+		return nullptr;
+
+	const SceneFileHeader* header = (const SceneFileHeader*)data;
+	for(uint32_t i = 0; i < header->sectionCount; i++)
+	{
+		const SceneSectionEntry& entry = header->sections[i];
+		if(entry.type != (uint32_t)type)
+			continue;
+		if(entry.elementSize != elementSize)
+			return nullptr;
+		count = (size_t)entry.count;
+		return data + entry.offset;
+	}
+	return nullptr;
+}
+
+void SceneFile::swap(SceneFile& other)
+{
+	std::swap(data, other.data);
+	std::swap(size, other.size);
+#ifdef _WIN32
+	std::swap(fileHandle, other.fileHandle);
+	std::swap(mappingHandle, other.mappingHandle);
+#endif
+}
+
+
+static const char* const MATERIAL_NAMES[] = {"lambert", "metal", "dielectric"};
+
+// the material part of a line, lambert R G B | metal R G B FUZZ | dielectric INDEX
+static bool readMaterial(std::istringstream& words, Material& material)
+{
+	material = {glm::vec3(0.0f), 1.0f, LAMBERT, 1.0f, {0.0f, 0.0f}};
+	std::string name;
+	if(!(words >> name))
+		return false;
+	if(name == MATERIAL_NAMES[LAMBERT])
+		return (bool)(words >> material.albedo.x >> material.albedo.y >> material.albedo.z);
+	if(name == MATERIAL_NAMES[METAL])
+	{
+		material.materialType = METAL;
+		return (bool)(words >> material.albedo.x >> material.albedo.y >> material.albedo.z >> material.fuzz);
+	}
+	if(name == MATERIAL_NAMES[DIELECTRIC])
+	{
+		material.materialType = DIELECTRIC;
+		return (bool)(words >> material.refractionIndex);
+	}
+	return false;
+}
+
+static std::string formatMaterial(const Material& material)
+{
+	char text[128];
+	if(material.materialType == DIELECTRIC)
+		std::snprintf(text, sizeof(text), "%s %.9g", MATERIAL_NAMES[DIELECTRIC], material.refractionIndex);
+	else if(material.materialType == METAL)
+		std::snprintf(text, sizeof(text), "%s %.9g %.9g %.9g %.9g", MATERIAL_NAMES[METAL], material.albedo.x, material.albedo.y, material.albedo.z, material.fuzz);
+	else
+		std::snprintf(text, sizeof(text), "%s %.9g %.9g %.9g", MATERIAL_NAMES[LAMBERT], material.albedo.x, material.albedo.y, material.albedo.z);
+	return text;
+}
+
+bool readSceneText(const std::string& path, std::vector<Sphere>& spheres, std::vector<SceneInstanceEntry>& instances)
+{
+	std::ifstream file(path);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open scene file: " + path);
+		return false;
+	}
+
+	spheres.clear();
+	instances.clear();
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	std::string line;
+	int lineNumber = 0;
+	while(std::getline(file, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if(comment != std::string::npos)
+			line.resize(comment);
+
+		std::istringstream words(line);
+		std::string keyword;
+		if(!(words >> keyword))
+			continue;
+
+		Sphere sphere = {glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f, LAMBERT, 1.0f};
+		SceneInstanceEntry instance = {"", glm::mat4(1.0f), Material()};
+		Material material;
+		bool valid = false;
+		if(keyword == "sphere")
+			valid = (words >> sphere.center.x >> sphere.center.y >> sphere.center.z >> sphere.radius) && readMaterial(words, material);
+		else if(keyword == "mesh")
+			valid = (words >> instance.path) && readMaterial(words, instance.material);
+		else if(keyword == "instance")
+		{
+			valid = (bool)(words >> instance.path);
+			// row by row, glm is column major
+			for(int row = 0; row < 3 && valid; row++)
+				for(int column = 0; column < 4 && valid; column++)
+					valid = (bool)(words >> instance.transform[column][row]);
+			valid = valid && readMaterial(words, instance.material);
+		}
+
+		std::string rest;
+		if(!valid || (words >> rest))
+		{
+			logger::Log(logger::LogLevel::ERROR, "Invalid line in scene file " + path + ":" + std::to_string(lineNumber) + ": " + line);
+			return false;
+		}
+
+		if(keyword != "sphere")
+		{
+			instance.path = (directory / instance.path).lexically_normal().string();
+			instances.push_back(instance);
+			continue;
+		}
+		sphere.albedo = material.albedo;
+		sphere.fuzz = material.fuzz;
+		sphere.materialType = material.materialType;
+		sphere.refractionIndex = material.refractionIndex;
+		spheres.push_back(sphere);
+	}
+	return true;
+}
+
+bool writeSceneText(const std::string& path, const std::vector<Sphere>& spheres, const std::vector<SceneInstanceEntry>& instances)
+{
+	std::ofstream file(path);
+	if(!file.is_open())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to open scene file: " + path);
+		return false;
+	}
+
+	file << "# sphere X Y Z RADIUS MATERIAL | mesh OBJ MATERIAL | instance OBJ M00 M01 ... M23 MATERIAL\n";
+	file << "# MATERIAL is lambert R G B | metal R G B FUZZ | dielectric INDEX\n";
+	char line[128];
+	for(const Sphere& sphere : spheres)
+	{
+		Material material = {sphere.albedo, sphere.fuzz, sphere.materialType, sphere.refractionIndex, {0.0f, 0.0f}};
+		std::snprintf(line, sizeof(line), "sphere %.9g %.9g %.9g %.9g ", sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius);
+		file << line << formatMaterial(material) << "\n";
+	}
+	// the OBJ paths are relative to the scene file, like readSceneText() expects them
+	std::filesystem::path directory = std::filesystem::absolute(path).parent_path();
+	for(const SceneInstanceEntry& instance : instances)
+	{
+		std::string objPath = std::filesystem::proximate(instance.path, directory).generic_string();
+		if(instance.transform == glm::mat4(1.0f))
+		{
+			file << "mesh " << objPath << " " << formatMaterial(instance.material) << "\n";
+			continue;
+		}
+		file << "instance " << objPath;
+		for(int row = 0; row < 3; row++)
+			for(int column = 0; column < 4; column++)
+			{
+				std::snprintf(line, sizeof(line), " %.9g", instance.transform[column][row]);
+				file << line;
+			}
+		file << " " << formatMaterial(instance.material) << "\n";
+	}
+
+	if(!file.good())
+	{
+		logger::Log(logger::LogLevel::ERROR, "Failed to write scene file: " + path);
+		return false;
+	}
+	return true;
+}
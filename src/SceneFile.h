@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Sphere.h"
+
+
+// Binary scene files (.rtscene). A header lists the sections, and every section is an array stored exactly
+// as the GPU buffer it goes into (see Scene), starting on a page boundary. So loading is mapping the file,
+// checking it, and copying the sections from the mapped pages into the buffers, with nothing parsed.
+//
+//   SceneFileHeader | padding | section | padding | section ...
+//
+// Everything is little endian, which is what every platform this runs on is. The checksum covers every
+// byte after the header. Files are written by Scene::save() and the SceneConverter tool.
+
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint64_t SCENE_FILE_ALIGNMENT = 4096;
+const int SCENE_FILE_MAX_SECTIONS = 8;
+
+enum class SceneSection : uint32_t
+{
+	GEOMETRY = 1,          // glm::vec4 per sphere, center and radius
+	SPHERE_MATERIALS = 2,  // uint32_t per sphere, index into MATERIALS
+	MATERIALS = 3,         // Material
+	BVH_NODES = 4,         // BVHNode
+	BVH_PRIMITIVES = 5     // uint32_t, BVH::primIndices
+};
+
+struct SceneSectionEntry
+{
+	uint32_t type;
+	// sizeof the elements, a file written with other struct layouts is rejected
+	uint32_t elementSize;
+	uint64_t offset;
+	uint64_t count;
+};
+
+struct SceneFileHeader
+{
+	char     magic[8];  // "RTSCENE\0"
+	uint32_t version;
+	uint32_t sectionCount;
+	uint64_t fileSize;
+	uint64_t checksum;
+	SceneSectionEntry sections[SCENE_FILE_MAX_SECTIONS];
+};
+static_assert(sizeof(SceneFileHeader) == 224, "SceneFileHeader is part of the file format");
+
+
+// a section to write, count elements of elementSize bytes at data
+struct SceneSectionData
+{
+	SceneSection type;
+	uint32_t elementSize;
+	const void* data;
+	uint64_t count;
+};
+
+// returns false and logs an error if the file can't be written
+bool writeSceneFile(const std::string& path, const std::vector<SceneSectionData>& sections);
+
+
+// A scene file mapped into memory, read only. The sections point straight into the mapping,
+// so they are only valid as long as the file stays open.
+class SceneFile
+{
+public:
+	SceneFile() = default;
+	~SceneFile() { close(); }
+	SceneFile(SceneFile&& other) noexcept { swap(other); }
+	SceneFile& operator=(SceneFile&& other) noexcept { swap(other); return *this; }
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	// Maps path and checks the header, the section bounds and the checksum. Returns false and logs
+	// why if the file can't be used.
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	// the elements of section type and their count, nullptr if the file doesn't have the section
+	// or it holds something other than T
+	template<typename T>
+	const T* section(SceneSection type, size_t& count) const
+	{
+		return (const T*)sectionData(type, sizeof(T), count);
+	}
+
+private:
+	const void* sectionData(SceneSection type, size_t elementSize, size_t& count) const;
+	void swap(SceneFile& other);
+
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+
+// a mesh or instance line of a text scene, the OBJ file, where it goes and the material all of its
+// triangles get
+struct SceneInstanceEntry
+{
+	// relative to the working directory, the file has it relative to the scene file
+	std::string path;
+	// object to world, identity for a mesh line
+	glm::mat4 transform;
+	Material material;
+};
+
+// The human readable scene description, one sphere or mesh per line, '#' starts a comment:
+//
+//   sphere X Y Z RADIUS MATERIAL
+//   mesh OBJ MATERIAL
+//   instance OBJ M00 M01 M02 M03 M10 M11 M12 M13 M20 M21 M22 M23 MATERIAL
+//
+// where MATERIAL is one of
+//
+//   lambert R G B
+//   metal R G B FUZZ
+//   dielectric INDEX
+//
+// and OBJ is the path of a Wavefront OBJ file (see loadObj()), relative to the scene file. An instance
+// places the mesh with the rows of a 3x4 object to world matrix, a mesh line is an instance that
+// stays where the file has it. Every OBJ file is loaded once, no matter how many lines use it.
+// Returns false and logs the offending line if the file can't be read.
+bool readSceneText(const std::string& path, std::vector<Sphere>& spheres, std::vector<SceneInstanceEntry>& instances);
+bool writeSceneText(const std::string& path, const std::vector<Sphere>& spheres, const std::vector<SceneInstanceEntry>& instances);
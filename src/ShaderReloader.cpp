@@ -0,0 +1,416 @@
+#include "ShaderReloader.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+
+// KHR_parallel_shader_compile isn't part of the generated loader, it is fetched through GLFW
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// editors save in several writes (or write a temporary and rename it), everything within this is one change
+static const int SETTLE_TIME_MS = 50;
+
+
+ShaderReloader::ShaderReloader(GLFWwindow* mainWindow, std::string directory, ProgramCache& programCache)
+	: directory(std::move(directory)), programCache(&programCache)
+{
+#ifdef __linux__
+	// windows can only be created on the main thread, the worker just makes this one current
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	workerWindow = glfwCreateWindow(1, 1, "Shader reloader", NULL, mainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if(!workerWindow)
+	{
+		logger::Log(logger::LogLevel::WARNING, "Failed to create the shader reload context, hot reload is disabled");
+		return;
+	}
+
+	parallelCompile = glfwExtensionSupported("GL_KHR_parallel_shader_compile");
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	worker = std::thread(&ShaderReloader::run, this);
+	logger::Log(logger::LogLevel::INFO, "Watching " + this->directory + " for shader changes" + (parallelCompile ? " (parallel compile)" : ""));
+#else
+	logger::Log(logger::LogLevel::WARNING, "Shader hot reload needs inotify, it is disabled on this platform");
+#endif
+}
+
+void ShaderReloader::release()
+{
+	stopping = true;
+	wake();
+	if(worker.joinable())
+		worker.join();
+#ifdef __linux__
+	if(wakeFd >= 0)
+		close(wakeFd);
+	wakeFd = -1;
+#endif
+	if(workerWindow)
+		glfwDestroyWindow(workerWindow);
+	workerWindow = nullptr;
+
+	for(Watched& entry : watched)
+		if(entry.hasReady)
+			entry.ready.release();
+	watched.clear();
+}
+
+int ShaderReloader::watch(Program program)
+{
+	// what the files include, so editing an include rebuilds every program that uses it
+	std::vector<std::string> dependencies;
+	for(const auto& file : program.files)
+	{
+		ShaderSource source;
+		std::string error;
+		if(tryReadShaderSource(file.second.c_str(), program.defines, source, error))
+			dependencies.insert(dependencies.end(), source.files.begin(), source.files.end());
+		else
+			dependencies.push_back(std::filesystem::weakly_canonical(file.second).string());
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Watched entry;
+	entry.program = std::move(program);
+	entry.dependencies = std::move(dependencies);
+	watched.push_back(std::move(entry));
+	return (int)watched.size() - 1;
+}
+
+void ShaderReloader::setDefines(int id, std::vector<std::string> defines)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	watched[id].program.defines = std::move(defines);
+}
+
+void ShaderReloader::requestBuild(int id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(std::find(requested.begin(), requested.end(), id) == requested.end())
+			requested.push_back(id);
+	}
+	wake();
+}
+
+void ShaderReloader::unwatch(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if(id < 0 || id >= (int)watched.size())
+		return;
+	Watched& entry = watched[id];
+	entry.active = false;
+	entry.program.files.clear();
+	entry.dependencies.clear();
+	if(entry.hasReady)
+		entry.ready.release();
+	entry.hasReady = false;
+}
+
+void ShaderReloader::wake()
+{
+#ifdef __linux__
+	if(wakeFd >= 0)
+	{
+		uint64_t one = 1;
+		if(write(wakeFd, &one, sizeof(one)) < 0)
+			logger::Log(logger::LogLevel::WARNING, "Failed to wake the shader reloader");
+	}
+#endif
+}
+
+bool ShaderReloader::takeReloaded(int id, ShaderProgram& program)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Watched& entry = watched[id];
+	if(!entry.hasReady)
+		return false;
+
+	entry.hasReady = false;
+	// the program was changed on the main thread while this one was compiling
+	if(entry.readyDefines != entry.program.defines)
+	{
+		entry.ready.release();
+		return false;
+	}
+	program = entry.ready;
+	entry.ready = ShaderProgram();
+	return true;
+}
+
+std::string ShaderReloader::status() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return lastStatus;
+}
+
+void ShaderReloader::setStatus(const std::string& text)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	lastStatus = text;
+}
+
+
+void ShaderReloader::run()
+{
+#ifdef __linux__
+	glfwMakeContextCurrent(workerWindow);
+	if(parallelCompile)
+	{
+		auto maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if(maxShaderCompilerThreads)
+			maxShaderCompilerThreads(0xFFFFFFFF); // as many as the driver likes
+	}
+
+	// inotify isn't recursive, the include directories need watches of their own
+	int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	std::vector<std::string> directories = {directory};
+	std::error_code error;
+	for(auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		if(it->is_directory())
+			directories.push_back(it->path().string());
+	for(const std::string& watchedDirectory : directories)
+	{
+		int descriptor = inotifyFd < 0 ? -1 : inotify_add_watch(inotifyFd, watchedDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if(descriptor >= 0)
+			watchDirectories[descriptor] = watchedDirectory;
+	}
+	if(watchDirectories.empty())
+	{
+		logger::Log(logger::LogLevel::WARNING, "Failed to watch " + directory + ", hot reload is disabled");
+		if(inotifyFd >= 0)
+			close(inotifyFd);
+		glfwMakeContextCurrent(NULL);
+		return;
+	}
+
+	while(!stopping)
+	{
+		std::vector<std::string> changed = waitForChanges(inotifyFd);
+
+		std::vector<int> ids;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ids.swap(requested);
+			for(size_t id = 0; id < watched.size(); id++)
+				for(const std::string& file : watched[id].dependencies)
+					if(std::find(changed.begin(), changed.end(), file) != changed.end())
+					{
+						if(std::find(ids.begin(), ids.end(), (int)id) == ids.end())
+							ids.push_back((int)id);
+						break;
+					}
+		}
+		if(!ids.empty())
+			rebuild(ids);
+	}
+
+	close(inotifyFd);
+	glfwMakeContextCurrent(NULL);
+#endif
+}
+
+// canonical paths of the files changed in the watched directories, returns early when woken up by requestBuild() or release()
+std::vector<std::string> ShaderReloader::waitForChanges(int inotifyFd)
+{
+	std::vector<std::string> changed;
+#ifdef __linux__
+	pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+	int timeout = 100;
+	while(poll(descriptors, wakeFd >= 0 ? 2 : 1, timeout) > 0)
+	{
+		if(descriptors[1].revents & POLLIN)
+		{
+			uint64_t count;
+			if(read(wakeFd, &count, sizeof(count)) < 0)
+				break;
+			// a requested build doesn't wait for the files to settle
+			if(changed.empty())
+				break;
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for(char* event = buffer; event < buffer + length; event += sizeof(inotify_event) + ((inotify_event*)event)->len)
+			{
+				const inotify_event* info = (const inotify_event*)event;
+				if(info->len == 0 || !watchDirectories.count(info->wd))
+					continue;
+				std::string path = std::filesystem::weakly_canonical(std::filesystem::path(watchDirectories[info->wd]) / info->name).string();
+				if(std::find(changed.begin(), changed.end(), path) == changed.end())
+					changed.push_back(path);
+			}
+		}
+		timeout = SETTLE_TIME_MS;
+	}
+#endif
+	return changed;
+}
+
+// without KHR_parallel_shader_compile the status queries below block by themselves
+void ShaderReloader::waitForCompletion(GLuint object, bool isProgram) const
+{
+	if(!parallelCompile)
+		return;
+
+	GLint done = GL_FALSE;
+	while(!done && !stopping)
+	{
+		if(isProgram)
+			glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &done);
+		else
+			glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &done);
+		if(!done)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void ShaderReloader::rebuild(const std::vector<int>& ids)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	struct Build
+	{
+		int id;
+		Program program;
+		std::vector<ProgramCache::Stage> stages;
+		std::vector<GLuint> shaders;
+		GLuint linked = 0;
+		bool failed = false;
+	};
+	std::vector<Build> builds;
+
+	// every compile is started before any result is asked for, so the driver can run them side by side
+	for(int id : ids)
+	{
+		Build build;
+		build.id = id;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			build.program = watched[id].program;
+		}
+		for(const auto& file : build.program.files)
+		{
+			ProgramCache::Stage stage = {file.first, file.second, ShaderSource()};
+			std::string error;
+			if(!tryReadShaderSource(file.second.c_str(), build.program.defines, stage.source, error))
+			{
+				logger::Log(logger::LogLevel::ERROR, error);
+				build.failed = true;
+				break;
+			}
+			GLuint shader = glCreateShader(stage.type);
+			const char* source = stage.source.text.c_str();
+			glShaderSource(shader, 1, &source, NULL);
+			glCompileShader(shader);
+			build.shaders.push_back(shader);
+			build.stages.push_back(std::move(stage));
+		}
+		if(!build.failed)
+		{
+			std::vector<std::string> dependencies;
+			for(const ProgramCache::Stage& stage : build.stages)
+				dependencies.insert(dependencies.end(), stage.source.files.begin(), stage.source.files.end());
+			std::lock_guard<std::mutex> lock(mutex);
+			if(watched[id].active)
+				watched[id].dependencies = std::move(dependencies);
+		}
+		builds.push_back(std::move(build));
+	}
+
+	for(Build& build : builds)
+	{
+		for(size_t i = 0; i < build.shaders.size() && !build.failed; i++)
+		{
+			waitForCompletion(build.shaders[i], false);
+			GLint success;
+			glGetShaderiv(build.shaders[i], GL_COMPILE_STATUS, &success);
+			if(!success)
+			{
+				GLchar infoLog[512];
+				glGetShaderInfoLog(build.shaders[i], 512, NULL, infoLog);
+				logger::Log(logger::LogLevel::ERROR, "Failed to compile " + build.stages[i].name + ": " + infoLog + describeSourceFiles(build.stages[i].source));
+				build.failed = true;
+			}
+		}
+		if(build.failed)
+			continue;
+
+		build.linked = glCreateProgram();
+		if(programCache->isEnabled())
+			glProgramParameteri(build.linked, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		for(GLuint shader : build.shaders)
+			glAttachShader(build.linked, shader);
+		glLinkProgram(build.linked);
+	}
+
+	int reloaded = 0;
+	for(Build& build : builds)
+	{
+		for(GLuint shader : build.shaders)
+			glDeleteShader(shader);
+		if(build.failed)
+			continue;
+
+		waitForCompletion(build.linked, true);
+		GLint success;
+		glGetProgramiv(build.linked, GL_LINK_STATUS, &success);
+		if(!success)
+		{
+			GLchar infoLog[512];
+			glGetProgramInfoLog(build.linked, 512, NULL, infoLog);
+			logger::Log(logger::LogLevel::ERROR, "Failed to link " + build.stages.front().name + ": " + infoLog);
+			glDeleteProgram(build.linked);
+			build.failed = true;
+			continue;
+		}
+		programCache->store(build.stages, build.linked);
+	}
+
+	// the main context may only use the programs once everything about them is done on this one
+	glFinish();
+
+	for(Build& build : builds)
+	{
+		if(build.failed)
+			continue;
+
+		ShaderProgram program = ShaderProgram::fromLinked(build.linked);
+		std::lock_guard<std::mutex> lock(mutex);
+		Watched& entry = watched[build.id];
+		if(!entry.active)
+		{
+			program.release();
+			continue;
+		}
+		// a rebuild the main thread hasn't picked up yet is replaced
+		if(entry.hasReady)
+			entry.ready.release();
+		entry.ready = program;
+		entry.readyDefines = build.program.defines;
+		entry.hasReady = true;
+		reloaded++;
+	}
+
+	float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	int failed = (int)builds.size() - reloaded;
+	std::string text = "Reloaded " + std::to_string(reloaded) + " programs in " + std::to_string((int)elapsed) + " ms";
+	if(failed > 0)
+		text += ", " + std::to_string(failed) + " failed (see log)";
+	logger::Log(failed > 0 ? logger::LogLevel::WARNING : logger::LogLevel::INFO, text);
+	setStatus(text);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GLItems.h"
+#include "ProgramCache.h"
+
+
+// Rebuilds shader programs in the background whenever one of their files changes.
+// The shader directory and the ones below it are watched with inotify, and the programs are compiled on a worker thread
+// with its own context shared with the main one, so the render loop never waits on the compiler.
+// With KHR_parallel_shader_compile every changed program compiles at once.
+// A program that doesn't compile or link is only logged, the old one keeps running.
+class ShaderReloader
+{
+public:
+	struct Program
+	{
+		// shader stage and path of every file the program is linked from
+		std::vector<std::pair<GLenum, std::string>> files;
+		std::vector<std::string> defines;
+	};
+
+	// has to be called on the main thread, which owns mainWindow
+	ShaderReloader(GLFWwindow* mainWindow, std::string directory, ProgramCache& programCache);
+	// stops the worker and destroys its context, has to happen on the main thread before glfwTerminate
+	void release();
+
+	// returns the id to ask takeReloaded() with
+	int watch(Program program);
+	// for programs whose defines change at run time, rebuilds with older defines are thrown away
+	void setDefines(int id, std::vector<std::string> defines);
+	// builds program id as soon as possible, without waiting for a file to change
+	void requestBuild(int id);
+	// stops rebuilding program id, a build in flight is thrown away
+	void unwatch(int id);
+
+	// moves the latest rebuild of program id into program, false if there is none
+	bool takeReloaded(int id, ShaderProgram& program);
+
+	// result of the last rebuild, for the UI
+	std::string status() const;
+
+private:
+	struct Watched
+	{
+		Program program;
+		// finished rebuild waiting for takeReloaded(), and the defines it was built with
+		ShaderProgram ready;
+		bool hasReady = false;
+		std::vector<std::string> readyDefines;
+		bool active = true;
+		// canonical paths of the files and everything they include
+		std::vector<std::string> dependencies;
+	};
+
+	void run();
+	std::vector<std::string> waitForChanges(int inotifyFd);
+	void wake();
+	void rebuild(const std::vector<int>& ids);
+	void waitForCompletion(GLuint object, bool isProgram) const;
+	void setStatus(const std::string& text);
+
+	std::string directory;
+	ProgramCache* programCache;
+	GLFWwindow* workerWindow = nullptr;
+	bool parallelCompile = false;
+
+	mutable std::mutex mutex;
+	std::vector<Watched> watched;
+	std::string lastStatus = "No reloads yet";
+	std::vector<int> requested;
+	// written by requestBuild() to wake the worker up
+	int wakeFd = -1;
+	// inotify watch descriptor to directory, only used by the worker
+	std::unordered_map<int, std::string> watchDirectories;
+
+	std::thread worker;
+	std::atomic<bool> stopping{false};
+};
@@ -0,0 +1,51 @@
+// SimdTraversalImpl.h on AVX2, 8 lanes. Built with -mavx2 (see CMakeLists.txt), and only called
+// when CPUID reports AVX2, so nothing else may be compiled into this file.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+#include "SimdTraversalImpl.h"
+
+namespace {
+
+struct AVX2Lanes
+{
+	static constexpr int WIDTH = 8;
+	typedef __m256 F;
+	typedef __m256 M;
+
+	static F splat(float value) { return _mm256_set1_ps(value); }
+	static F load(const float* values) { return _mm256_loadu_ps(values); }
+	static void store(float* values, F a) { _mm256_storeu_ps(values, a); }
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm256_div_ps(a, b); }
+	static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm256_min_ps(a, b); }
+	static F max(F a, F b) { return _mm256_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static M le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static M maskAnd(M a, M b) { return _mm256_and_ps(a, b); }
+	static F select(M mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+	static uint32_t bits(M mask) { return (uint32_t)_mm256_movemask_ps(mask); }
+	static M firstLanes(int count)
+	{
+		return _mm256_cmp_ps(_mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f), _mm256_set1_ps((float)count), _CMP_LT_OQ);
+	}
+};
+
+int closestHit(const SimdScene& scene, const float origin[3], const float direction[3], float tMin, float& tMax)
+{
+	return closestHitImpl<AVX2Lanes>(scene, origin, direction, tMin, tMax);
+}
+
+void closestHitPacket(const SimdScene& scene, const RayPacket& packet, float tMin, float* tMax, int* hit)
+{
+	closestHitPacketImpl<AVX2Lanes>(scene, packet, tMin, tMax, hit);
+}
+
+}
+
+extern const SimdBackend AVX2_BACKEND = {"avx2", AVX2Lanes::WIDTH, closestHit, closestHitPacket};
+#endif
@@ -0,0 +1,48 @@
+// SimdTraversalImpl.h on AVX-512, 16 lanes. Built with -mavx512f (see CMakeLists.txt), and only
+// called when CPUID reports AVX-512F, so nothing else may be compiled into this file.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+#include "SimdTraversalImpl.h"
+
+namespace {
+
+struct AVX512Lanes
+{
+	static constexpr int WIDTH = 16;
+	typedef __m512 F;
+	typedef __mmask16 M;
+
+	static F splat(float value) { return _mm512_set1_ps(value); }
+	static F load(const float* values) { return _mm512_loadu_ps(values); }
+	static void store(float* values, F a) { _mm512_storeu_ps(values, a); }
+	static F add(F a, F b) { return _mm512_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm512_div_ps(a, b); }
+	static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm512_min_ps(a, b); }
+	static F max(F a, F b) { return _mm512_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static M gt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static M le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	static M maskAnd(M a, M b) { return (M)(a & b); }
+	static F select(M mask, F a, F b) { return _mm512_mask_blend_ps(mask, b, a); }
+	static uint32_t bits(M mask) { return (uint32_t)mask; }
+	static M firstLanes(int count) { return count >= WIDTH ? (M)0xFFFF : count <= 0 ? (M)0 : (M)((1u << count) - 1); }
+};
+
+int closestHit(const SimdScene& scene, const float origin[3], const float direction[3], float tMin, float& tMax)
+{
+	return closestHitImpl<AVX512Lanes>(scene, origin, direction, tMin, tMax);
+}
+
+void closestHitPacket(const SimdScene& scene, const RayPacket& packet, float tMin, float* tMax, int* hit)
+{
+	closestHitPacketImpl<AVX512Lanes>(scene, packet, tMin, tMax, hit);
+}
+
+}
+
+extern const SimdBackend AVX512_BACKEND = {"avx512", AVX512Lanes::WIDTH, closestHit, closestHitPacket};
+#endif
@@ -0,0 +1,50 @@
+// SimdTraversalImpl.h on SSE, 4 lanes. Part of x86-64 itself, so this needs no extra compiler flags.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+#include "SimdTraversalImpl.h"
+
+namespace {
+
+struct SSELanes
+{
+	static constexpr int WIDTH = 4;
+	typedef __m128 F;
+	typedef __m128 M;
+
+	static F splat(float value) { return _mm_set1_ps(value); }
+	static F load(const float* values) { return _mm_loadu_ps(values); }
+	static void store(float* values, F a) { _mm_storeu_ps(values, a); }
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm_div_ps(a, b); }
+	static F sqrt(F a) { return _mm_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm_min_ps(a, b); }
+	static F max(F a, F b) { return _mm_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+	static M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+	static M le(F a, F b) { return _mm_cmple_ps(a, b); }
+	static M maskAnd(M a, M b) { return _mm_and_ps(a, b); }
+	static F select(M mask, F a, F b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static uint32_t bits(M mask) { return (uint32_t)_mm_movemask_ps(mask); }
+	static M firstLanes(int count)
+	{
+		return _mm_cmplt_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps((float)count));
+	}
+};
+
+int closestHit(const SimdScene& scene, const float origin[3], const float direction[3], float tMin, float& tMax)
+{
+	return closestHitImpl<SSELanes>(scene, origin, direction, tMin, tMax);
+}
+
+void closestHitPacket(const SimdScene& scene, const RayPacket& packet, float tMin, float* tMax, int* hit)
+{
+	closestHitPacketImpl<SSELanes>(scene, packet, tMin, tMax, hit);
+}
+
+}
+
+extern const SimdBackend SSE_BACKEND = {"sse", SSELanes::WIDTH, closestHit, closestHitPacket};
+#endif
@@ -0,0 +1,102 @@
+#include "SimdTraversal.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+SimdScene makeSimdScene(const SphereSoA& soa, const BVH& bvh)
+{
+	return {soa.centerX.data(), soa.centerY.data(), soa.centerZ.data(), soa.radius.data(), soa.rangeFirst.data(), soa.rangeCount.data(), bvh.nodes.data()};
+}
+
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+extern const SimdBackend SSE_BACKEND;
+extern const SimdBackend AVX2_BACKEND;
+extern const SimdBackend AVX512_BACKEND;
+
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// which register state the OS saves on a context switch, the CPU having AVX alone isn't enough
+static unsigned long long enabledRegisterState()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((unsigned long long)high << 32) | low;
+#endif
+}
+
+static std::vector<const SimdBackend*> detectBackends()
+{
+	std::vector<const SimdBackend*> backends;
+
+	unsigned int registers[4];
+	cpuid(0, 0, registers);
+	unsigned int maxLeaf = registers[0];
+	cpuid(1, 0, registers);
+	bool osxsave = registers[2] & (1u << 27);
+	unsigned long long state = osxsave ? enabledRegisterState() : 0;
+	// XMM and YMM, then opmask and both halves of ZMM as well
+	bool avxState = (state & 0x6) == 0x6;
+	bool avx512State = (state & 0xE6) == 0xE6;
+
+	unsigned int extended[4] = {};
+	if(maxLeaf >= 7)
+		cpuid(7, 0, extended);
+	bool avx2 = extended[1] & (1u << 5);
+	bool avx512f = extended[1] & (1u << 16);
+
+	if(avx512f && avx512State)
+		backends.push_back(&AVX512_BACKEND);
+	if(avx2 && avxState)
+		backends.push_back(&AVX2_BACKEND);
+	// every x86-64 CPU has SSE2
+	backends.push_back(&SSE_BACKEND);
+	return backends;
+}
+
+#else
+
+static std::vector<const SimdBackend*> detectBackends()
+{
+	return {};
+}
+
+#endif
+
+
+const std::vector<const SimdBackend*>& supportedSimdBackends()
+{
+	static const std::vector<const SimdBackend*> backends = detectBackends();
+	return backends;
+}
+
+const SimdBackend* bestSimdBackend()
+{
+	const std::vector<const SimdBackend*>& backends = supportedSimdBackends();
+	return backends.empty() ? nullptr : backends.front();
+}
+
+const SimdBackend* findSimdBackend(const std::string& name)
+{
+	for(const SimdBackend* backend : supportedSimdBackends())
+		if(name == backend->name)
+			return backend;
+	return nullptr;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "SphereSoA.h"
+
+
+// up to 16 rays stored as separate arrays, so one register holds a component of all of them
+struct RayPacket
+{
+	static const int MAX_SIZE = 16;
+
+	alignas(64) float originX[MAX_SIZE];
+	alignas(64) float originY[MAX_SIZE];
+	alignas(64) float originZ[MAX_SIZE];
+	alignas(64) float directionX[MAX_SIZE];
+	alignas(64) float directionY[MAX_SIZE];
+	alignas(64) float directionZ[MAX_SIZE];
+	// the rays past size are ignored
+	int size = 0;
+};
+
+
+// Plain pointers into a SphereSoA and the BVH it was built for, which is all the SIMD code gets to see.
+// Only valid as long as neither changes.
+struct SimdScene
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* radius;
+	const uint32_t* rangeFirst;
+	const uint32_t* rangeCount;
+	const BVHNode* nodes;
+};
+
+SimdScene makeSimdScene(const SphereSoA& soa, const BVH& bvh);
+
+
+// One instruction set the CPU backend can intersect with. Each is compiled in a file of its own
+// (SimdSSE.cpp, SimdAVX2.cpp, SimdAVX512.cpp) with the matching compiler flags, and only run
+// if CPUID says the CPU has it.
+struct SimdBackend
+{
+	const char* name;
+	// spheres tested per instruction, and rays per packet
+	int width;
+
+	// Closest sphere the ray hits in (tMin, tMax), walking the BVH and testing width spheres at a time.
+	// Returns the BVH order index of the sphere (see SphereSoA) and sets tMax to its distance, or -1.
+	int (*closestHit)(const SimdScene& scene, const float origin[3], const float direction[3], float tMin, float& tMax);
+
+	// The same for the first packet.size rays (at most width) at once, which share the walk through
+	// the BVH, so the rays should be close together like camera rays of neighbouring pixels.
+	// hit and tMax are per ray, tMax has to be initialised.
+	void (*closestHitPacket)(const SimdScene& scene, const RayPacket& packet, float tMin, float* tMax, int* hit);
+};
+
+
+// every backend this CPU can run, widest first, empty if there are none (not x86, or not built with them)
+const std::vector<const SimdBackend*>& supportedSimdBackends();
+// the widest supported backend, or nullptr
+const SimdBackend* bestSimdBackend();
+// nullptr for "off" and for names this CPU doesn't support
+const SimdBackend* findSimdBackend(const std::string& name);
@@ -0,0 +1,314 @@
+// The traversal of SimdTraversal.h, written once for a lane type L and included by each of
+// SimdSSE.cpp, SimdAVX2.cpp and SimdAVX512.cpp. L wraps the intrinsics of one instruction set:
+//
+//   WIDTH, F (a register of floats), M (a lane mask),
+//   splat, load (unaligned), store, add, sub, mul, div, sqrt, min, max,
+//   lt, gt, le, maskAnd, select(mask, ifSet, ifClear), bits (mask to an int), firstLanes(n)
+//
+// Those files are compiled with flags the rest of the program doesn't have, so nothing in here may be
+// an inline function another file could end up sharing (the linker picks any one copy, which could be
+// the AVX-512 one): everything is local to the including file, nothing from glm or the standard
+// library is called, and the scene comes in as plain pointers (SimdScene).
+#pragma once
+#include <cstdint>
+
+#include "SimdTraversal.h"
+
+namespace {
+
+const float NO_HIT = 1e30f;
+
+inline int lowestBit(uint32_t bits)
+{
+	int lane = 0;
+	while(!(bits & 1u))
+	{
+		bits >>= 1;
+		lane++;
+	}
+	return lane;
+}
+
+// same as AABB_hit in CPURaytracer.cpp
+inline float boxEntry(const BVHNode& node, const float origin[3], const float invDir[3], float tMin, float tMax)
+{
+	float enter = tMin;
+	float exit = tMax;
+	const float* boundsMin = &node.boundsMin.x;
+	const float* boundsMax = &node.boundsMax.x;
+	for(int axis = 0; axis < 3; axis++)
+	{
+		float t0 = (boundsMin[axis] - origin[axis]) * invDir[axis];
+		float t1 = (boundsMax[axis] - origin[axis]) * invDir[axis];
+		float tNear = t0 < t1 ? t0 : t1;
+		float tFar = t0 < t1 ? t1 : t0;
+		enter = tNear > enter ? tNear : enter;
+		exit = tFar < exit ? tFar : exit;
+	}
+	return enter <= exit ? enter : NO_HIT;
+}
+
+
+// Sphere_hit of one ray against the count spheres from first on, L::WIDTH at a time.
+// Same arithmetic as the scalar version, so both find the same hits.
+template<typename L>
+inline int hitSphereRange(const SimdScene& scene, uint32_t first, uint32_t count, const float origin[3], const float direction[3], float a, float tMin, float& tMax)
+{
+	typedef typename L::F F;
+	typedef typename L::M M;
+
+	F ox = L::splat(origin[0]), oy = L::splat(origin[1]), oz = L::splat(origin[2]);
+	F dx = L::splat(direction[0]), dy = L::splat(direction[1]), dz = L::splat(direction[2]);
+	F av = L::splat(a);
+	F zero = L::splat(0.0f);
+	F tMinV = L::splat(tMin);
+
+	const float* centerX = scene.centerX;
+	const float* centerY = scene.centerY;
+	const float* centerZ = scene.centerZ;
+	const float* radius = scene.radius;
+
+	int hit = -1;
+	for(uint32_t offset = 0; offset < count; offset += L::WIDTH)
+	{
+		uint32_t i = first + offset;
+		F ocx = L::sub(ox, L::load(centerX + i));
+		F ocy = L::sub(oy, L::load(centerY + i));
+		F ocz = L::sub(oz, L::load(centerZ + i));
+		F r = L::load(radius + i);
+
+		F b = L::add(L::add(L::mul(ocx, dx), L::mul(ocy, dy)), L::mul(ocz, dz));
+		F c = L::sub(L::add(L::add(L::mul(ocx, ocx), L::mul(ocy, ocy)), L::mul(ocz, ocz)), L::mul(r, r));
+		F discriminant = L::sub(L::mul(b, b), L::mul(av, c));
+		M valid = L::maskAnd(L::gt(discriminant, zero), L::firstLanes((int)(count - offset)));
+		if(!L::bits(valid))
+			continue;
+
+		F root = L::sqrt(L::max(discriminant, zero));
+		F tMaxV = L::splat(tMax);
+		F nearT = L::div(L::sub(L::sub(zero, b), root), av);
+		F farT = L::div(L::add(L::sub(zero, b), root), av);
+		M nearInRange = L::maskAnd(L::lt(nearT, tMaxV), L::gt(nearT, tMinV));
+		F t = L::select(nearInRange, nearT, farT);
+		M hits = L::maskAnd(valid, L::maskAnd(L::lt(t, tMaxV), L::gt(t, tMinV)));
+		uint32_t hitBits = L::bits(hits);
+		if(!hitBits)
+			continue;
+
+		// the nearest of the lanes that hit
+		alignas(64) float distances[L::WIDTH];
+		L::store(distances, t);
+		float nearest = tMax;
+		int nearestLane = -1;
+		for(uint32_t lanes = hitBits; lanes; lanes &= lanes - 1)
+		{
+			int lane = lowestBit(lanes);
+			if(distances[lane] < nearest)
+			{
+				nearest = distances[lane];
+				nearestLane = lane;
+			}
+		}
+		tMax = nearest;
+		hit = (int)i + nearestLane;
+	}
+	return hit;
+}
+
+template<typename L>
+int closestHitImpl(const SimdScene& scene, const float origin[3], const float direction[3], float tMin, float& tMax)
+{
+	const BVHNode* nodes = scene.nodes;
+	const uint32_t* rangeFirst = scene.rangeFirst;
+	const uint32_t* rangeCount = scene.rangeCount;
+
+	float invDir[3] = {1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+	float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+
+	if(boxEntry(nodes[0], origin, invDir, tMin, tMax) == NO_HIT)
+		return -1;
+
+	int hit = -1;
+	uint32_t stack[BVH::MAX_DEPTH];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while(true)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+		// a subtree that fits in a register is cheaper to test whole than to walk
+		if(node.primCount > 0 || rangeCount[nodeIndex] <= (uint32_t)L::WIDTH)
+		{
+			int rangeHit = hitSphereRange<L>(scene, rangeFirst[nodeIndex], rangeCount[nodeIndex], origin, direction, a, tMin, tMax);
+			if(rangeHit >= 0)
+				hit = rangeHit;
+		}
+		else
+		{
+			// visit the nearer child first, the other one goes on the stack
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			float nearDist = boxEntry(nodes[nearChild], origin, invDir, tMin, tMax);
+			float farDist = boxEntry(nodes[farChild], origin, invDir, tMin, tMax);
+			if(farDist < nearDist)
+			{
+				uint32_t child = nearChild;
+				nearChild = farChild;
+				farChild = child;
+				float dist = nearDist;
+				nearDist = farDist;
+				farDist = dist;
+			}
+
+			if(nearDist != NO_HIT)
+			{
+				if(farDist != NO_HIT)
+					stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		if(stackSize == 0)
+			break;
+		nodeIndex = stack[--stackSize];
+	}
+	return hit;
+}
+
+
+// the box entry distance of every ray of the packet, and which of them hit the box at all
+template<typename L>
+inline typename L::M packetBoxEntry(const BVHNode& node, const typename L::F origin[3], const typename L::F invDir[3], typename L::F tMin, typename L::F tMax, typename L::F& entry)
+{
+	typedef typename L::F F;
+	const float* boundsMin = &node.boundsMin.x;
+	const float* boundsMax = &node.boundsMax.x;
+
+	F enter = tMin;
+	F exit = tMax;
+	for(int axis = 0; axis < 3; axis++)
+	{
+		F t0 = L::mul(L::sub(L::splat(boundsMin[axis]), origin[axis]), invDir[axis]);
+		F t1 = L::mul(L::sub(L::splat(boundsMax[axis]), origin[axis]), invDir[axis]);
+		enter = L::max(enter, L::min(t0, t1));
+		exit = L::min(exit, L::max(t0, t1));
+	}
+	entry = enter;
+	return L::le(enter, exit);
+}
+
+template<typename L>
+void closestHitPacketImpl(const SimdScene& scene, const RayPacket& packet, float tMin, float* tMax, int* hit)
+{
+	typedef typename L::F F;
+	typedef typename L::M M;
+
+	const BVHNode* nodes = scene.nodes;
+	int size = packet.size < L::WIDTH ? packet.size : L::WIDTH;
+	for(int i = 0; i < size; i++)
+		hit[i] = -1;
+
+	F origin[3] = {L::load(packet.originX), L::load(packet.originY), L::load(packet.originZ)};
+	F direction[3] = {L::load(packet.directionX), L::load(packet.directionY), L::load(packet.directionZ)};
+	F one = L::splat(1.0f);
+	F invDir[3] = {L::div(one, direction[0]), L::div(one, direction[1]), L::div(one, direction[2])};
+	F a = L::add(L::add(L::mul(direction[0], direction[0]), L::mul(direction[1], direction[1])), L::mul(direction[2], direction[2]));
+	F zero = L::splat(0.0f);
+	F tMinV = L::splat(tMin);
+	M active = L::firstLanes(size);
+
+	alignas(64) float tMaxLanes[L::WIDTH];
+	for(int i = 0; i < L::WIDTH; i++)
+		tMaxLanes[i] = i < size ? tMax[i] : 0.0f;
+	F tMaxV = L::load(tMaxLanes);
+
+	F entry;
+	if(!L::bits(L::maskAnd(active, packetBoxEntry<L>(nodes[0], origin, invDir, tMinV, tMaxV, entry))))
+		return;
+
+	uint32_t stack[BVH::MAX_DEPTH];
+	int stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while(true)
+	{
+		const BVHNode& node = nodes[nodeIndex];
+		if(node.primCount > 0)
+		{
+			// one sphere against every ray of the packet
+			for(uint32_t i = node.leftFirst; i < node.leftFirst + node.primCount; i++)
+			{
+				F ocx = L::sub(origin[0], L::splat(scene.centerX[i]));
+				F ocy = L::sub(origin[1], L::splat(scene.centerY[i]));
+				F ocz = L::sub(origin[2], L::splat(scene.centerZ[i]));
+				F r = L::splat(scene.radius[i]);
+
+				F b = L::add(L::add(L::mul(ocx, direction[0]), L::mul(ocy, direction[1])), L::mul(ocz, direction[2]));
+				F c = L::sub(L::add(L::add(L::mul(ocx, ocx), L::mul(ocy, ocy)), L::mul(ocz, ocz)), L::mul(r, r));
+				F discriminant = L::sub(L::mul(b, b), L::mul(a, c));
+				M valid = L::maskAnd(active, L::gt(discriminant, zero));
+				if(!L::bits(valid))
+					continue;
+
+				F root = L::sqrt(L::max(discriminant, zero));
+				F nearT = L::div(L::sub(L::sub(zero, b), root), a);
+				F farT = L::div(L::add(L::sub(zero, b), root), a);
+				M nearInRange = L::maskAnd(L::lt(nearT, tMaxV), L::gt(nearT, tMinV));
+				F t = L::select(nearInRange, nearT, farT);
+				M hits = L::maskAnd(valid, L::maskAnd(L::lt(t, tMaxV), L::gt(t, tMinV)));
+				uint32_t hitBits = L::bits(hits);
+				if(!hitBits)
+					continue;
+
+				tMaxV = L::select(hits, t, tMaxV);
+				for(uint32_t lanes = hitBits; lanes; lanes &= lanes - 1)
+					hit[lowestBit(lanes)] = (int)i;
+			}
+		}
+		else
+		{
+			// the child most rays enter first is visited first
+			uint32_t nearChild = node.leftFirst;
+			uint32_t farChild = node.leftFirst + 1;
+			F nearEntry, farEntry;
+			M nearHits = L::maskAnd(active, packetBoxEntry<L>(nodes[nearChild], origin, invDir, tMinV, tMaxV, nearEntry));
+			M farHits = L::maskAnd(active, packetBoxEntry<L>(nodes[farChild], origin, invDir, tMinV, tMaxV, farEntry));
+			uint32_t nearBits = L::bits(nearHits);
+			uint32_t farBits = L::bits(farHits);
+
+			if(nearBits && farBits)
+			{
+				uint32_t farFirst = L::bits(L::maskAnd(L::maskAnd(nearHits, farHits), L::lt(farEntry, nearEntry)));
+				uint32_t both = nearBits & farBits;
+				int farFirstCount = 0, bothCount = 0;
+				for(uint32_t lanes = both; lanes; lanes &= lanes - 1)
+					bothCount++;
+				for(uint32_t lanes = farFirst; lanes; lanes &= lanes - 1)
+					farFirstCount++;
+				if(2 * farFirstCount > bothCount)
+				{
+					uint32_t child = nearChild;
+					nearChild = farChild;
+					farChild = child;
+				}
+				stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+			if(nearBits || farBits)
+			{
+				nodeIndex = nearBits ? nearChild : farChild;
+				continue;
+			}
+		}
+
+		if(stackSize == 0)
+			break;
+		nodeIndex = stack[--stackSize];
+	}
+
+	L::store(tMaxLanes, tMaxV);
+	for(int i = 0; i < size; i++)
+		tMax[i] = tMaxLanes[i];
+}
+
+}
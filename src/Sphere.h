@@ -0,0 +1,39 @@
+#pragma once
+#include <glm/glm.hpp>
+
+
+// material types, these have to match the defines in shaders/include/common.glsl
+enum MaterialType : int
+{
+	LAMBERT    = 0,
+	METAL      = 1,
+	DIELECTRIC = 2
+};
+
+// A sphere as the scene is edited. The GPU gets it split up (see Scene::commit()): the center and
+// radius go into a tight vec4 array, the material into a table the sphere has an index into.
+struct Sphere
+{
+	// sphere properties
+	glm::vec3 center;
+	float     radius;
+
+	// material
+	glm::vec3 albedo;
+	float     fuzz;
+	int       materialType;
+	float     refractionIndex;
+};
+
+// Host side copy of the Material struct in shaders/include/sphere.glsl, ordered so it matches
+// the std430 layout of the shader struct and can be uploaded as is.
+struct Material
+{
+	glm::vec3 albedo;
+	float     fuzz;
+	int       materialType;
+	float     refractionIndex;
+
+	float     padding[2];
+};
+static_assert(sizeof(Material) == 32, "Material has to match the std430 layout in the shader");
@@ -0,0 +1,53 @@
+#include "SphereSoA.h"
+
+
+void SphereSoA::build(const std::vector<Sphere>& spheres, const BVH& bvh)
+{
+	size_t count = bvh.primIndices.size();
+	centerX.assign(count + PADDING, 0.0f);
+	centerY.assign(count + PADDING, 0.0f);
+	centerZ.assign(count + PADDING, 0.0f);
+	radius.assign(count + PADDING, 0.0f);
+	sphereIndex.assign(count + PADDING, 0);
+	for(size_t i = 0; i < count; i++)
+	{
+		const Sphere& sphere = spheres[bvh.primIndices[i]];
+		centerX[i] = sphere.center.x;
+		centerY[i] = sphere.center.y;
+		centerZ[i] = sphere.center.z;
+		radius[i] = sphere.radius;
+		sphereIndex[i] = bvh.primIndices[i];
+	}
+
+	// children always come after their parent, so walking backwards sees them first
+	size_t nodeCount = bvh.nodes.size();
+	rangeFirst.resize(nodeCount);
+	rangeCount.resize(nodeCount);
+	for(size_t i = nodeCount; i-- > 0;)
+	{
+		const BVHNode& node = bvh.nodes[i];
+		// the root of an empty scene has no primitives and no children either
+		if(node.isLeaf() || node.leftFirst <= i)
+		{
+			rangeFirst[i] = node.leftFirst;
+			rangeCount[i] = node.primCount;
+		}
+		else
+		{
+			rangeFirst[i] = rangeFirst[node.leftFirst];
+			rangeCount[i] = rangeCount[node.leftFirst] + rangeCount[node.leftFirst + 1];
+		}
+	}
+}
+
+void SphereSoA::update(const std::vector<Sphere>& spheres, const BVH& bvh)
+{
+	for(size_t i = 0; i < bvh.primIndices.size(); i++)
+	{
+		const Sphere& sphere = spheres[bvh.primIndices[i]];
+		centerX[i] = sphere.center.x;
+		centerY[i] = sphere.center.y;
+		centerZ[i] = sphere.center.z;
+		radius[i] = sphere.radius;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BVH.h"
+#include "Sphere.h"
+
+
+// The spheres of a scene as separate arrays, for the SIMD traversal of the CPU backend (SimdTraversal.h).
+// They are stored in BVH order (the order of bvh.primIndices), so the spheres below any node are
+// one contiguous range and a few of them at a time load straight into a register.
+struct SphereSoA
+{
+	// lanes past the last sphere are loaded but masked off, the arrays are padded so the loads stay in bounds
+	static const int PADDING = 16;
+
+	void build(const std::vector<Sphere>& spheres, const BVH& bvh);
+	// only copies the centers and radii again, for spheres that moved but kept their BVH (BVH::refit())
+	void update(const std::vector<Sphere>& spheres, const BVH& bvh);
+
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	// index into the scene's spheres, which is where the material of a hit is looked up
+	std::vector<uint32_t> sphereIndex;
+
+	// the spheres of the whole subtree of every BVH node, small subtrees are tested in one go
+	std::vector<uint32_t> rangeFirst;
+	std::vector<uint32_t> rangeCount;
+};
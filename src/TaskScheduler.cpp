@@ -0,0 +1,132 @@
+#include "TaskScheduler.h"
+
+
+TaskScheduler::TaskScheduler(unsigned int threadCount)
+{
+	if(threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if(threadCount == 0)
+		threadCount = 1;
+
+	queues.reset(new Queue[threadCount]);
+	for(unsigned int i = 0; i < threadCount - 1; i++)
+		workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for(std::thread& worker : workers)
+		worker.join();
+}
+
+void TaskScheduler::run(const Task& root)
+{
+	std::lock_guard<std::mutex> runLock(runMutex);
+	runLocked(root);
+}
+
+bool TaskScheduler::tryRun(const Task& root)
+{
+	std::unique_lock<std::mutex> runLock(runMutex, std::try_to_lock);
+	if(!runLock.owns_lock())
+		return false;
+	runLocked(root);
+	return true;
+}
+
+void TaskScheduler::runLocked(const Task& root)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		busyWorkers = (unsigned int)workers.size();
+		generation++;
+		active = true;
+	}
+	wake.notify_all();
+
+	// the caller is the last thread of the scheduler
+	root((unsigned int)workers.size());
+
+	// root has waited for everything it spawned, so the queues are empty again
+	active = false;
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void TaskScheduler::spawn(unsigned int thread, Group& group, Task task)
+{
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+	Queue& queue = queues[thread];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.entries.push_back({std::move(task), &group});
+}
+
+void TaskScheduler::wait(unsigned int thread, Group& group)
+{
+	while(group.pending.load(std::memory_order_acquire) > 0)
+		if(!runOne(thread))
+			std::this_thread::yield();
+}
+
+void TaskScheduler::workerLoop(unsigned int thread)
+{
+	unsigned int seenGeneration = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+			if(quit)
+				return;
+			seenGeneration = generation;
+		}
+
+		while(active)
+			if(!runOne(thread))
+				std::this_thread::yield();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(--busyWorkers == 0)
+			done.notify_one();
+	}
+}
+
+bool TaskScheduler::runOne(unsigned int thread)
+{
+	Entry entry;
+	bool found = false;
+	{
+		Queue& own = queues[thread];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if(!own.entries.empty())
+		{
+			entry = std::move(own.entries.back());
+			own.entries.pop_back();
+			found = true;
+		}
+	}
+
+	unsigned int threadCount = size();
+	for(unsigned int i = 1; i < threadCount && !found; i++)
+	{
+		Queue& victim = queues[(thread + i) % threadCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(!victim.entries.empty())
+		{
+			entry = std::move(victim.entries.front());
+			victim.entries.pop_front();
+			found = true;
+		}
+	}
+	if(!found)
+		return false;
+
+	entry.task(thread);
+	entry.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+	return true;
+}
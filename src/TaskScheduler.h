@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Worker threads for fork-join work of uneven size, like the subtrees of a BVH build, where
+// ThreadPool's even split would leave most threads waiting for the biggest piece.
+// Every thread has a deque of tasks. It pushes the tasks it spawns to the back and takes its next
+// one from there too, so it stays on the work it just split. Threads without work steal from the
+// front of another thread's deque, which holds the oldest and for recursive work the biggest tasks.
+class TaskScheduler
+{
+public:
+	typedef std::function<void(unsigned int thread)> Task;
+
+	// the tasks spawned into a group, wait() until they are done before the group goes away
+	struct Group
+	{
+		std::atomic<unsigned int> pending{0};
+	};
+
+	// threadCount includes the calling thread, 0 means one per hardware thread
+	explicit TaskScheduler(unsigned int threadCount = 0);
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	// Runs root on the calling thread, as thread size() - 1, with the workers helping with every task
+	// it spawns, and returns when root does. Only one run can be in progress, tryRun() returns false
+	// without running root if another thread has one going.
+	void run(const Task& root);
+	bool tryRun(const Task& root);
+
+	// only from inside run(), thread is the one the caller runs on
+	void spawn(unsigned int thread, Group& group, Task task);
+	// runs tasks, this thread's own ones first, until every task of group has finished
+	void wait(unsigned int thread, Group& group);
+
+	unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+private:
+	struct Entry
+	{
+		Task task;
+		Group* group;
+	};
+	// one per thread, on its own cache line so the locks of neighbours don't share one
+	struct alignas(64) Queue
+	{
+		std::mutex mutex;
+		std::deque<Entry> entries;
+	};
+
+	void runLocked(const Task& root);
+	void workerLoop(unsigned int thread);
+	// runs one task, false if there was none to take or steal
+	bool runOne(unsigned int thread);
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<Queue[]> queues;
+
+	// one run at a time
+	std::mutex runMutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::atomic<bool> active{false};
+	unsigned int generation = 0;
+	unsigned int busyWorkers = 0;
+	bool quit = false;
+};
@@ -0,0 +1,75 @@
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if(threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if(threadCount == 0)
+		threadCount = 1;
+
+	for(unsigned int i = 0; i < threadCount - 1; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for(std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int)>& job)
+{
+	if(count == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentJob = &job;
+		jobCount = count;
+		nextJob = 0;
+		busyWorkers = (unsigned int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	// the caller is the last thread of the pool
+	runJobs((unsigned int)workers.size());
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+	currentJob = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned int thread)
+{
+	unsigned int seenGeneration = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+			if(quit)
+				return;
+			seenGeneration = generation;
+		}
+
+		runJobs(thread);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if(--busyWorkers == 0)
+			done.notify_one();
+	}
+}
+
+void ThreadPool::runJobs(unsigned int thread)
+{
+	unsigned int index;
+	while((index = nextJob.fetch_add(1)) < jobCount)
+		(*currentJob)(index, thread);
+}
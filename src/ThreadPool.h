@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed set of worker threads that stay alive between frames.
+// parallelFor() hands out the indices [0, count) one at a time, so faster
+// threads simply pick up more work. The calling thread joins in as well.
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread, 0 means one per hardware thread
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// blocks until job(index, thread) has been run for every index
+	void parallelFor(unsigned int count, const std::function<void(unsigned int index, unsigned int thread)>& job);
+
+	unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+private:
+	void workerLoop(unsigned int thread);
+	void runJobs(unsigned int thread);
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(unsigned int, unsigned int)>* currentJob = nullptr;
+	unsigned int jobCount = 0;
+	std::atomic<unsigned int> nextJob{0};
+	unsigned int generation = 0;
+	unsigned int busyWorkers = 0;
+	bool quit = false;
+};
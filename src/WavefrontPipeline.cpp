@@ -0,0 +1,207 @@
+#include "WavefrontPipeline.h"
+
+#include "ShaderReloader.h"
+#include "logger.h"
+
+
+// mirrors PathState in shaders/include/wavefront.glsl (std430)
+struct PathState
+{
+	glm::vec3 origin;
+	GLuint    rngState;
+	glm::vec3 direction;
+	GLuint    depth;
+	glm::vec3 throughput;
+	GLuint    hitPrim;
+	glm::vec3 sampleSum;
+	float     hitT;
+	GLuint    hitObject;
+	// std430 rounds the struct up to the 16 byte alignment of its vec3s
+	GLuint    padding[3];
+};
+static_assert(sizeof(PathState) == 80, "PathState has to match the std430 layout in the shader");
+
+// mirrors WavefrontCounters, extendCount, queuedCount and one count per material
+const GLsizeiptr COUNTER_BUFFER_SIZE = (2 + WavefrontPipeline::MATERIAL_COUNT) * sizeof(GLuint);
+// a DispatchIndirectCommand for extend and one per material
+const GLsizeiptr DISPATCH_ARGS_SIZE = (1 + WavefrontPipeline::MATERIAL_COUNT) * 3 * sizeof(GLuint);
+
+// every stage reads what the one before wrote, and the dispatch sizes come out of a buffer too
+const GLbitfield STAGE_BARRIER = GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+
+
+WavefrontPipeline::WavefrontPipeline(ProgramCache& programCache)
+	: programCache(&programCache)
+{
+	createStage(generate, "../src/shaders/wavefront/Generate.comp");
+	createStage(extend, "../src/shaders/wavefront/Extend.comp");
+	for(int material = 0; material < MATERIAL_COUNT; material++)
+		createStage(shade[material], "../src/shaders/wavefront/Shade.comp", {"SHADE_MATERIAL " + std::to_string(material)});
+	createStage(dispatch, "../src/shaders/wavefront/Dispatch.comp");
+	createStage(finalize, "../src/shaders/wavefront/Finalize.comp");
+
+	glCreateBuffers(1, &counterBuffer);
+	glNamedBufferStorage(counterBuffer, COUNTER_BUFFER_SIZE, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(1, &dispatchArgsBuffer);
+	glNamedBufferStorage(dispatchArgsBuffer, DISPATCH_ARGS_SIZE, nullptr, 0);
+}
+
+void WavefrontPipeline::release()
+{
+	Stage* stages[] = {&generate, &extend, &shade[0], &shade[1], &shade[2], &dispatch, &finalize};
+	for(Stage* stage : stages)
+	{
+		stage->program.release();
+		if(reloader && stage->reloadId >= 0)
+			reloader->unwatch(stage->reloadId);
+		stage->reloadId = -1;
+	}
+
+	GLuint buffers[] = {pathBuffer, rayQueues[0], rayQueues[1], materialQueueBuffer, counterBuffer, dispatchArgsBuffer};
+	glDeleteBuffers(6, buffers);
+	pathBuffer = rayQueues[0] = rayQueues[1] = materialQueueBuffer = counterBuffer = dispatchArgsBuffer = 0;
+	pathCapacity = 0;
+}
+
+void WavefrontPipeline::createStage(Stage& stage, const char* path, std::vector<std::string> defines)
+{
+	stage.path = path;
+	stage.defines = std::move(defines);
+	stage.program = programCache->load({{GL_COMPUTE_SHADER, path, readShaderSource(path, stage.defines)}});
+}
+
+void WavefrontPipeline::setShaderReloader(ShaderReloader* shaderReloader)
+{
+	reloader = shaderReloader;
+	Stage* stages[] = {&generate, &extend, &shade[0], &shade[1], &shade[2], &dispatch, &finalize};
+	for(Stage* stage : stages)
+		stage->reloadId = reloader->watch({{{GL_COMPUTE_SHADER, stage->path}}, stage->defines});
+}
+
+void WavefrontPipeline::setScreenFormat(ScreenFormat format)
+{
+	requestedFormat = format;
+	finalize.defines = {std::string("SCREEN_FORMAT ") + glslFormat(format)};
+	if(reloader)
+	{
+		// the old stage keeps running until collectReloads() finds the new one
+		reloader->setDefines(finalize.reloadId, finalize.defines);
+		if(format != finalizeFormat)
+			reloader->requestBuild(finalize.reloadId);
+		return;
+	}
+
+	ShaderProgram old = finalize.program;
+	createStage(finalize, "../src/shaders/wavefront/Finalize.comp", finalize.defines);
+	old.release();
+	finalizeFormat = format;
+}
+
+void WavefrontPipeline::collectReloads()
+{
+	if(!reloader)
+		return;
+
+	Stage* stages[] = {&generate, &extend, &shade[0], &shade[1], &shade[2], &dispatch, &finalize};
+	for(Stage* stage : stages)
+	{
+		ShaderProgram reloaded;
+		if(reloader->takeReloaded(stage->reloadId, reloaded))
+		{
+			stage->program.release();
+			stage->program = reloaded;
+			// the reloader only hands out builds with the latest defines
+			if(stage == &finalize)
+				finalizeFormat = requestedFormat;
+		}
+	}
+}
+
+void WavefrontPipeline::reserve(size_t pathCount)
+{
+	if(pathCount <= pathCapacity)
+		return;
+
+	GLuint buffers[] = {pathBuffer, rayQueues[0], rayQueues[1], materialQueueBuffer};
+	if(pathBuffer)
+		glDeleteBuffers(4, buffers);
+
+	pathCapacity = pathCount;
+	glCreateBuffers(1, &pathBuffer);
+	glNamedBufferStorage(pathBuffer, pathCapacity * sizeof(PathState), nullptr, 0);
+	glCreateBuffers(2, rayQueues);
+	glNamedBufferStorage(rayQueues[0], pathCapacity * sizeof(GLuint), nullptr, 0);
+	glNamedBufferStorage(rayQueues[1], pathCapacity * sizeof(GLuint), nullptr, 0);
+	glCreateBuffers(1, &materialQueueBuffer);
+	glNamedBufferStorage(materialQueueBuffer, MATERIAL_COUNT * pathCapacity * sizeof(GLuint), nullptr, 0);
+
+	logger::Log(logger::LogLevel::DEBUG, "Wavefront buffers sized for " + std::to_string(pathCapacity) + " paths");
+}
+
+void WavefrontPipeline::render(const RenderSettings& settings, glm::ivec2 renderSize, unsigned int materialMask)
+{
+	reserve((size_t)renderSize.x * renderSize.y);
+
+	GLuint zero = 0;
+	glClearNamedBufferData(counterBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, pathBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, materialQueueBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, counterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, dispatchArgsBuffer);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, dispatchArgsBuffer);
+
+	extend.program.set("pathCapacity", (unsigned int)pathCapacity);
+	for(Stage& stage : shade)
+		stage.program.set("pathCapacity", (unsigned int)pathCapacity);
+
+	// the queue written by one stage is read by the next, they trade places before every extend
+	int outQueue = 0;
+	auto swapQueues = [&]()
+	{
+		outQueue = 1 - outQueue;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, rayQueues[1 - outQueue]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, rayQueues[outQueue]);
+	};
+
+	glm::ivec2 groups = (renderSize + glm::ivec2(7)) / 8;
+	for(int sample = 0; sample < settings.numSamples; sample++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, rayQueues[outQueue]);
+		generate.program.set("sampleIndex", (unsigned int)sample);
+		generate.program.use();
+		glDispatchCompute(groups.x, groups.y, 1);
+		glMemoryBarrier(STAGE_BARRIER);
+
+		for(int bounce = 0; bounce < settings.maxDepth; bounce++)
+		{
+			swapQueues();
+
+			dispatch.program.set("stage", 0u);
+			dispatch.program.use();
+			glDispatchCompute(1, 1, 1);
+			glMemoryBarrier(STAGE_BARRIER);
+
+			extend.program.use();
+			glDispatchComputeIndirect(0);
+			glMemoryBarrier(STAGE_BARRIER);
+
+			dispatch.program.set("stage", 1u);
+			dispatch.program.use();
+			glDispatchCompute(1, 1, 1);
+			glMemoryBarrier(STAGE_BARRIER);
+
+			for(int material = 0; material < MATERIAL_COUNT; material++)
+			{
+				if(!(materialMask & (1u << material)))
+					continue;
+				shade[material].program.use();
+				glDispatchComputeIndirect((1 + material) * 3 * sizeof(GLuint));
+			}
+			glMemoryBarrier(STAGE_BARRIER);
+		}
+	}
+
+	finalize.program.use();
+	glDispatchCompute(groups.x, groups.y, 1);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "GLItems.h"
+#include "ProgramCache.h"
+#include "RenderSettings.h"
+#include "RenderTarget.h"
+
+class ShaderReloader;
+
+
+// The kernel split into its stages (shaders/wavefront/), with the paths kept in buffers in between:
+// generate camera rays, extend them to the next hit, shade every material with a kernel of its own,
+// and finally average the samples into the accumulation. The stages hand paths to each other through
+// queues filled with atomic counters, and Dispatch.comp turns the counters into indirect dispatch
+// sizes, so the lanes of a dispatch all do the same work and dead paths are never dispatched again.
+// Expects the scene, the target images and RenderParams to be bound already (see GPURaytracer).
+class WavefrontPipeline
+{
+public:
+	static const int GROUP_SIZE = 64;     // WAVEFRONT_GROUP_SIZE
+	static const int MATERIAL_COUNT = 3;  // LAMBERT, METAL, DIELECTRIC
+
+	// programCache has to outlive the pipeline
+	explicit WavefrontPipeline(ProgramCache& programCache);
+	void release();
+
+	// rebuilds the stages on the reloader when their files change, it has to outlive the pipeline
+	void setShaderReloader(ShaderReloader* shaderReloader);
+	// rebuilds Finalize.comp, the only stage that touches the images, in the background with a reloader
+	void setScreenFormat(ScreenFormat format);
+	// what the running Finalize.comp writes, it changes when collectReloads() swaps in the new one
+	ScreenFormat screenFormat() const { return finalizeFormat; }
+	// swaps in the stages the reloader has finished, before binding the images for render()
+	void collectReloads();
+
+	// materialMask skips the shade kernels of materials the scene doesn't have
+	void render(const RenderSettings& settings, glm::ivec2 renderSize, unsigned int materialMask);
+
+private:
+	struct Stage
+	{
+		ShaderProgram program;
+		std::string path;
+		std::vector<std::string> defines;
+		int reloadId = -1;
+	};
+
+	void createStage(Stage& stage, const char* path, std::vector<std::string> defines = {});
+	void reserve(size_t pathCount);
+
+	ProgramCache* programCache;
+	ShaderReloader* reloader = nullptr;
+
+	Stage generate;
+	Stage extend;
+	Stage shade[MATERIAL_COUNT];
+	Stage dispatch;
+	Stage finalize;
+	ScreenFormat finalizeFormat = ScreenFormat::RGBA8;
+	ScreenFormat requestedFormat = ScreenFormat::RGBA8;
+
+	GLuint pathBuffer = 0;
+	GLuint rayQueues[2] = {};
+	GLuint materialQueueBuffer = 0;
+	GLuint counterBuffer = 0;
+	GLuint dispatchArgsBuffer = 0;
+	size_t pathCapacity = 0;
+};
@@ -1,5 +1,8 @@
 #include "logger.h"
 #include <chrono>
+#include <ctime>
+#include <mutex>
+#include <string>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -7,60 +10,83 @@
 
 
 namespace logger{
+	// Log is called from worker threads as well (shader reloads, BVH rebuilds, the capture writer), so
+	// a line is put together on its own and written in one go under this, lines can't interleave then
+	static std::mutex outputMutex;
+
+	// in the format of "Www Mmm dd HH:MM:SS yyyy", like ctime() but without its shared buffer
+	static std::string timeString()
+	{
+		std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		std::tm local;
+#ifdef _WIN32
+		localtime_s(&local, &now);
+#else
+		localtime_r(&now, &local);
+#endif
+		char buffer[32];
+		std::strftime(buffer, sizeof(buffer), "%a %b %e %H:%M:%S %Y", &local);
+		return buffer;
+	}
+
 	void Log(LogLevel level, const std::string &message)
 	{
-		// also print out the time, in the format of "HH:MM:SS"
-		auto time = std::chrono::system_clock::now();
-		auto intime = std::chrono::system_clock::to_time_t(time);
-		std::string time_str = std::ctime(&intime);
-		time_str.erase(time_str.end() - 1);
-		std::cout << "[" << time_str << "]" << " ";
+		// also print out the time
+		std::string line = "[" + timeString() + "] ";
 		// set the color of the output based on the log LogLevel
+#ifdef _WIN32
+		WORD color = 0;
+#endif
 		switch (level)
 		{
 		case LogLevel::DEBUG:
 #ifdef _WIN32
-			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_GREEN);
+			color = FOREGROUND_GREEN;
 #else
-			std::cout << "\033[1;32m";
+			line += "\033[1;32m";
 #endif
-			std::cout << "DEBUG";
+			line += "DEBUG";
 			break;
 		case LogLevel::INFO:
 #ifdef _WIN32
-			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_BLUE);
+			color = FOREGROUND_BLUE;
 #else
-			std::cout << "\033[1;34m";
+			line += "\033[1;34m";
 #endif
-			std::cout << "INFO ";
+			line += "INFO ";
 			break;
 		case LogLevel::WARNING:
 #ifdef _WIN32
-			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_YELLOW);
+			color = FOREGROUND_YELLOW;
 #else
-			std::cout << "\033[1;33m";
+			line += "\033[1;33m";
 #endif
-			std::cout << "WARN ";
+			line += "WARN ";
 			break;
 		case LogLevel::ERROR:
 #ifdef _WIN32
-			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED);
+			color = FOREGROUND_RED;
 #else
-			std::cout << "\033[1;31m";
+			line += "\033[1;31m";
 #endif
-			std::cout << "ERROR";
+			line += "ERROR";
 			break;
 		case LogLevel::FATAL:
 #ifdef _WIN32
-			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_INTENSITY);
+			color = FOREGROUND_RED | FOREGROUND_INTENSITY;
 #else
-			std::cout << "\033[1;35m";
+			line += "\033[1;35m";
 #endif
-			std::cout << "FATAL";
+			line += "FATAL";
 			break;
 		}
-		// print the message
-		std::cout << " "<< message << "\033[0m" << std::endl;
+		// the message
+		line += " " + message + "\033[0m\n";
 
+		std::lock_guard<std::mutex> lock(outputMutex);
+#ifdef _WIN32
+		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), color);
+#endif
+		std::cout << line << std::flush;
 	}
 }
@@ -7,18 +7,25 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
 #include "logger.h"
 #include "GLItems.h"
+#include "CPURaytracer.h"
+#include "FrameCapture.h"
+#include "GPURaytracer.h"
+#include "Offline.h"
+#include "Options.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
+#include "RenderTarget.h"
+#include "ShaderReloader.h"
+#include "Scene.h"
 
 #include <imgui.h>
 
 
 
-const unsigned int SCR_WIDTH = 800;
-const unsigned int SCR_HEIGHT = 400;
-
-const unsigned short OPENGL_MAJOR_VERSION = 4;
-const unsigned short OPENGL_MINOR_VERSION = 6;
 
 
 GLfloat ScreenTriVert[] =
@@ -38,9 +45,32 @@ GLuint ScreenTriIndices[] =
 glm::vec3 cameraPos = glm::vec3(13.0f, 2.0f, 3.0f);
 glm::vec3 lookingAt = glm::vec3(0.0f, 0.0f, 0.0f);
 bool rotate = false;
+// swirls the spheres around the y axis, the inner ones faster, which keeps the BVH refitting
+bool animate = false;
 
 bool vSync = true;
 
+// work group shapes the compute shader can be built with, the best one differs per device
+const glm::ivec2 WORK_GROUP_SHAPES[] = {glm::ivec2(8, 4), glm::ivec2(8, 8), glm::ivec2(16, 16), glm::ivec2(32, 1)};
+const char* WORK_GROUP_NAMES[] = {"8x4", "8x8", "16x16", "32x1"};
+
+// dynamic resolution: scale the internal resolution so the raytracing takes about targetFrameTime
+bool dynamicResolution = false;
+float targetFrameTime = 16.0f; // in ms
+float renderScale = 1.0f;
+const float MIN_RENDER_SCALE = 0.25f;
+
+// set by framebuffer_size_callback, the render target is recreated at the start of the next frame
+bool framebufferResized = false;
+glm::ivec2 framebufferSize = glm::ivec2(0);
+
+// which backend fills screenTex, the compute shader or the CPU port of it
+Backend backend = Backend::GPU;
+
+// frame stages timed by the profiler
+enum FrameStage { STAGE_RAYTRACE, STAGE_SCREEN, STAGE_IMGUI, STAGE_SWAP };
+bool showProfiler = false;
+
 void error_callback(int error, const char* description)
 {
 	logger::Log(logger::LogLevel::ERROR, std::string("GLFW error: ") + description);
@@ -50,6 +80,28 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	logger::Log(logger::LogLevel::INFO, std::string("Framebuffer size changed to ") + std::to_string(width) + "x" + std::to_string(height));
 	glViewport(0, 0, width, height);
+	framebufferSize = glm::ivec2(width, height);
+	framebufferResized = true;
+}
+
+// New render scale after a frame took frameTime ms at the current one. The cost is roughly
+// proportional to the pixel count, so the scale follows the square root of the ratio.
+float adjustRenderScale(float scale, float frameTime)
+{
+	if(frameTime <= 0.0f)
+		return scale;
+
+	float ideal = scale * std::sqrt(targetFrameTime / frameTime);
+	// only move part of the way there, so a single slow frame doesn't make it jump around
+	float next = scale + (ideal - scale) * 0.25f;
+	return glm::clamp(next, MIN_RENDER_SCALE, 1.0f);
+}
+
+// render size for a scale, in steps of 1/32 so the accumulation isn't thrown away for every tiny change
+glm::ivec2 scaledRenderSize(glm::ivec2 size, float scale)
+{
+	float steppedScale = std::round(scale * 32.0f) / 32.0f;
+	return glm::max(glm::ivec2(glm::vec2(size) * steppedScale), glm::ivec2(1));
 }
 
 void input_callback(GLFWwindow* window)
@@ -84,15 +136,31 @@ std::vector<GLuint> alltheobjects(GLfloat (&Vertices)[], GLuint Indicies[])
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
+	// for the time to first frame, which is mostly shader compilation without a warm cache
+	auto launchTime = std::chrono::high_resolution_clock::now();
+	bool firstFrame = true;
+
+	Options options;
+	if(!parseOptions(argc, argv, options))
+		return options.help ? EXIT_SUCCESS : EXIT_FAILURE;
+	BVH::buildSettings = {options.bvhLeafSize, options.bvhBins};
+
+	if(options.headless)
+		return renderOffline(options);
+
+	cameraPos = options.lookFrom;
+	lookingAt = options.lookAt;
+	backend = options.backend;
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OPENGL_MAJOR_VERSION);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OPENGL_MINOR_VERSION);
 	glfwWindowHint(GLFW_OPENGL_CORE_PROFILE, GL_TRUE);
 	glfwSetErrorCallback(error_callback);
 
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Raytracing In OpenGL", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(options.width, options.height, "Raytracing In OpenGL", NULL, NULL);
 	logger::Log(logger::LogLevel::INFO, std::string("GL window created with OpenGL version ") + std::to_string(OPENGL_MAJOR_VERSION) + "." + std::to_string(OPENGL_MINOR_VERSION));
 
 	if(!window)
@@ -123,7 +191,8 @@ int main()
 
 	logger::Log(logger::LogLevel::INFO, std::string("GLAD initialized"));
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+	glfwGetFramebufferSize(window, &framebufferSize.x, &framebufferSize.y);
+	glViewport(0, 0, framebufferSize.x, framebufferSize.y);
 
 	GLuint VAO, VBO, EBO;
 
@@ -132,26 +201,29 @@ int main()
 	VBO = objects[1];
 	EBO = objects[2];
 
-	GLuint screenTex;
-	glCreateTextures(GL_TEXTURE_2D, 1, &screenTex);
-	glTextureParameteri(screenTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(screenTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureParameteri(screenTex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTextureParameteri(screenTex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTextureStorage2D(screenTex, 1, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT);
-	glBindImageTexture(0, screenTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-	GLuint screenVertexShader = loadShader("../src/shaders/ScreenVertexShader.vert", GL_VERTEX_SHADER);
-	GLuint screenFragmentShader = loadShader("../src/shaders/ScreenFragmentShader.frag", GL_FRAGMENT_SHADER);
-	GLuint screenShaderProgram = createShaderProgram(std::vector<GLuint>{screenVertexShader, screenFragmentShader});
-
-	DeleteGLItem(screenVertexShader);
-	DeleteGLItem(screenFragmentShader);
-
-	GLuint ComputeShader = loadShader("../src/shaders/ComputeShader.comp", GL_COMPUTE_SHADER);
-	GLuint ComputeShaderProgram = createShaderProgram({ComputeShader});
-
-	DeleteGLItem(ComputeShader);
+	RenderTarget renderTarget;
+	renderTarget.setScreenFormat(options.screenFormat);
+	renderTarget.create(framebufferSize);
+
+	ProgramCache programCache(options.shaderCache);
+	ShaderProgram screenShaderProgram = programCache.load({
+		{GL_VERTEX_SHADER, "../src/shaders/ScreenVertexShader.vert", readShaderSource("../src/shaders/ScreenVertexShader.vert")},
+		{GL_FRAGMENT_SHADER, "../src/shaders/ScreenFragmentShader.frag", readShaderSource("../src/shaders/ScreenFragmentShader.frag")},
+	});
+	screenShaderProgram.set("screen", 0);
+
+	GPURaytracer gpuRaytracer(programCache, glm::ivec2(DEFAULT_LOCAL_SIZE_X, DEFAULT_LOCAL_SIZE_Y));
+	gpuRaytracer.setPipeline(options.pipeline);
+	gpuRaytracer.setScreenFormat(options.screenFormat);
+
+	// edited shaders are rebuilt in the background and swapped in at the start of the next frame
+	ShaderReloader shaderReloader(window, "../src/shaders", programCache);
+	int screenReloadId = shaderReloader.watch({{
+		{GL_VERTEX_SHADER, "../src/shaders/ScreenVertexShader.vert"},
+		{GL_FRAGMENT_SHADER, "../src/shaders/ScreenFragmentShader.frag"},
+	}, {}});
+	// the kernels, and their rebuilds for another work group shape or screen format, are built on the reloader's thread as well
+	gpuRaytracer.setShaderReloader(&shaderReloader);
 
 	int workGroupCurrent[3];
 	glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &workGroupCurrent[0]);
@@ -186,8 +258,39 @@ int main()
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init("#version 460");
 
-	int MAXDEPTH = 2;
-	int NUM_SAMPLES = 2;
+	int MAXDEPTH = options.maxDepth;
+	int NUM_SAMPLES = options.samples;
+
+	Scene scene(defaultSceneList());
+	if(!options.scene.empty() && !scene.load(options.scene))
+		logger::Log(logger::LogLevel::WARNING, "Rendering the default scene instead of " + options.scene);
+
+	CPURaytracer cpuRaytracer(options.threads);
+	cpuRaytracer.setSimdBackend(selectedSimdBackend(options));
+	std::vector<float> cpuPixels;
+	logger::Log(logger::LogLevel::DEBUG, std::string("CPU raytracer threads: ") + std::to_string(cpuRaytracer.threadCount()) + ", SIMD: " + (cpuRaytracer.simdBackend() ? cpuRaytracer.simdBackend()->name : "off"));
+
+	int selectedSphere = 0;
+	int selectedInstance = 0;
+
+	FrameCapture frameCapture;
+	int captureFormat = (int)CaptureFormat::PNG;
+	char captureOutput[256] = "capture";
+
+	// accumulation starts over whenever anything that changes the image changes
+	unsigned int frameIndex = 0;
+	glm::vec3 lastCameraPos = cameraPos;
+	glm::vec3 lastLookingAt = lookingAt;
+	int lastMaxDepth = MAXDEPTH;
+	unsigned int lastSceneVersion = scene.version();
+	Backend lastBackend = backend;
+
+	Profiler profiler({
+		{"Raytrace", true},
+		{"Screen", true},
+		{"ImGui", true},
+		{"Swap", false},
+	});
 
 	while(!glfwWindowShouldClose(window))
 	{
@@ -202,21 +305,85 @@ int main()
 					0.0,  0.0,        0.0, 1.0);
 			cameraPos = glm::vec3(rotationMatrix * glm::vec4(cameraPos, 1.0));
 		}
-		glUseProgram(ComputeShaderProgram);
-		// time elapsed since the beginning of the program
-		glUniform1f(glGetUniformLocation(ComputeShaderProgram, "time"), glfwGetTime());
-		glUniform3f(glGetUniformLocation(ComputeShaderProgram, "lookFrom"), cameraPos.x, cameraPos.y, cameraPos.z);
-		glUniform3f(glGetUniformLocation(ComputeShaderProgram, "lookAt"), lookingAt.x, lookingAt.y, lookingAt.z);
-		glUniform1iv(glGetUniformLocation(ComputeShaderProgram, "MAXDEPTHi"), 1, &MAXDEPTH);
-		glUniform1iv(glGetUniformLocation(ComputeShaderProgram, "NUMSAMPLESi"), 1, &NUM_SAMPLES);
-		glDispatchCompute(ceil(SCR_WIDTH / 8), ceil(SCR_HEIGHT / 4), 1);
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-		glUseProgram(screenShaderProgram);
-		glBindTextureUnit(0, screenTex);
-		glUniform1i(glGetUniformLocation(screenShaderProgram, "screenTex"), 0);
+		if(animate)
+		{
+			for(Sphere& sphere : scene.spheres)
+			{
+				float angle = 0.05f / (1.0f + glm::length(glm::vec2(sphere.center.x, sphere.center.z)));
+				float c = cos(angle), s = sin(angle);
+				sphere.center = glm::vec3(c * sphere.center.x + s * sphere.center.z, sphere.center.y, -s * sphere.center.x + c * sphere.center.z);
+			}
+			scene.refit();
+		}
+		if(framebufferResized)
+		{
+			framebufferResized = false;
+			// minimized windows have a 0x0 framebuffer, keep the old target until it comes back
+			if(framebufferSize.x > 0 && framebufferSize.y > 0 && framebufferSize != renderTarget.size())
+			{
+				renderTarget.create(framebufferSize);
+				renderTarget.setRenderSize(scaledRenderSize(renderTarget.size(), renderScale));
+				frameIndex = 0;
+			}
+		}
+
+		profiler.beginFrame();
+
+		ShaderProgram reloaded;
+		if(shaderReloader.takeReloaded(screenReloadId, reloaded))
+		{
+			screenShaderProgram.release();
+			screenShaderProgram = reloaded;
+			screenShaderProgram.set("screen", 0);
+		}
+		if(gpuRaytracer.collectReloads())
+			frameIndex = 0;
+		// how long the raytracing itself took, the GPU time lags a few frames behind
+		float renderTime = backend == Backend::GPU ? profiler.gpuTime(STAGE_RAYTRACE) : profiler.cpuTime(STAGE_RAYTRACE);
+		// captures need every frame at the size they started with
+		if(dynamicResolution && !frameCapture.active())
+			renderScale = adjustRenderScale(renderScale, renderTime);
+		else
+			renderScale = 1.0f;
+		if(renderTarget.setRenderSize(scaledRenderSize(renderTarget.size(), renderScale)))
+			frameIndex = 0;
+		glm::ivec2 renderSize = renderTarget.renderSize();
+
+		if(cameraPos != lastCameraPos || lookingAt != lastLookingAt || MAXDEPTH != lastMaxDepth || scene.version() != lastSceneVersion || backend != lastBackend)
+		{
+			frameIndex = 0;
+			lastCameraPos = cameraPos;
+			lastLookingAt = lookingAt;
+			lastMaxDepth = MAXDEPTH;
+			lastSceneVersion = scene.version();
+			lastBackend = backend;
+		}
+
+		RenderSettings settings = {cameraPos, lookingAt, MAXDEPTH, NUM_SAMPLES, frameIndex};
+		profiler.beginStage(STAGE_RAYTRACE);
+		if(backend == Backend::GPU)
+			gpuRaytracer.render(scene, settings, renderTarget);
+		else
+		{
+			cpuRaytracer.render(scene, settings, renderSize.x, renderSize.y, cpuPixels);
+			// uploads work with any format
+			renderTarget.setScreenFormat(gpuRaytracer.screenFormat());
+			renderTarget.uploadScreen(cpuPixels);
+		}
+		profiler.endStage(STAGE_RAYTRACE);
+		frameIndex++;
+		// queues a copy, the frames the GPU has finished copying go to the writer thread
+		frameCapture.capture(renderTarget);
+		frameCapture.poll();
+
+		profiler.beginStage(STAGE_SCREEN);
+		screenShaderProgram.use();
+		// only the lower left renderSize pixels of screenTex are valid
+		screenShaderProgram.set("uvScale", glm::vec2(renderSize) / glm::vec2(renderTarget.size()));
+		glBindTextureUnit(0, renderTarget.screenTexture());
 		glBindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, sizeof(ScreenTriIndices) / sizeof(ScreenTriIndices[0]), GL_UNSIGNED_INT, 0);
+		profiler.endStage(STAGE_SCREEN);
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -225,6 +392,31 @@ int main()
 		ImGui::Begin("Settings");
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		ImGui::Checkbox("Rotate", &rotate);
+		ImGui::SameLine();
+		ImGui::Checkbox("Animate", &animate);
+		if(animate)
+			ImGui::Text("BVH cost after refit: %.2fx%s", scene.bvhCostGrowth(), scene.rebuildingBVH() ? ", rebuilding" : "");
+		ImGui::Checkbox("Profiler", &showProfiler);
+		ImGui::RadioButton("GPU", (int*)&backend, (int)Backend::GPU);
+		ImGui::SameLine();
+		ImGui::RadioButton("CPU", (int*)&backend, (int)Backend::CPU);
+		if(backend == Backend::CPU)
+		{
+			// 0 is the scalar port, then the SIMD backends in the order supportedSimdBackends() has them
+			const std::vector<const SimdBackend*>& simdBackends = supportedSimdBackends();
+			int simd = 0;
+			for(int i = 0; i < (int)simdBackends.size(); i++)
+				if(simdBackends[i] == cpuRaytracer.simdBackend())
+					simd = i + 1;
+			bool simdChanged = ImGui::RadioButton("Scalar", &simd, 0);
+			for(int i = 0; i < (int)simdBackends.size(); i++)
+			{
+				ImGui::SameLine();
+				simdChanged |= ImGui::RadioButton(simdBackends[i]->name, &simd, i + 1);
+			}
+			if(simdChanged)
+				cpuRaytracer.setSimdBackend(simd > 0 ? simdBackends[simd - 1] : nullptr);
+		}
 		ImGui::Text("Camera Position: %.3f %.3f %.3f", cameraPos.x, cameraPos.y, cameraPos.z);
 		ImGui::Text("Looking At: %.3f %.3f %.3f", lookingAt.x, lookingAt.y, lookingAt.z);
 		ImGui::SliderFloat3("Camera Position", &cameraPos.x, -10.0f, 10.0f);
@@ -235,11 +427,138 @@ int main()
 
 		ImGui::Text("Number of Samples: %d", NUM_SAMPLES);
 		ImGui::SliderInt("Number of Samples", &NUM_SAMPLES, 1, 10);
+		ImGui::Text("Accumulated frames: %u", frameIndex);
+
+		ImGui::Checkbox("Dynamic resolution", &dynamicResolution);
+		if(dynamicResolution && frameCapture.active())
+		{
+			ImGui::SameLine();
+			ImGui::Text("(paused while capturing)");
+		}
+		if(dynamicResolution)
+			ImGui::SliderFloat("Target render time (ms)", &targetFrameTime, 1.0f, 100.0f);
+		ImGui::Text("Render resolution: %dx%d (%.2f ms)", renderSize.x, renderSize.y, renderTime);
+
+		int workGroupShape = -1;
+		for(int i = 0; i < (int)(sizeof(WORK_GROUP_SHAPES) / sizeof(WORK_GROUP_SHAPES[0])); i++)
+			if(WORK_GROUP_SHAPES[i] == gpuRaytracer.localSize())
+				workGroupShape = i;
+		if(ImGui::Combo("Work group", &workGroupShape, WORK_GROUP_NAMES, sizeof(WORK_GROUP_NAMES) / sizeof(WORK_GROUP_NAMES[0])))
+		{
+			glm::ivec2 shape = WORK_GROUP_SHAPES[workGroupShape];
+			if(shape.x * shape.y <= workGroupInv)
+				gpuRaytracer.setLocalSize(shape);
+			else
+				logger::Log(logger::LogLevel::WARNING, std::string("Work group ") + WORK_GROUP_NAMES[workGroupShape] + " is larger than this device allows");
+		}
+
+		bool specialization = gpuRaytracer.specialization();
+		if(ImGui::Checkbox("Specialized kernels", &specialization))
+			gpuRaytracer.setSpecialization(specialization);
+		ImGui::Text("Kernel: %s (%d variants)", gpuRaytracer.usedVariant() ? "specialized" : "generic", (int)gpuRaytracer.variantCount());
+
+		int pipeline = (int)gpuRaytracer.pipeline();
+		bool pipelineChanged = ImGui::RadioButton("Megakernel", &pipeline, (int)GPUPipeline::MEGAKERNEL);
+		ImGui::SameLine();
+		pipelineChanged |= ImGui::RadioButton("Wavefront", &pipeline, (int)GPUPipeline::WAVEFRONT);
+		if(pipelineChanged)
+			gpuRaytracer.setPipeline((GPUPipeline)pipeline);
+
+		int screenFormat = (int)gpuRaytracer.screenFormat();
+		bool screenFormatChanged = ImGui::RadioButton("RGBA8", &screenFormat, (int)ScreenFormat::RGBA8);
+		ImGui::SameLine();
+		screenFormatChanged |= ImGui::RadioButton("RGBA16F", &screenFormat, (int)ScreenFormat::RGBA16F);
+		ImGui::SameLine();
+		screenFormatChanged |= ImGui::RadioButton("R11G11B10F", &screenFormat, (int)ScreenFormat::R11F_G11F_B10F);
+		ImGui::SameLine();
+		ImGui::Text("Screen");
+		// the GPU backend switches the screen once the kernel for the format is in
+		if(screenFormatChanged)
+			gpuRaytracer.setScreenFormat((ScreenFormat)screenFormat);
+		if(backend == Backend::GPU)
+		{
+			// the count trails the timing by a frame or two, which doesn't matter with the view held still
+			float raytraceTime = profiler.gpuTime(STAGE_RAYTRACE);
+			double raysPerSecond = raytraceTime > 0.0f ? gpuRaytracer.raysPerFrame() / (raytraceTime / 1000.0) : 0.0;
+			ImGui::Text("Rays: %.1f M/s", raysPerSecond / 1e6);
+		}
+		ImGui::Text("Shaders: %s", shaderReloader.status().c_str());
+
+		ImGui::Separator();
+		if(!frameCapture.active())
+		{
+			ImGui::RadioButton("PNG", &captureFormat, (int)CaptureFormat::PNG);
+			ImGui::SameLine();
+			ImGui::RadioButton("EXR", &captureFormat, (int)CaptureFormat::EXR);
+			ImGui::SameLine();
+			ImGui::RadioButton("Raw", &captureFormat, (int)CaptureFormat::RAW);
+			ImGui::InputText("Capture output", captureOutput, sizeof(captureOutput));
+			if(ImGui::Button("Start capture"))
+				frameCapture.start(captureOutput, (CaptureFormat)captureFormat, scaledRenderSize(renderTarget.size(), 1.0f));
+		}
+		else if(ImGui::Button("Stop capture"))
+			frameCapture.stop();
+		if(frameCapture.capturedFrames() > 0)
+			ImGui::Text("Captured %llu, written %llu, dropped %llu", (unsigned long long)frameCapture.capturedFrames(), (unsigned long long)frameCapture.writtenFrames(), (unsigned long long)frameCapture.droppedFrames());
+
+		ImGui::Separator();
+		ImGui::Text("Spheres: %d", (int)scene.spheres.size());
+		if(!scene.meshes.empty())
+		{
+			size_t triangles = 0;
+			for(const Mesh& mesh : scene.meshes)
+				triangles += mesh.triangleCount();
+			ImGui::Text("Meshes: %d (%zu triangles), instances: %d", (int)scene.meshes.size(), triangles, (int)scene.instances.size());
+		}
+		if(!scene.instances.empty())
+		{
+			selectedInstance = std::min(selectedInstance, (int)scene.instances.size() - 1);
+			ImGui::SliderInt("Instance", &selectedInstance, 0, (int)scene.instances.size() - 1);
+			// moving an instance only rebuilds the top level BVH
+			glm::mat4& transform = scene.instances[selectedInstance].transform;
+			if(ImGui::DragFloat3("Position", &transform[3].x, 0.05f))
+				scene.commitInstances();
+		}
+		if(!scene.spheres.empty())
+		{
+			selectedSphere = std::min(selectedSphere, (int)scene.spheres.size() - 1);
+			ImGui::SliderInt("Sphere", &selectedSphere, 0, (int)scene.spheres.size() - 1);
+			Sphere& sphere = scene.spheres[selectedSphere];
+			bool changed = false;
+			changed |= ImGui::DragFloat3("Center", &sphere.center.x, 0.05f);
+			changed |= ImGui::DragFloat("Radius", &sphere.radius, 0.01f, 0.01f, 1000.0f);
+			changed |= ImGui::ColorEdit3("Albedo", &sphere.albedo.x);
+			if(changed)
+				scene.commit();
+		}
+		if(ImGui::Button("Add 1000 spheres"))
+		{
+			for(int i = 0; i < 1000; i++)
+			{
+				float x = (rand() / (float)RAND_MAX) * 40.0f - 20.0f;
+				float z = (rand() / (float)RAND_MAX) * 40.0f - 20.0f;
+				glm::vec3 albedo(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+				scene.spheres.push_back(Sphere{glm::vec3(x, 0.1f, z), 0.1f, albedo, 1.0f, LAMBERT, 1.0f});
+			}
+			scene.commit();
+		}
+		ImGui::SameLine();
+		if(ImGui::Button("Reset scene"))
+		{
+			scene.spheres = defaultSceneList();
+			scene.commit();
+		}
 
 		ImGui::End();
+
+		if(showProfiler)
+			profiler.drawWindow();
 		ImGui::Render();
 
+		// only the main viewport, the platform windows below render in their own contexts
+		profiler.beginStage(STAGE_IMGUI);
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		profiler.endStage(STAGE_IMGUI);
 
 		if(io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 		{
@@ -248,15 +567,28 @@ int main()
 			ImGui::RenderPlatformWindowsDefault();
 			glfwMakeContextCurrent(backup_current_context);
 		}
+		profiler.beginStage(STAGE_SWAP);
 		glfwSwapBuffers(window);
+		profiler.endStage(STAGE_SWAP);
+		if(firstFrame)
+		{
+			firstFrame = false;
+			float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - launchTime).count();
+			logger::Log(logger::LogLevel::INFO, "First frame after " + std::to_string(elapsed) + " ms (" + std::to_string(programCache.hits()) + " shader cache hits, " + std::to_string(programCache.misses()) + " misses)");
+		}
+		profiler.endFrame();
 	}
 
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &EBO);
-	glDeleteTextures(1, &screenTex);
-	glDeleteProgram(screenShaderProgram);
-	glDeleteProgram(ComputeShaderProgram);
+	scene.releaseBuffers();
+	profiler.release();
+	frameCapture.release();
+	renderTarget.release();
+	screenShaderProgram.release();
+	gpuRaytracer.release();
+	shaderReloader.release();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
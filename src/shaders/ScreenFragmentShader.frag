@@ -1,8 +1,54 @@
-#version 460 core
+#version 450 core
 out vec4 FragColor;
 uniform sampler2D screen;
+// fraction of screen that was rendered, the rest of it is stale (dynamic resolution)
+uniform vec2 uvScale = vec2(1.0);
 in vec2 UVs;
+
+// Catmull-Rom upsampling from the rendered part of screen, done with 9 bilinear taps instead of 16 point samples.
+// The taps are clamped to the rendered area so nothing from outside it bleeds in at the edges.
+vec4 sampleCatmullRom(vec2 uv)
+{
+	vec2 texSize = vec2(textureSize(screen, 0));
+	vec2 minUV = vec2(0.5) / texSize;
+	vec2 maxUV = (uvScale * texSize - vec2(0.5)) / texSize;
+
+	vec2 samplePos = uv * texSize;
+	vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+	vec2 f = samplePos - texPos1;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	vec2 w12 = w1 + w2;
+	vec2 offset12 = w2 / w12;
+
+	vec2 texPos0 = clamp((texPos1 - 1.0) / texSize, minUV, maxUV);
+	vec2 texPos3 = clamp((texPos1 + 2.0) / texSize, minUV, maxUV);
+	vec2 texPos12 = clamp((texPos1 + offset12) / texSize, minUV, maxUV);
+
+	vec4 result = vec4(0.0);
+	result += texture(screen, vec2(texPos0.x,  texPos0.y))  * w0.x  * w0.y;
+	result += texture(screen, vec2(texPos12.x, texPos0.y))  * w12.x * w0.y;
+	result += texture(screen, vec2(texPos3.x,  texPos0.y))  * w3.x  * w0.y;
+
+	result += texture(screen, vec2(texPos0.x,  texPos12.y)) * w0.x  * w12.y;
+	result += texture(screen, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+	result += texture(screen, vec2(texPos3.x,  texPos12.y)) * w3.x  * w12.y;
+
+	result += texture(screen, vec2(texPos0.x,  texPos3.y))  * w0.x  * w3.y;
+	result += texture(screen, vec2(texPos12.x, texPos3.y))  * w12.x * w3.y;
+	result += texture(screen, vec2(texPos3.x,  texPos3.y))  * w3.x  * w3.y;
+
+	return max(result, vec4(0.0));
+}
+
 void main()
 {
-	FragColor = texture(screen, UVs);
-}
\ No newline at end of file
+	if(uvScale == vec2(1.0))
+		FragColor = texture(screen, UVs);
+	else
+		FragColor = sampleCatmullRom(UVs * uvScale);
+}
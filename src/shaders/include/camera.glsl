@@ -0,0 +1,50 @@
+#include "random.glsl"
+
+
+struct Camera
+{
+    vec3 origin;
+    vec3 lowerLeftCorner;
+    vec3 horizontal;
+    vec3 vertical;
+    vec3 u, v, w;
+    float lensRadius;
+};
+    
+    
+// vfov is top to bottom in degrees
+void Camera_init(out Camera camera, vec3 lookfrom, vec3 lookat, vec3 vup, float vfov, float aspect, float aperture, float focusDist)
+{
+    camera.lensRadius = aperture / 2.0;
+    
+    float theta = vfov * PI / 180.0;
+    float halfHeight = tan(theta / 2.0);
+    float halfWidth = aspect * halfHeight;
+
+    camera.origin = lookfrom;
+
+    camera.w = normalize(lookfrom - lookat);
+    camera.u = normalize(cross(vup, camera.w));
+    camera.v = cross(camera.w, camera.u);
+
+    camera.lowerLeftCorner = camera.origin  - halfWidth  * focusDist * camera.u
+                                            - halfHeight * focusDist * camera.v
+                                            -              focusDist * camera.w;
+
+    camera.horizontal = 2.0 * halfWidth  * focusDist * camera.u;
+    camera.vertical   = 2.0 * halfHeight * focusDist * camera.v;
+}
+
+
+Ray Camera_getRay(Camera camera, float s, float t)
+{
+    vec3 rd = camera.lensRadius * random_in_unit_disk();
+    vec3 offset = camera.u * rd.x + camera.v * rd.y;
+
+    Ray ray;
+
+    ray.origin = camera.origin + offset;
+    ray.direction = camera.lowerLeftCorner + s * camera.horizontal + t * camera.vertical - camera.origin - offset;
+
+    return ray;
+}
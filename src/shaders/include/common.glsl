@@ -0,0 +1,32 @@
+// shared by every kernel: constants, rays and hit records
+
+#define PI 		3.1415926535
+#define MAXFLOAT	99999.99
+#define NO_HIT		1e30
+
+// material types, IntersectInfo.materialType
+#define LAMBERT    0
+#define METAL      1
+#define DIELECTRIC 2
+
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+
+struct IntersectInfo
+{
+    // surface properties
+    float t;
+    vec3  p;
+    vec3  normal;
+	
+    // material properties
+    int   materialType;
+    vec3  albedo;
+    float fuzz;
+    float refractionIndex;
+};
@@ -0,0 +1,131 @@
+#include "random.glsl"
+
+// one bit per material type in use
+#ifndef MATERIAL_MASK
+#define MATERIAL_MASK 7
+#endif
+
+
+
+// Schlick's approximation for approximating the contribution of the Fresnel factor
+// in the specular reflection of light from a non-conducting surface between two media
+//
+// Theta is the angle between the direction from which the incident light is coming and
+// the normal of the interface between the two media
+float schlick(float cos_theta, float n2)
+{
+    const float n1 = 1.0f;  // refraction index for air
+
+    float r0s = (n1 - n2) / (n1 + n2);
+    float r0 = r0s * r0s;
+
+    return r0 + (1.0f - r0) * pow((1.0f - cos_theta), 5.0f);
+}
+
+
+bool refractVec(vec3 v, vec3 n, float ni_over_nt, out vec3 refracted)
+{
+    vec3 uv = normalize(v);
+
+    float dt = dot(uv, n);
+
+    float discriminant = 1.0 - ni_over_nt * ni_over_nt * (1.0f - dt * dt);
+
+    if (discriminant > 0.0f)
+    {
+        refracted = ni_over_nt*(uv - n * dt) - n * sqrt(discriminant);
+
+        return true;
+    }
+    else
+        return false;
+}
+
+
+vec3 reflectVec(vec3 v, vec3 n)
+{
+     return v - 2.0f * dot(v, n) * n;
+}
+
+
+#define HAS_MATERIAL(type) ((MATERIAL_MASK & (1 << type)) != 0)
+    
+
+bool Material_bsdf(IntersectInfo isectInfo, Ray wo, out Ray wi, out vec3 attenuation)
+{
+    int materialType = isectInfo.materialType;
+
+    if(HAS_MATERIAL(LAMBERT) && materialType == LAMBERT)
+    {
+        vec3 target = isectInfo.p + isectInfo.normal + random_in_unit_sphere();
+
+        wi.origin = isectInfo.p;
+        wi.direction = target - isectInfo.p;
+
+        attenuation = isectInfo.albedo;
+
+        return true;
+    }
+    else
+    if(HAS_MATERIAL(METAL) && materialType == METAL)
+    {
+        float fuzz = isectInfo.fuzz;
+
+        vec3 reflected = reflect(normalize(wo.direction), isectInfo.normal);
+
+        wi.origin = isectInfo.p;
+        wi.direction = reflected + fuzz * random_in_unit_sphere();
+
+        attenuation = isectInfo.albedo;
+
+        return (dot(wi.direction, isectInfo.normal) > 0.0f);
+    }
+    else
+    if(HAS_MATERIAL(DIELECTRIC) && materialType == DIELECTRIC)
+    {
+        vec3 outward_normal;
+        vec3 reflected = reflect(wo.direction, isectInfo.normal);
+
+        float ni_over_nt;
+
+        attenuation = vec3(1.0f, 1.0f, 1.0f);
+        vec3 refracted;
+        float reflect_prob;
+        float cosine;
+
+        float rafractionIndex = isectInfo.refractionIndex;
+
+        if (dot(wo.direction, isectInfo.normal) > 0.0f)
+        {
+            outward_normal = -isectInfo.normal;
+            ni_over_nt = rafractionIndex;
+           
+            cosine = dot(wo.direction, isectInfo.normal) / length(wo.direction);
+            cosine = sqrt(1.0f - rafractionIndex * rafractionIndex * (1.0f - cosine * cosine));
+        }
+        else
+        {
+            outward_normal = isectInfo.normal;
+            ni_over_nt = 1.0f / rafractionIndex;
+            cosine = -dot(wo.direction, isectInfo.normal) / length(wo.direction);
+        }
+        if (refractVec(wo.direction, outward_normal, ni_over_nt, refracted))
+            reflect_prob = schlick(cosine, rafractionIndex);
+        else
+            reflect_prob = 1.0f;
+        if (randomFloat() < reflect_prob)
+        {
+            wi.origin = isectInfo.p;
+            wi.direction = reflected;
+        }
+        else
+        {
+            wi.origin = isectInfo.p;
+            wi.direction = refracted;
+        }
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,144 @@
+// the material table is in there
+#include "sphere.glsl"
+
+
+// The triangle meshes, uploaded by the host (see Scene.cpp). The meshes share the buffers below, each
+// one has its own BVH (MeshNodeBuffer in scene.glsl) with its triangles stored in the order of its
+// leaves. They are placed in the scene by instances, which are found through a BVH of their own
+// (TlasNodeBuffer in scene.glsl) and say where the part of every buffer of their mesh starts.
+
+// has to match MeshVertex in Mesh.h, the normal is zero if the mesh came without normals
+struct MeshVertex
+{
+    vec3  position;
+    float u;
+    vec3  normal;
+    float v;
+};
+
+// has to match InstanceInfo in Mesh.h, the rows of the inverse of the instance's transform
+struct InstanceInfo
+{
+    vec4 worldToObject[3];
+    uint nodeOffset;
+    uint triangleOffset;
+    uint vertexOffset;
+    uint materialIndex;
+};
+
+// in the order of the leaves of the top level BVH
+layout(std430, binding = 12) readonly buffer InstanceBuffer
+{
+    uint instanceCount;
+    uint instancePadding[3];
+    InstanceInfo instances[];
+};
+
+// three vertex indices per triangle, relative to the vertexOffset of the mesh
+layout(std430, binding = 14) readonly buffer MeshTriangleBuffer
+{
+    uint meshIndices[];
+};
+
+layout(std430, binding = 15) readonly buffer MeshVertexBuffer
+{
+    MeshVertex meshVertices[];
+};
+
+
+// the ray in the space of the mesh of instance, the direction isn't normalized so t stays the same
+Ray Instance_objectRay(InstanceInfo instance, Ray ray)
+{
+    vec4 origin = vec4(ray.origin, 1.0);
+    vec4 direction = vec4(ray.direction, 0.0);
+    Ray objectRay;
+    objectRay.origin = vec3(dot(instance.worldToObject[0], origin), dot(instance.worldToObject[1], origin), dot(instance.worldToObject[2], origin));
+    objectRay.direction = vec3(dot(instance.worldToObject[0], direction), dot(instance.worldToObject[1], direction), dot(instance.worldToObject[2], direction));
+    return objectRay;
+}
+
+// the positions of triangle triangle of the mesh of instance mesh
+void Mesh_triangle(InstanceInfo mesh, uint triangle, out vec3 v0, out vec3 v1, out vec3 v2)
+{
+    uint first = (mesh.triangleOffset + triangle) * 3;
+    v0 = meshVertices[mesh.vertexOffset + meshIndices[first + 0]].position;
+    v1 = meshVertices[mesh.vertexOffset + meshIndices[first + 1]].position;
+    v2 = meshVertices[mesh.vertexOffset + meshIndices[first + 2]].position;
+}
+
+// Moeller-Trumbore, distance to the intersection in (t_min, t_max) or NO_HIT. Both sides of the
+// triangle are hit, the meshes don't have to be closed.
+float Triangle_hit(vec3 v0, vec3 v1, vec3 v2, Ray ray, float t_min, float t_max)
+{
+    vec3 edge1 = v1 - v0;
+    vec3 edge2 = v2 - v0;
+    vec3 pvec = cross(ray.direction, edge2);
+    float det = dot(edge1, pvec);
+
+    // parallel to the triangle
+    if (det == 0.0)
+        return NO_HIT;
+    float invDet = 1.0 / det;
+
+    vec3 tvec = ray.origin - v0;
+    float u = dot(tvec, pvec) * invDet;
+    if (u < 0.0 || u > 1.0)
+        return NO_HIT;
+
+    vec3 qvec = cross(tvec, edge1);
+    float v = dot(ray.direction, qvec) * invDet;
+    if (v < 0.0 || u + v > 1.0)
+        return NO_HIT;
+
+    float t = dot(edge2, qvec) * invDet;
+    if (t < t_max && t > t_min)
+        return t;
+    return NO_HIT;
+}
+
+// the hit record of triangle triangle of instance instanceIndex, hit by ray (in world space) at t
+IntersectInfo Mesh_intersectInfo(uint instanceIndex, uint triangle, Ray ray, float t)
+{
+    InstanceInfo mesh = instances[instanceIndex];
+    Material material = materials[mesh.materialIndex];
+    uint first = (mesh.triangleOffset + triangle) * 3;
+    MeshVertex a = meshVertices[mesh.vertexOffset + meshIndices[first + 0]];
+    MeshVertex b = meshVertices[mesh.vertexOffset + meshIndices[first + 1]];
+    MeshVertex c = meshVertices[mesh.vertexOffset + meshIndices[first + 2]];
+
+    IntersectInfo rec;
+    rec.t = t;
+    rec.p = ray.origin + t * ray.direction;
+
+    // barycentric coordinates of the hit, for the vertex normals, worked out in the space of the mesh
+    Ray objectRay = Instance_objectRay(mesh, ray);
+    vec3 edge1 = b.position - a.position;
+    vec3 edge2 = c.position - a.position;
+    vec3 toHit = objectRay.origin + t * objectRay.direction - a.position;
+    float d11 = dot(edge1, edge1);
+    float d12 = dot(edge1, edge2);
+    float d22 = dot(edge2, edge2);
+    float dp1 = dot(toHit, edge1);
+    float dp2 = dot(toHit, edge2);
+    float denom = d11 * d22 - d12 * d12;
+    float u = denom != 0.0 ? (d22 * dp1 - d12 * dp2) / denom : 0.0;
+    float v = denom != 0.0 ? (d11 * dp2 - d12 * dp1) / denom : 0.0;
+
+    vec3 normal = (1.0 - u - v) * a.normal + u * b.normal + v * c.normal;
+    if (dot(normal, normal) == 0.0)
+        normal = cross(edge1, edge2);
+    // normals go to world space with the transpose of the inverse, whose columns are the rows we have
+    normal = normal.x * mesh.worldToObject[0].xyz + normal.y * mesh.worldToObject[1].xyz + normal.z * mesh.worldToObject[2].xyz;
+    rec.normal = normalize(normal);
+
+    // Only glass needs to know which side is outside (counter clockwise, like OBJ files have it).
+    // Everything else scatters off the side the ray came from.
+    if (material.materialType != DIELECTRIC && dot(rec.normal, ray.direction) > 0.0)
+        rec.normal = -rec.normal;
+
+    rec.materialType     = material.materialType;
+    rec.albedo           = material.albedo;
+    rec.fuzz             = material.fuzz;
+    rec.refractionIndex  = material.refractionIndex;
+    return rec;
+}
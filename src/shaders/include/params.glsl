@@ -0,0 +1,13 @@
+// everything that changes from frame to frame, written once per frame by the host (RenderParams in GPURaytracer.cpp)
+layout(std140, binding = 0) uniform RenderParams
+{
+    vec3 lookFrom;
+    float time;
+    vec3 lookAt;
+    // number of frames already in the accumulation image, 0 starts over
+    uint frameIndex;
+    int MAXDEPTHi;
+    int NUMSAMPLESi;
+    // the part of the images that is rendered, smaller than the images with dynamic resolution
+    ivec2 renderSize;
+};
@@ -0,0 +1,93 @@
+#include "common.glsl"
+
+
+// random number generator, a PCG32 state per invocation seeded per pixel, sample and frame.
+// Random.h does the same on the CPU, keep the two in sync.
+uint rngState;
+
+// PCG-RXS-M-XS output permutation, good enough on its own to hash seeds
+uint pcgHash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint rngSeed(uint x, uint y, uint sampleIndex, uint frame)
+{
+    return pcgHash(x + pcgHash(y + pcgHash(sampleIndex + pcgHash(frame))));
+}
+
+// uniform in [0, 1), the top 24 bits are exactly representable as a float
+float randomFloat()
+{
+    rngState = rngState * 747796405u + 2891336453u;
+    uint word = ((rngState >> ((rngState >> 28u) + 4u)) ^ rngState) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return float(word >> 8u) * (1.0 / 16777216.0);
+}
+
+
+// random direction in unit sphere (for lambert brdf)
+vec3 random_in_unit_sphere()
+{
+    float phi = 2.0 * PI * randomFloat();
+    float cosTheta = 2.0 * randomFloat() - 1.0;
+    float u = randomFloat();
+
+    float theta = acos(cosTheta);
+    float r = pow(u, 1.0 / 3.0);
+
+    float x = r * sin(theta) * cos(phi);
+    float y = r * sin(theta) * sin(phi);
+    float z = r * cos(theta);
+
+    return vec3(x, y, z);
+}
+
+
+// random point on unit disk (for depth of field camera)
+vec3 random_in_unit_disk()
+{
+    float spx = 2.0 * randomFloat() - 1.0;
+    float spy = 2.0 * randomFloat() - 1.0;
+
+    float r, phi;
+
+
+    if(spx > -spy)
+    {
+        if(spx > spy)
+        {
+            r = spx;
+            phi = spy / spx;
+        }
+        else
+        {
+            r = spy;
+            phi = 2.0 - spx / spy;
+        }
+    }
+    else
+    {
+        if(spx < spy)
+        {
+            r = -spx;
+            phi = 4.0f + spy / spx;
+        }
+        else
+        {
+            r = -spy;
+
+            if(spy != 0.0)
+                phi = 6.0 - spx / spy;
+            else
+                phi = 0.0;
+        }
+    }
+
+    phi *= PI / 4.0;
+
+
+  return vec3(r * cos(phi), r * sin(phi), 0.0f);
+}
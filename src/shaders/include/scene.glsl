@@ -0,0 +1,298 @@
+#include "sphere.glsl"
+#include "mesh.glsl"
+
+#define BVH_MAX_DEPTH	64
+
+// hitObject of a sphere, instances are numbered from 0
+#define SPHERE_OBJECT	0xFFFFFFFFu
+
+
+
+// Flattened BVHs, built on the host (see BVH.cpp), one over the spheres in SceneBuffer, one per mesh and
+// one over the mesh instances. Inner nodes have primCount == 0 and their children at leftFirst and
+// leftFirst + 1, leaves reference primCount spheres starting at bvhPrimIndices[leftFirst], primCount
+// triangles starting at triangle leftFirst of the mesh, or primCount instances starting at
+// instances[leftFirst].
+struct BVHNode
+{
+    vec3 boundsMin;
+    uint leftFirst;
+    vec3 boundsMax;
+    uint primCount;
+};
+
+layout(std430, binding = 1) readonly buffer BVHNodeBuffer
+{
+    BVHNode bvhNodes[];
+};
+
+layout(std430, binding = 2) readonly buffer BVHPrimitiveBuffer
+{
+    uint bvhPrimIndices[];
+};
+
+// the nodes of every mesh, node and child indices are relative to the nodeOffset of the mesh
+layout(std430, binding = 13) readonly buffer MeshNodeBuffer
+{
+    BVHNode meshNodes[];
+};
+
+// the top level, over the world space bounds of the instances
+layout(std430, binding = 16) readonly buffer TlasNodeBuffer
+{
+    BVHNode tlasNodes[];
+};
+
+
+// distance at which the ray enters the box, or NO_HIT
+float AABB_hit(vec3 boundsMin, vec3 boundsMax, Ray ray, vec3 invDir, float t_min, float t_max)
+{
+    vec3 t0 = (boundsMin - ray.origin) * invDir;
+    vec3 t1 = (boundsMax - ray.origin) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+
+    float enter = max(max(tNear.x, tNear.y), max(tNear.z, t_min));
+    float exit = min(min(tFar.x, tFar.y), min(tFar.z, t_max));
+
+    return enter <= exit ? enter : NO_HIT;
+}
+
+
+// Closest sphere in (t_min, closest_so_far), closest_so_far is pulled in to every hit on the way.
+bool intersectSpheres(Ray ray, vec3 invDir, float t_min, inout float closest_so_far, inout uint hitSphere)
+{
+        bool hit_anything = false;
+
+        if (AABB_hit(bvhNodes[0].boundsMin, bvhNodes[0].boundsMax, ray, invDir, t_min, closest_so_far) == NO_HIT)
+            return false;
+
+        uint stack[BVH_MAX_DEPTH];
+        int stackSize = 0;
+        uint nodeIndex = 0;
+        while (true)
+        {
+            BVHNode node = bvhNodes[nodeIndex];
+            if (node.primCount > 0)
+            {
+                for (uint i = 0; i < node.primCount; i++)
+                {
+                    uint sphereIndex = bvhPrimIndices[node.leftFirst + i];
+                    float t = Sphere_hit(sceneList[sphereIndex], ray, t_min, closest_so_far);
+
+                    if (t != NO_HIT)
+                    {
+                        hit_anything   = true;
+                        closest_so_far = t;
+                        hitSphere      = sphereIndex;
+                    }
+                }
+            }
+            else
+            {
+                // visit the nearer child first, the other one goes on the stack
+                uint nearChild = node.leftFirst;
+                uint farChild = node.leftFirst + 1;
+                float nearDist = AABB_hit(bvhNodes[nearChild].boundsMin, bvhNodes[nearChild].boundsMax, ray, invDir, t_min, closest_so_far);
+                float farDist = AABB_hit(bvhNodes[farChild].boundsMin, bvhNodes[farChild].boundsMax, ray, invDir, t_min, closest_so_far);
+                if (farDist < nearDist)
+                {
+                    uint tempChild = nearChild; nearChild = farChild; farChild = tempChild;
+                    float tempDist = nearDist; nearDist = farDist; farDist = tempDist;
+                }
+
+                if (nearDist != NO_HIT)
+                {
+                    if (farDist != NO_HIT)
+                        stack[stackSize++] = farChild;
+                    nodeIndex = nearChild;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+                break;
+            nodeIndex = stack[--stackSize];
+        }
+
+        return hit_anything;
+}
+
+// The same for the triangles of the mesh of an instance, walking the BVH of the mesh with the ray in
+// the space of the mesh.
+bool intersectMesh(InstanceInfo mesh, Ray ray, vec3 invDir, float t_min, inout float closest_so_far, inout uint hitTriangle)
+{
+        bool hit_anything = false;
+
+        if (AABB_hit(meshNodes[mesh.nodeOffset].boundsMin, meshNodes[mesh.nodeOffset].boundsMax, ray, invDir, t_min, closest_so_far) == NO_HIT)
+            return false;
+
+        uint stack[BVH_MAX_DEPTH];
+        int stackSize = 0;
+        uint nodeIndex = 0;
+        while (true)
+        {
+            BVHNode node = meshNodes[mesh.nodeOffset + nodeIndex];
+            if (node.primCount > 0)
+            {
+                for (uint i = 0; i < node.primCount; i++)
+                {
+                    vec3 v0, v1, v2;
+                    Mesh_triangle(mesh, node.leftFirst + i, v0, v1, v2);
+                    float t = Triangle_hit(v0, v1, v2, ray, t_min, closest_so_far);
+
+                    if (t != NO_HIT)
+                    {
+                        hit_anything   = true;
+                        closest_so_far = t;
+                        hitTriangle    = node.leftFirst + i;
+                    }
+                }
+            }
+            else
+            {
+                uint nearChild = node.leftFirst;
+                uint farChild = node.leftFirst + 1;
+                BVHNode nearNode = meshNodes[mesh.nodeOffset + nearChild];
+                BVHNode farNode = meshNodes[mesh.nodeOffset + farChild];
+                float nearDist = AABB_hit(nearNode.boundsMin, nearNode.boundsMax, ray, invDir, t_min, closest_so_far);
+                float farDist = AABB_hit(farNode.boundsMin, farNode.boundsMax, ray, invDir, t_min, closest_so_far);
+                if (farDist < nearDist)
+                {
+                    uint tempChild = nearChild; nearChild = farChild; farChild = tempChild;
+                    float tempDist = nearDist; nearDist = farDist; farDist = tempDist;
+                }
+
+                if (nearDist != NO_HIT)
+                {
+                    if (farDist != NO_HIT)
+                        stack[stackSize++] = farChild;
+                    nodeIndex = nearChild;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+                break;
+            nodeIndex = stack[--stackSize];
+        }
+
+        return hit_anything;
+}
+
+
+// And for the instances, walking the top level BVH and, for every instance it reaches, the BVH of its mesh.
+bool intersectInstances(Ray ray, vec3 invDir, float t_min, inout float closest_so_far, inout uint hitInstance, inout uint hitTriangle)
+{
+        bool hit_anything = false;
+
+        if (AABB_hit(tlasNodes[0].boundsMin, tlasNodes[0].boundsMax, ray, invDir, t_min, closest_so_far) == NO_HIT)
+            return false;
+
+        uint stack[BVH_MAX_DEPTH];
+        int stackSize = 0;
+        uint nodeIndex = 0;
+        while (true)
+        {
+            BVHNode node = tlasNodes[nodeIndex];
+            if (node.primCount > 0)
+            {
+                for (uint i = 0; i < node.primCount; i++)
+                {
+                    InstanceInfo instance = instances[node.leftFirst + i];
+                    Ray objectRay = Instance_objectRay(instance, ray);
+
+                    if (intersectMesh(instance, objectRay, 1.0 / objectRay.direction, t_min, closest_so_far, hitTriangle))
+                    {
+                        hit_anything = true;
+                        hitInstance  = node.leftFirst + i;
+                    }
+                }
+            }
+            else
+            {
+                uint nearChild = node.leftFirst;
+                uint farChild = node.leftFirst + 1;
+                float nearDist = AABB_hit(tlasNodes[nearChild].boundsMin, tlasNodes[nearChild].boundsMax, ray, invDir, t_min, closest_so_far);
+                float farDist = AABB_hit(tlasNodes[farChild].boundsMin, tlasNodes[farChild].boundsMax, ray, invDir, t_min, closest_so_far);
+                if (farDist < nearDist)
+                {
+                    uint tempChild = nearChild; nearChild = farChild; farChild = tempChild;
+                    float tempDist = nearDist; nearDist = farDist; farDist = tempDist;
+                }
+
+                if (nearDist != NO_HIT)
+                {
+                    if (farDist != NO_HIT)
+                        stack[stackSize++] = farChild;
+                    nodeIndex = nearChild;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+                break;
+            nodeIndex = stack[--stackSize];
+        }
+
+        return hit_anything;
+}
+
+
+// Closest sphere or triangle the ray hits in (t_min, t_max). Only its distance and what it is are kept
+// while walking the BVHs, the rest of the hit is worked out once at the end (Scene_intersectInfo()).
+// hitObject is SPHERE_OBJECT with the sphere index in hitPrim, or the instance with the triangle of its
+// mesh in hitPrim.
+bool intersectScene(Ray ray, float t_min, float t_max, out float hitT, out uint hitObject, out uint hitPrim)
+{
+        bool hit_anything = false;
+        float closest_so_far = t_max;
+        hitObject = SPHERE_OBJECT;
+        hitPrim = 0;
+
+        vec3 invDir = 1.0 / ray.direction;
+
+        if (sphereCount > 0)
+            hit_anything = intersectSpheres(ray, invDir, t_min, closest_so_far, hitPrim);
+
+        if (instanceCount > 0 && intersectInstances(ray, invDir, t_min, closest_so_far, hitObject, hitPrim))
+            hit_anything = true;
+
+        hitT = hit_anything ? closest_so_far : NO_HIT;
+        return hit_anything;
+}
+
+IntersectInfo Scene_intersectInfo(uint hitObject, uint hitPrim, Ray ray, float t)
+{
+        if (hitObject == SPHERE_OBJECT)
+            return Sphere_intersectInfo(hitPrim, ray, t);
+        return Mesh_intersectInfo(hitObject, hitPrim, ray, t);
+}
+
+// the material type of a hit, without working out the rest of it
+int Scene_materialType(uint hitObject, uint hitPrim)
+{
+        if (hitObject == SPHERE_OBJECT)
+            return materials[sphereMaterials[hitPrim]].materialType;
+        return materials[instances[hitObject].materialIndex].materialType;
+}
+
+bool intersectScene(Ray ray, float t_min, float t_max, out IntersectInfo rec)
+{
+        float t;
+        uint hitObject, hitPrim;
+        if (!intersectScene(ray, t_min, t_max, t, hitObject, hitPrim))
+            return false;
+
+        rec = Scene_intersectInfo(hitObject, hitPrim, ray, t);
+        return true;
+}
+
+
+vec3 skyColor(Ray ray)
+{
+    vec3 unit_direction = normalize(ray.direction);
+    float t = 0.5 * (unit_direction.y + 1.0);
+
+    return (1.0 - t) * vec3(1.0, 1.0, 1.0) + t * vec3(0.5, 0.7, 1.0);
+}
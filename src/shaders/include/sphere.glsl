@@ -0,0 +1,73 @@
+#include "common.glsl"
+
+
+// The spheres, filled in and updated by the host (see Scene.cpp). Traversal only reads the
+// center and radius, the material is looked up once for the closest hit.
+layout(std430, binding = 0) readonly buffer SceneBuffer
+{
+    uint sphereCount;
+    // center in xyz, radius in w
+    vec4 sceneList[];
+};
+
+// has to match the Material struct in Sphere.h
+struct Material
+{
+    vec3  albedo;
+    float fuzz;
+    int   materialType;
+    float refractionIndex;
+};
+
+// index into materials for every sphere
+layout(std430, binding = 10) readonly buffer SphereMaterialBuffer
+{
+    uint sphereMaterials[];
+};
+
+layout(std430, binding = 11) readonly buffer MaterialBuffer
+{
+    Material materials[];
+};
+
+
+// distance to the nearer intersection in (t_min, t_max), or NO_HIT
+float Sphere_hit(vec4 sphere, Ray ray, float t_min, float t_max)
+{
+    vec3 oc = ray.origin - sphere.xyz;
+    float a = dot(ray.direction, ray.direction);
+    float b = dot(oc, ray.direction);
+    float c = dot(oc, oc) - sphere.w * sphere.w;
+
+    float discriminant = b * b - a * c;
+
+    if (discriminant > 0.0f)
+    {
+        float temp = (-b - sqrt(discriminant)) / a;
+        if (temp < t_max && temp > t_min)
+            return temp;
+
+        temp = (-b + sqrt(discriminant)) / a;
+        if (temp < t_max && temp > t_min)
+            return temp;
+    }
+
+    return NO_HIT;
+}
+
+// the hit record of sphere sphereIndex, hit by ray at t
+IntersectInfo Sphere_intersectInfo(uint sphereIndex, Ray ray, float t)
+{
+    vec4 sphere = sceneList[sphereIndex];
+    Material material = materials[sphereMaterials[sphereIndex]];
+
+    IntersectInfo rec;
+    rec.t                = t;
+    rec.p                = ray.origin + t * ray.direction;
+    rec.normal           = (rec.p - sphere.xyz) / sphere.w;
+    rec.materialType     = material.materialType;
+    rec.albedo           = material.albedo;
+    rec.fuzz             = material.fuzz;
+    rec.refractionIndex  = material.refractionIndex;
+    return rec;
+}
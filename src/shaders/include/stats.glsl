@@ -0,0 +1,5 @@
+// rays traced in the current frame, read back by the host for the rays/sec readout (see RayCounter.cpp)
+layout(std430, binding = 9) buffer RayCounter
+{
+    uint rayCount;
+};
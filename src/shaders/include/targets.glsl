@@ -0,0 +1,8 @@
+// the images of RenderTarget, screen holds what is shown and accumulation the linear color
+#ifndef SCREEN_FORMAT
+#define SCREEN_FORMAT rgba8
+#endif
+// its format is picked by the host (see GPURaytracer::kernelDefines())
+layout(SCREEN_FORMAT, binding = 0) uniform writeonly image2D screen;
+// running average of every frame since the view last changed
+layout(rgba32f, binding = 1) uniform image2D accumulation;
@@ -0,0 +1,60 @@
+#include "common.glsl"
+
+// State of the wavefront pipeline (see WavefrontPipeline.cpp). Every pixel has one path, which the
+// stages pass along through index queues. The queues are filled with atomic counters, so each
+// dispatch only covers the paths that are still alive.
+
+#define WAVEFRONT_GROUP_SIZE 64
+#define MATERIAL_COUNT 3
+
+// has to match PathState in WavefrontPipeline.cpp (std430)
+struct PathState
+{
+    vec3  origin;
+    uint  rngState;
+    vec3  direction;
+    uint  depth;
+    vec3  throughput;
+    // last hit, written by extend for shade, which looks the rest of it up (Scene_intersectInfo)
+    uint  hitPrim;
+    // sum of the finished samples of this frame
+    vec3  sampleSum;
+    float hitT;
+    uint  hitObject;
+};
+
+layout(std430, binding = 3) buffer PathBuffer
+{
+    PathState paths[];
+};
+
+// the host swaps the two ray queues between bounces
+layout(std430, binding = 4) readonly buffer RayQueueIn
+{
+    uint rayQueueIn[];
+};
+
+layout(std430, binding = 5) writeonly buffer RayQueueOut
+{
+    uint rayQueueOut[];
+};
+
+// MATERIAL_COUNT queues of pathCapacity entries each
+layout(std430, binding = 6) buffer MaterialQueue
+{
+    uint materialQueue[];
+};
+
+layout(std430, binding = 7) buffer WavefrontCounters
+{
+    // paths in RayQueueIn
+    uint extendCount;
+    // paths appended to RayQueueOut
+    uint queuedCount;
+    // paths appended to each material queue
+    uint materialCount[MATERIAL_COUNT];
+};
+
+// number of paths the buffers have room for
+uniform uint pathCapacity;
+
@@ -0,0 +1,92 @@
+// Converts scenes between the text description and the binary .rtscene format (see SceneFile.h).
+// Building the BVH happens here, once, so loading the .rtscene later is only a matter of mapping it.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Random.h"
+#include "Scene.h"
+#include "logger.h"
+
+
+// n small spheres on a jittered square grid over the usual ground, for trying out scenes far bigger than the default one
+static std::vector<Sphere> sphereField(int count)
+{
+	std::vector<Sphere> spheres;
+	spheres.reserve(count + 1);
+	spheres.push_back({glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, glm::vec3(0.5f), 1.0f, LAMBERT, 1.0f});
+
+	int side = (int)std::ceil(std::sqrt((double)count));
+	uint32_t rngState = pcgHash((uint32_t)count);
+	for(int i = 0; i < count; i++)
+	{
+		int x = i % side;
+		int z = i / side;
+		glm::vec3 center((x - side / 2 + 0.8f * randomFloat(rngState)) * 0.6f, 0.15f, (z - side / 2 + 0.8f * randomFloat(rngState)) * 0.6f);
+		glm::vec3 albedo(randomFloat(rngState), randomFloat(rngState), randomFloat(rngState));
+		float choice = randomFloat(rngState);
+		if(choice < 0.8f)
+			spheres.push_back({center, 0.15f, albedo * albedo, 1.0f, LAMBERT, 1.0f});
+		else if(choice < 0.95f)
+			spheres.push_back({center, 0.15f, glm::vec3(0.5f) + 0.5f * albedo, 0.5f * randomFloat(rngState), METAL, 1.0f});
+		else
+			spheres.push_back({center, 0.15f, glm::vec3(0.0f), 1.0f, DIELECTRIC, 1.5f});
+	}
+	return spheres;
+}
+
+static void printConverterUsage(const char* program)
+{
+	std::printf(
+		"Usage: %s INPUT OUTPUT\n"
+		"\n"
+		"Reads INPUT (an .rtscene file, a text scene, \"default\" for the built in scene or \"field:N\" for\n"
+		"N random spheres) and writes OUTPUT, an .rtscene file if it has that extension and text otherwise.\n",
+		program);
+}
+
+
+int main(int argc, char** argv)
+{
+	if(argc != 3 || std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)
+	{
+		printConverterUsage(argv[0]);
+		return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	std::string input = argv[1];
+	std::string output = argv[2];
+
+	Scene scene;
+	bool generated = true;
+	if(input == "default")
+		scene.spheres = defaultSceneList();
+	else if(input.rfind("field:", 0) == 0)
+	{
+		int count = std::atoi(input.c_str() + 6);
+		if(count <= 0)
+		{
+			printConverterUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		scene.spheres = sphereField(count);
+	}
+	else if(scene.load(input))
+		generated = false;
+	else
+		return EXIT_FAILURE;
+	// builds the BVH, a loaded scene has one already
+	if(generated)
+		scene.commit();
+
+	if(std::filesystem::path(output).extension() == ".rtscene")
+		return scene.save(output) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	std::vector<SceneInstanceEntry> instances;
+	for(const MeshInstance& instance : scene.instances)
+		instances.push_back({scene.meshes[instance.mesh].path, instance.transform, instance.material});
+	return writeSceneText(output, scene.spheres, instances) ? EXIT_SUCCESS : EXIT_FAILURE;
+}